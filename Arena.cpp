@@ -0,0 +1,89 @@
+#include "Arena.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+using namespace std;
+
+static const size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+Arena::Arena(size_t firstBlockSize)
+ : m_current(0), m_used(0), m_firstBlockSize(firstBlockSize)
+{
+}
+
+Arena::~Arena()
+{
+    for (size_t i = 0; i < m_blocks.size(); i++)
+        free(m_blocks[i].data);
+}
+
+void* Arena::allocateSlow(size_t bytes, size_t alignment)
+{
+      // move on to the next kept block if the request fits there
+    while (m_current + 1 < m_blocks.size())
+    {
+        m_current++;
+        m_used = 0;
+        if (bytes + alignment <= m_blocks[m_current].size)
+            return allocate(bytes, alignment);
+    }
+
+      // blocks double in size up to MAX_BLOCK_SIZE; oversized requests get their own
+    size_t size = m_blocks.empty() ? m_firstBlockSize : min(m_blocks.back().size * 2, MAX_BLOCK_SIZE);
+    size = max(size, bytes + alignment);
+    char* data = static_cast<char*>(malloc(size));      // malloc memory is max_align_t aligned
+    if (data == nullptr)
+        throw bad_alloc();
+    Block b = { data, size };
+    m_blocks.push_back(b);
+    m_current = m_blocks.size() - 1;
+    m_used = 0;
+    STATS_MAX(arenaBytes, static_cast<long>(bytesReserved()));
+    return allocate(bytes, alignment);
+}
+
+Arena::Mark Arena::mark() const
+{
+    Mark m = { m_current, m_used };
+    return m;
+}
+
+void Arena::rewind(const Mark& m)
+{
+    m_current = m.block;
+    m_used = m.used;
+}
+
+void Arena::trim(size_t keepBytes)
+{
+    size_t kept = 0;
+    size_t keepBlocks = 0;
+    while (keepBlocks < m_blocks.size() && (keepBlocks <= m_current || kept + m_blocks[keepBlocks].size <= keepBytes))
+        kept += m_blocks[keepBlocks++].size;
+    for (size_t i = keepBlocks; i < m_blocks.size(); i++)
+        free(m_blocks[i].data);
+    m_blocks.resize(keepBlocks);
+}
+
+size_t Arena::bytesInUse() const
+{
+    size_t bytes = m_used;
+    for (size_t i = 0; i < m_current && i < m_blocks.size(); i++)
+        bytes += m_blocks[i].size;
+    return bytes;
+}
+
+size_t Arena::bytesReserved() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < m_blocks.size(); i++)
+        bytes += m_blocks[i].size;
+    return bytes;
+}
+
+Arena& threadArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
@@ -0,0 +1,131 @@
+// Arena.h
+
+// Monotonic region allocation for per-query and per-plan temporaries.
+//
+// An Arena hands out memory by bumping a pointer through a list of blocks and
+// never frees individual allocations; everything allocated after a mark is
+// released in one shot by rewinding to it, and the blocks are kept for the
+// next query.  Each thread has its own arena (threadArena()), so planning on
+// many threads does not contend on the global heap.
+//
+// Containers use an arena through ArenaAllocator, or ExpandableHashMap's
+// Arena* constructor argument.  Objects placed in an arena must be destroyed
+// before the arena is rewound past them; declaring the ArenaScope first in a
+// function guarantees that.
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+class Arena
+{
+public:
+    struct Mark
+    {
+        size_t block;
+        size_t used;
+    };
+
+    explicit Arena(size_t firstBlockSize = 64 * 1024);
+    ~Arena();
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    Mark mark() const;
+    void rewind(const Mark& m);             // releases everything allocated since m
+    void trim(size_t keepBytes);            // frees unused blocks beyond the first keepBytes
+    size_t bytesInUse() const;
+    size_t bytesReserved() const;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+    std::vector<Block> m_blocks;
+    size_t m_current;                       // block being allocated from
+    size_t m_used;                          // bytes used in m_blocks[m_current]
+    size_t m_firstBlockSize;
+
+    void* allocateSlow(size_t bytes, size_t alignment);
+};
+
+  // the calling thread's scratch arena
+Arena& threadArena();
+
+  // Rewinds an arena to where it was at construction.  When that empties the
+  // arena, blocks beyond RETAINED_BYTES are returned to the heap so one huge
+  // query does not pin its memory for the life of the thread.
+class ArenaScope
+{
+public:
+    static const size_t RETAINED_BYTES = 32 * 1024 * 1024;
+
+    explicit ArenaScope(Arena& arena)
+     : m_arena(arena), m_mark(arena.mark())
+    {}
+    ~ArenaScope()
+    {
+        m_arena.rewind(m_mark);
+        if (m_mark.block == 0 && m_mark.used == 0)
+            m_arena.trim(RETAINED_BYTES);
+    }
+    Arena& arena() const { return m_arena; }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+private:
+    Arena& m_arena;
+    Arena::Mark m_mark;
+};
+
+  // Standard allocator over an Arena; deallocate is a no-op.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(Arena* arena) : m_arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+    Arena* arena() const { return m_arena; }
+private:
+    Arena* m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() != b.arena();
+}
+
+inline void* Arena::allocate(size_t bytes, size_t alignment)
+{
+    if (m_current < m_blocks.size())
+    {
+        const Block& b = m_blocks[m_current];
+        size_t offset = (m_used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= b.size)
+        {
+            m_used = offset + bytes;
+            return b.data + offset;
+        }
+    }
+    return allocateSlow(bytes, alignment);
+}
+
+#endif // ARENA_INCLUDED
@@ -0,0 +1,368 @@
+#include "provided.h"
+#include "CommandWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+const char* directionName(CompactCommand::Direction dir)
+{
+    static const char* const names[] = {
+        "east", "northeast", "north", "northwest", "west", "southwest", "south", "southeast",
+        "left", "right", "proceed", ""
+    };
+    return names[dir];
+}
+
+//******************** CompactCommandList functions ***************************
+
+CompactCommandList::CompactCommandList(Arena* arena)
+ : m_nameIds(0.5, arena), m_streetIds(0.5, arena)
+{
+}
+
+void CompactCommandList::clear()
+{
+    m_commands.clear();
+    m_names.clear();
+    m_nameIds.reset();
+    m_streetIds.reset();
+}
+
+uint32_t CompactCommandList::internName(const string& s)
+{
+    const uint32_t* id = m_nameIds.find(s);
+    if (id != nullptr)
+        return *id;
+    uint32_t newId = static_cast<uint32_t>(m_names.size());
+    m_names.push_back(s);
+    m_nameIds.associate(s, newId);
+    return newId;
+}
+
+uint32_t CompactCommandList::internStreet(const StreetSegment& street)
+{
+    if (street.nameId < 0)
+        return internName(street.name);
+    const uint32_t* id = m_streetIds.find(street.nameId);
+    if (id != nullptr)
+        return *id;
+    uint32_t newId = internName(street.name);
+    m_streetIds.associate(street.nameId, newId);
+    return newId;
+}
+
+void CompactCommandList::addProceed(CompactCommand::Direction dir, const string& streetName, double dist)
+{
+    CompactCommand c = { CompactCommand::PROCEED, dir, internName(streetName), dist };
+    m_commands.push_back(c);
+}
+
+void CompactCommandList::addTurn(CompactCommand::Direction dir, const string& streetName)
+{
+    CompactCommand c = { CompactCommand::TURN, dir, internName(streetName), 0 };
+    m_commands.push_back(c);
+}
+
+void CompactCommandList::addProceed(CompactCommand::Direction dir, const StreetSegment& street, double dist)
+{
+    CompactCommand c = { CompactCommand::PROCEED, dir, internStreet(street), dist };
+    m_commands.push_back(c);
+}
+
+void CompactCommandList::addTurn(CompactCommand::Direction dir, const StreetSegment& street)
+{
+    CompactCommand c = { CompactCommand::TURN, dir, internStreet(street), 0 };
+    m_commands.push_back(c);
+}
+
+void CompactCommandList::addDeliver(const string& item)
+{
+    CompactCommand c = { CompactCommand::DELIVER, CompactCommand::NONE, internName(item), 0 };
+    m_commands.push_back(c);
+}
+
+void CompactCommandList::append(const CompactCommandList& other)
+{
+    for (int i = 0; i < other.size(); i++)
+    {
+        CompactCommand c = other[i];
+        c.nameId = internName(other.name(c.nameId));        // ids are per list
+        m_commands.push_back(c);
+    }
+}
+
+DeliveryCommand CompactCommandList::toDeliveryCommand(int i) const
+{
+    const CompactCommand& c = m_commands[i];
+    DeliveryCommand dc;
+    switch (c.type)
+    {
+      case CompactCommand::PROCEED:
+        dc.initAsProceedCommand(directionName(c.direction), m_names[c.nameId], c.distance);
+        break;
+      case CompactCommand::TURN:
+        dc.initAsTurnCommand(directionName(c.direction), m_names[c.nameId]);
+        break;
+      case CompactCommand::DELIVER:
+        dc.initAsDeliverCommand(m_names[c.nameId]);
+        break;
+    }
+    return dc;
+}
+
+//******************** CommandWriter functions ********************************
+
+// Binary records: 'N' varint(id) varint(len) bytes   defines a name
+//                 'C' type direction varint(nameId) double(miles)
+//                 'E' double(totalMiles)              ends a plan
+// Names are sent once, the first time a command refers to them; an 'R' record
+// tells the reader that ids restart because a different list is being written.
+// Doubles are written little-endian.
+
+CommandWriter::CommandWriter(ostream& out, Format format, size_t bufferSize)
+ : m_out(out), m_format(format), m_buffer(bufferSize < 64 ? 64 : bufferSize), m_used(0), m_namesFrom(nullptr)
+{
+}
+
+CommandWriter::~CommandWriter()
+{
+    flush();
+}
+
+bool CommandWriter::parseFormat(const string& name, Format& format)
+{
+    if (name == "text")
+        format = TEXT;
+    else if (name == "json")
+        format = JSON_LINES;
+    else if (name == "binary")
+        format = BINARY;
+    else
+        return false;
+    return true;
+}
+
+void CommandWriter::beginPlan()
+{
+    if (m_format == TEXT)
+        put("Starting at the depot...\n");
+}
+
+void CommandWriter::write(const CompactCommandList& commands)
+{
+    for (int i = 0; i < commands.size(); i++)
+        write(commands, i);
+}
+
+void CommandWriter::write(const CompactCommandList& commands, int i)
+{
+    const CompactCommand& c = commands[i];
+    const string& name = commands.name(c.nameId);
+    switch (m_format)
+    {
+      case TEXT:
+        switch (c.type)
+        {
+          case CompactCommand::PROCEED:
+            put("Proceed ");
+            put(directionName(c.direction));
+            put(" on ");
+            put(name);
+            put(" for ");
+            putMiles(c.distance);
+            put(" miles\n");
+            break;
+          case CompactCommand::TURN:
+            put("Turn ");
+            put(directionName(c.direction));
+            put(" on ");
+            put(name);
+            putChar('\n');
+            break;
+          case CompactCommand::DELIVER:
+            put("DELIVER ");
+            put(name);
+            putChar('\n');
+            break;
+        }
+        break;
+      case JSON_LINES:
+        putJsonCommand(commands, i);
+        putChar('\n');
+        break;
+      case BINARY:
+        sendName(commands, c.nameId);
+        putChar('C');
+        putChar(static_cast<char>(c.type));
+        putChar(static_cast<char>(c.direction));
+        putVarint(c.nameId);
+        putDouble(c.distance);
+        break;
+    }
+}
+
+void CommandWriter::endPlan(double totalMiles)
+{
+    switch (m_format)
+    {
+      case TEXT:
+        put("You are back at the depot and your deliveries are done!\n");
+        putMiles(totalMiles);
+        put(" miles travelled for all deliveries.\n");
+        break;
+      case JSON_LINES:
+        put("{\"type\":\"summary\",\"miles\":");
+        putMiles(totalMiles);
+        put("}\n");
+        break;
+      case BINARY:
+        putChar('E');
+        putDouble(totalMiles);
+        break;
+    }
+}
+
+void CommandWriter::writeJsonArray(const CompactCommandList& commands)
+{
+    putChar('[');
+    for (int i = 0; i < commands.size(); i++)
+    {
+        if (i > 0)
+            putChar(',');
+        putJsonCommand(commands, i);
+    }
+    putChar(']');
+}
+
+void CommandWriter::putJsonCommand(const CompactCommandList& commands, int i)
+{
+    const CompactCommand& c = commands[i];
+    if (c.type == CompactCommand::DELIVER)
+    {
+        put("{\"type\":\"deliver\",\"item\":");
+        putJsonString(commands.name(c.nameId));
+    }
+    else
+    {
+        put(c.type == CompactCommand::PROCEED ? "{\"type\":\"proceed\",\"direction\":\"" : "{\"type\":\"turn\",\"direction\":\"");
+        put(directionName(c.direction));
+        put("\",\"street\":");
+        putJsonString(commands.name(c.nameId));
+        if (c.type == CompactCommand::PROCEED)
+        {
+            put(",\"miles\":");
+            putMiles(c.distance);
+        }
+    }
+    putChar('}');
+}
+
+void CommandWriter::flush()
+{
+    if (m_used > 0)
+        m_out.write(m_buffer.data(), m_used);
+    m_used = 0;
+    m_out.flush();
+}
+
+void CommandWriter::put(const char* s, size_t n)
+{
+    if (m_used + n > m_buffer.size())
+    {
+        m_out.write(m_buffer.data(), m_used);
+        m_used = 0;
+        if (n > m_buffer.size())            // too big to buffer; write it through
+        {
+            m_out.write(s, n);
+            return;
+        }
+    }
+    memcpy(m_buffer.data() + m_used, s, n);
+    m_used += n;
+}
+
+void CommandWriter::put(const char* s)
+{
+    put(s, strlen(s));
+}
+
+void CommandWriter::putChar(char c)
+{
+    if (m_used == m_buffer.size())
+    {
+        m_out.write(m_buffer.data(), m_used);
+        m_used = 0;
+    }
+    m_buffer[m_used++] = c;
+}
+
+void CommandWriter::putMiles(double miles)
+{
+    char text[32];
+    int n = snprintf(text, sizeof(text), "%.2f", miles);
+    put(text, n);
+}
+
+void CommandWriter::putJsonString(const string& s)
+{
+    putChar('"');
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+        {
+            putChar('\\');
+            putChar(c);
+        }
+        else if (c < 0x20)
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(esc, 6);
+        }
+        else
+            putChar(c);
+    }
+    putChar('"');
+}
+
+void CommandWriter::putVarint(uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        putChar(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    putChar(static_cast<char>(v));
+}
+
+void CommandWriter::putDouble(double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+        putChar(static_cast<char>((bits >> (8 * i)) & 0xff));
+}
+
+void CommandWriter::sendName(const CompactCommandList& commands, uint32_t id)
+{
+    if (m_namesFrom != &commands || commands.numNames() < static_cast<int>(m_nameSent.size()))
+    {
+        if (m_namesFrom != nullptr)
+            putChar('R');
+        m_namesFrom = &commands;
+        m_nameSent.clear();
+    }
+    if (m_nameSent.size() <= id)
+        m_nameSent.resize(commands.numNames(), false);
+    if (m_nameSent[id])
+        return;
+    m_nameSent[id] = true;
+    const string& name = commands.name(id);
+    putChar('N');
+    putVarint(id);
+    putVarint(name.size());
+    put(name);
+}
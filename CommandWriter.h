@@ -0,0 +1,112 @@
+// CommandWriter.h
+
+// Compact DeliveryCommand encoding and a buffered writer that formats commands
+// straight into an output stream as text, JSON lines or binary records.
+
+#ifndef COMMANDWRITER_INCLUDED
+#define COMMANDWRITER_INCLUDED
+
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct CompactCommand
+{
+    enum Type : uint8_t { PROCEED, TURN, DELIVER };
+    enum Direction : uint8_t
+    {
+        EAST, NORTHEAST, NORTH, NORTHWEST, WEST, SOUTHWEST, SOUTH, SOUTHEAST,   // proceed
+        LEFT, RIGHT, STRAIGHT,                                                  // turn
+        NONE                                                                    // deliver
+    };
+
+    Type      type;
+    Direction direction;
+    uint32_t  nameId;      // street name (proceed/turn) or item (deliver) in the list's name table
+    double    distance;    // miles, proceed only
+};
+
+  // text used for a direction in instructions ("northeast", "left", ...)
+const char* directionName(CompactCommand::Direction dir);
+
+class CompactCommandList
+{
+public:
+    explicit CompactCommandList(Arena* arena = nullptr);       // arena, if any, holds the name index
+    void clear();
+    int size() const { return static_cast<int>(m_commands.size()); }
+    const CompactCommand& operator[](int i) const { return m_commands[i]; }
+    CompactCommand& operator[](int i) { return m_commands[i]; }
+
+    void addProceed(CompactCommand::Direction dir, const std::string& streetName, double dist);
+    void addTurn(CompactCommand::Direction dir, const std::string& streetName);
+      // the street's name is looked up by its map name id when it has one
+    void addProceed(CompactCommand::Direction dir, const StreetSegment& street, double dist);
+    void addTurn(CompactCommand::Direction dir, const StreetSegment& street);
+    void addDeliver(const std::string& item);
+    void append(const CompactCommandList& other);
+
+    int numNames() const { return static_cast<int>(m_names.size()); }
+    const std::string& name(uint32_t id) const { return m_names[id]; }
+    uint32_t internName(const std::string& s);
+    uint32_t internStreet(const StreetSegment& street);
+
+      // the equivalent full-size command, for callers of the DeliveryCommand API
+    DeliveryCommand toDeliveryCommand(int i) const;
+
+    CompactCommandList(const CompactCommandList&) = delete;
+    CompactCommandList& operator=(const CompactCommandList&) = delete;
+private:
+    std::vector<CompactCommand> m_commands;
+    std::vector<std::string> m_names;
+    ExpandableHashMap<std::string, uint32_t> m_nameIds;
+    ExpandableHashMap<int, uint32_t> m_streetIds;      // map name id -> id here
+};
+
+class CommandWriter
+{
+public:
+    enum Format { TEXT, JSON_LINES, BINARY };
+
+    CommandWriter(std::ostream& out, Format format, size_t bufferSize = 1 << 16);
+    ~CommandWriter();
+    Format format() const { return m_format; }
+
+    void beginPlan();
+    void write(const CompactCommandList& commands);
+    void write(const CompactCommandList& commands, int i);
+    void endPlan(double totalMiles);
+      // all of the commands as one JSON array on the current line, regardless of format
+    void writeJsonArray(const CompactCommandList& commands);
+      // raw output, for callers that frame the commands themselves
+    void put(const char* s, size_t n);
+    void put(const char* s);
+    void put(const std::string& s) { put(s.data(), s.size()); }
+    void putMiles(double miles);
+    void putJsonString(const std::string& s);
+    void flush();
+
+      // parses "text", "json" or "binary"; returns false for anything else
+    static bool parseFormat(const std::string& name, Format& format);
+
+    CommandWriter(const CommandWriter&) = delete;
+    CommandWriter& operator=(const CommandWriter&) = delete;
+private:
+    std::ostream&     m_out;
+    Format            m_format;
+    std::vector<char> m_buffer;
+    size_t            m_used;
+    const CompactCommandList* m_namesFrom;  // list whose names the binary stream has seen
+    std::vector<bool> m_nameSent;
+
+    void putChar(char c);
+    void putJsonCommand(const CompactCommandList& commands, int i);
+    void putVarint(uint64_t v);
+    void putDouble(double d);
+    void sendName(const CompactCommandList& commands, uint32_t id);
+};
+
+#endif // COMMANDWRITER_INCLUDED
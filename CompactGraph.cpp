@@ -0,0 +1,480 @@
+#include "CompactGraph.h"
+#include "ExpandableHashMap.h"
+#include "StreetGraph.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+// Block layout, per node in id order:
+//   unless the node is irregular:
+//     varint (zigzag(latitude - previous latitude) << 3 | latitude decimals)
+//     varint (zigzag(longitude - previous longitude) << 3 | longitude decimals)
+//   varint degree
+//   per edge: varint zigzag(target - node), varint name id
+// "previous" starts at 0 in every block, so blocks decode independently.
+//
+// Name table, in sorted order: the first name of every bucket is
+// varint length + text; the others are varint shared-prefix length with the
+// name before, varint suffix length + suffix.
+
+namespace
+{
+    const int MAX_DECIMALS = 7;
+    const int64_t FIXED_SCALE = 10000000;           // 10^MAX_DECIMALS
+    const int64_t POWERS_OF_TEN[MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+    void putVarint(vector<uint8_t>& out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    void putVarint(vector<char>& out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    template<typename Byte>
+    inline uint64_t getVarint(const Byte*& p)
+    {
+        uint64_t v = static_cast<uint8_t>(*p++);
+        if (v < 0x80)                                                       // most values are one byte
+            return v;
+        v &= 0x7f;
+        for (int shift = 7; ; shift += 7)
+        {
+            uint64_t b = static_cast<uint8_t>(*p++);
+            v |= (b & 0x7f) << shift;
+            if (b < 0x80)
+                return v;
+        }
+    }
+
+    inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+      // text as it would be written from a fixed-point value with that many decimals
+    void formatFixed(int64_t v, int decimals, string& text)
+    {
+        char buf[32];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        uint64_t magnitude = v < 0 ? -static_cast<uint64_t>(v) : v;
+        uint64_t whole = magnitude / FIXED_SCALE;
+        uint64_t fraction = magnitude % FIXED_SCALE / POWERS_OF_TEN[MAX_DECIMALS - decimals];
+        for (int i = 0; i < decimals; i++, fraction /= 10)
+            *--p = static_cast<char>('0' + fraction % 10);
+        if (decimals > 0)
+            *--p = '.';
+        do
+        {
+            *--p = static_cast<char>('0' + whole % 10);
+            whole /= 10;
+        } while (whole != 0);
+        if (v < 0)
+            *--p = '-';
+        text.assign(p, end);
+    }
+
+      // fixed-point value and decimals of a coordinate's text, if the text is
+      // exactly what formatFixed writes for them and fits the lookup keys
+    bool parseFixed(const string& text, int64_t& v, int& decimals)
+    {
+        size_t i = 0;
+        bool negative = i < text.size() && text[i] == '-';
+        if (negative)
+            i++;
+        size_t firstDigit = i;
+        int64_t whole = 0;
+        for ( ; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++)
+        {
+            whole = whole * 10 + (text[i] - '0');
+            if (whole > 2000)
+                return false;
+        }
+        if (i == firstDigit || (text[firstDigit] == '0' && i - firstDigit > 1))    // no digits, or a leading zero
+            return false;
+        int64_t fraction = 0;
+        decimals = 0;
+        if (i < text.size() && text[i] == '.')
+        {
+            for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++)
+            {
+                if (++decimals > MAX_DECIMALS)
+                    return false;
+                fraction = fraction * 10 + (text[i] - '0');
+            }
+            if (decimals == 0)
+                return false;
+        }
+        if (i != text.size())
+            return false;
+        v = whole * FIXED_SCALE + fraction * POWERS_OF_TEN[MAX_DECIMALS - decimals];
+        if (negative)
+        {
+            if (v == 0)                                                     // "-0" does not come back
+                return false;
+            v = -v;
+        }
+        return v > INT32_MIN && v < INT32_MAX;
+    }
+
+    inline uint64_t keyOf(int64_t lat, int64_t lon)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(lat + 0x80000000LL)) << 32 | static_cast<uint32_t>(lon + 0x80000000LL);
+    }
+}
+
+CompactGraph::CompactGraph()
+ : m_numEdges(0), m_numNames(0)
+{
+}
+
+void CompactGraph::build(const StreetGraph& graph)
+{
+    int numNodes = graph.numNodes();
+    m_numEdges = graph.numEdges();
+
+      // street names: deduplicate, sort, front-code
+    ExpandableHashMap<string, int> nameIds;
+    vector<const string*> names;
+    vector<int> edgeName(m_numEdges);
+    for (int e = 0; e < m_numEdges; e++)
+    {
+        const string& name = graph.name(e);
+        const int* id = nameIds.find(name);
+        if (id == nullptr)
+        {
+            nameIds.associate(name, static_cast<int>(names.size()));
+            edgeName[e] = static_cast<int>(names.size());
+            names.push_back(&name);
+        }
+        else
+            edgeName[e] = *id;
+    }
+    m_numNames = static_cast<int>(names.size());
+    vector<int> order(m_numNames);
+    for (int i = 0; i < m_numNames; i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&names](int a, int b) { return *names[a] < *names[b]; });
+    vector<int> rank(m_numNames);
+    m_nameBytes.clear();
+    m_nameBuckets.clear();
+    for (int i = 0; i < m_numNames; i++)
+    {
+        rank[order[i]] = i;
+        const string& name = *names[order[i]];
+        if (i % NAME_BUCKET == 0)
+        {
+            m_nameBuckets.push_back(static_cast<uint32_t>(m_nameBytes.size()));
+            putVarint(m_nameBytes, name.size());
+            m_nameBytes.insert(m_nameBytes.end(), name.begin(), name.end());
+            continue;
+        }
+        const string& previous = *names[order[i - 1]];
+        size_t shared = 0;
+        while (shared < name.size() && shared < previous.size() && name[shared] == previous[shared])
+            shared++;
+        putVarint(m_nameBytes, shared);
+        putVarint(m_nameBytes, name.size() - shared);
+        m_nameBytes.insert(m_nameBytes.end(), name.begin() + shared, name.end());
+    }
+
+      // blocks, and the lookup keys of every regular node
+    m_bytes.clear();
+    m_blockOffset.clear();
+    m_blockFirstEdge.clear();
+    m_keys.clear();
+    m_irregular.clear();
+    vector<pair<uint64_t, int> > keyed;
+    vector<uint8_t> decimalsOf(numNodes);
+    string text;
+    for (int first = 0; first < numNodes; first += BLOCK_NODES)
+    {
+        m_blockOffset.push_back(static_cast<uint32_t>(m_bytes.size()));
+        m_blockFirstEdge.push_back(graph.firstEdge(first));
+        int64_t lat = 0, lon = 0;
+        for (int n = first; n < min(first + BLOCK_NODES, numNodes); n++)
+        {
+            const GeoCoord& gc = graph.coord(n);
+            int64_t nodeLat, nodeLon;
+            int latDecimals, lonDecimals;
+            bool regular = parseFixed(gc.latitudeText, nodeLat, latDecimals) && parseFixed(gc.longitudeText, nodeLon, lonDecimals);
+            if (regular)                                                    // the cursor must give back this exact GeoCoord
+            {
+                formatFixed(nodeLat, latDecimals, text);
+                regular = text == gc.latitudeText && static_cast<double>(nodeLat) / FIXED_SCALE == gc.latitude;
+                formatFixed(nodeLon, lonDecimals, text);
+                regular = regular && text == gc.longitudeText && static_cast<double>(nodeLon) / FIXED_SCALE == gc.longitude;
+            }
+            if (regular)
+            {
+                putVarint(m_bytes, zigzag(nodeLat - lat) << 3 | latDecimals);
+                putVarint(m_bytes, zigzag(nodeLon - lon) << 3 | lonDecimals);
+                lat = nodeLat;
+                lon = nodeLon;
+                keyed.push_back(make_pair(keyOf(nodeLat, nodeLon), n));
+                decimalsOf[n] = static_cast<uint8_t>(latDecimals << 4 | lonDecimals);
+            }
+            else
+                m_irregular.push_back(make_pair(n, gc));
+            putVarint(m_bytes, graph.endEdge(n) - graph.firstEdge(n));
+            for (int e = graph.firstEdge(n); e < graph.endEdge(n); e++)
+            {
+                putVarint(m_bytes, zigzag(static_cast<int64_t>(graph.target(e)) - n));
+                putVarint(m_bytes, rank[edgeName[e]]);
+            }
+        }
+    }
+    m_blockOffset.push_back(static_cast<uint32_t>(m_bytes.size()));
+    m_blockFirstEdge.push_back(m_numEdges);
+    m_bytes.shrink_to_fit();
+
+    sort(keyed.begin(), keyed.end());
+    m_keys.resize(keyed.size());
+    m_keyNodes.resize(keyed.size());
+    m_keyDecimals.resize(keyed.size());
+    for (size_t i = 0; i < keyed.size(); i++)
+    {
+        m_keys[i] = keyed[i].first;
+        m_keyNodes[i] = keyed[i].second;
+        m_keyDecimals[i] = decimalsOf[keyed[i].second];
+    }
+    m_irregularByCoord.resize(m_irregular.size());
+    for (size_t i = 0; i < m_irregular.size(); i++)
+        m_irregularByCoord[i] = static_cast<int>(i);
+    sort(m_irregularByCoord.begin(), m_irregularByCoord.end(),
+         [this](int a, int b) { return m_irregular[a].second < m_irregular[b].second; });
+
+    m_component.resize(numNodes);
+    for (int n = 0; n < numNodes; n++)
+        m_component[n] = graph.component(n);
+}
+
+int CompactGraph::nodeAt(const GeoCoord& gc) const
+{
+    int64_t lat, lon;
+    int latDecimals, lonDecimals;
+    if (parseFixed(gc.latitudeText, lat, latDecimals) && parseFixed(gc.longitudeText, lon, lonDecimals))
+    {
+        uint8_t decimals = static_cast<uint8_t>(latDecimals << 4 | lonDecimals);
+        uint64_t key = keyOf(lat, lon);
+        for (size_t i = lower_bound(m_keys.begin(), m_keys.end(), key) - m_keys.begin(); i < m_keys.size() && m_keys[i] == key; i++)
+            if (m_keyDecimals[i] == decimals)
+                return m_keyNodes[i];
+    }
+    auto found = lower_bound(m_irregularByCoord.begin(), m_irregularByCoord.end(), gc,
+                             [this](int i, const GeoCoord& g) { return m_irregular[i].second < g; });
+    if (found != m_irregularByCoord.end() && m_irregular[*found].second == gc)
+        return m_irregular[*found].first;
+    return -1;
+}
+
+string CompactGraph::nameOf(int nameId) const
+{
+    const char* p = &m_nameBytes[m_nameBuckets[nameId / NAME_BUCKET]];
+    size_t length = getVarint(p);
+    string name(p, length);
+    p += length;
+    for (int i = 0; i < nameId % NAME_BUCKET; i++)
+    {
+        size_t shared = getVarint(p);
+        size_t suffix = getVarint(p);
+        name.resize(shared);
+        name.append(p, suffix);
+        p += suffix;
+    }
+    return name;
+}
+
+long CompactGraph::memoryUsage() const
+{
+    long bytes = m_bytes.capacity() + m_nameBytes.capacity();
+    bytes += (m_blockOffset.capacity() + m_nameBuckets.capacity()) * sizeof(uint32_t);
+    bytes += (m_blockFirstEdge.capacity() + m_component.capacity()) * sizeof(int);
+    return bytes + indexMemoryUsage();
+}
+
+long CompactGraph::indexMemoryUsage() const
+{
+    long bytes = m_keys.capacity() * sizeof(uint64_t) + m_keyNodes.capacity() * sizeof(int) + m_keyDecimals.capacity();
+    bytes += m_irregular.capacity() * sizeof(pair<int, GeoCoord>) + m_irregularByCoord.capacity() * sizeof(int);
+    for (size_t i = 0; i < m_irregular.size(); i++)
+        bytes += m_irregular[i].second.latitudeText.capacity() + m_irregular[i].second.longitudeText.capacity();
+    return bytes;
+}
+
+const GeoCoord* CompactGraph::irregular(int node) const
+{
+    auto found = lower_bound(m_irregular.begin(), m_irregular.end(), node,
+                             [](const pair<int, GeoCoord>& p, int n) { return p.first < n; });
+    return found != m_irregular.end() && found->first == node ? &found->second : nullptr;
+}
+
+//******************** Cursor functions ***************************************
+
+CompactGraph::Cursor::Cursor(const CompactGraph& graph)
+ : m_graph(graph), m_cache(CACHE_BLOCKS), m_edgeBlock(-1)
+{
+    for (size_t i = 0; i < m_cache.size(); i++)
+        m_cache[i].index = -1;
+}
+
+const CompactGraph::Cursor::Block& CompactGraph::Cursor::block(int index) const
+{
+    Block& b = m_cache[index % CACHE_BLOCKS];
+    if (b.index == index)
+        return b;
+    b.index = index;
+    b.firstEdge = m_graph.m_blockFirstEdge[index];
+    b.edges.clear();
+    const uint8_t* p = &m_graph.m_bytes[0] + m_graph.m_blockOffset[index];
+    int first = index * BLOCK_NODES;
+    int count = min(BLOCK_NODES, m_graph.numNodes() - first);
+    int64_t lat = 0, lon = 0;
+    b.edgeBegin[0] = 0;
+    b.hasText = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int node = first + i;
+        const GeoCoord* verbatim = m_graph.m_irregular.empty() ? nullptr : m_graph.irregular(node);
+        if (verbatim != nullptr)
+        {
+            b.coords[i] = *verbatim;
+            b.hasText |= 1u << i;
+        }
+        else
+        {
+            uint64_t v = getVarint(p);
+            lat += unzigzag(v >> 3);
+            b.decimals[i] = static_cast<uint8_t>((v & 7) << 4);
+            v = getVarint(p);
+            lon += unzigzag(v >> 3);
+            b.decimals[i] |= static_cast<uint8_t>(v & 7);
+            b.fixed[i][0] = lat;
+            b.fixed[i][1] = lon;
+            b.coords[i].latitude = static_cast<double>(lat) / FIXED_SCALE;  // rounds exactly as stod does on the text
+            b.coords[i].longitude = static_cast<double>(lon) / FIXED_SCALE;
+        }
+        int degree = static_cast<int>(getVarint(p));
+        for (int j = 0; j < degree; j++)
+        {
+            int to = static_cast<int>(node + unzigzag(getVarint(p)));
+            b.edges.push_back(make_pair(to, static_cast<int>(getVarint(p))));
+        }
+        b.edgeBegin[i + 1] = static_cast<int>(b.edges.size());
+    }
+    for (int i = count; i < BLOCK_NODES; i++)                               // a short last block
+        b.edgeBegin[i + 1] = b.edgeBegin[count];
+    return b;
+}
+
+const CompactGraph::Cursor::Block& CompactGraph::Cursor::blockOfEdge(int edge) const
+{
+    const vector<int>& firstEdges = m_graph.m_blockFirstEdge;
+    if (m_edgeBlock < 0 || edge < firstEdges[m_edgeBlock] || edge >= firstEdges[m_edgeBlock + 1])
+        m_edgeBlock = static_cast<int>(upper_bound(firstEdges.begin(), firstEdges.end(), edge) - firstEdges.begin()) - 1;
+    return block(m_edgeBlock);
+}
+
+const GeoCoord& CompactGraph::Cursor::coord(int node) const
+{
+    Block& b = const_cast<Block&>(block(node / BLOCK_NODES));
+    int i = node % BLOCK_NODES;
+    if ((b.hasText & (1u << i)) == 0)
+    {
+        formatFixed(b.fixed[i][0], b.decimals[i] >> 4, b.coords[i].latitudeText);
+        formatFixed(b.fixed[i][1], b.decimals[i] & 15, b.coords[i].longitudeText);
+        b.hasText |= 1u << i;
+    }
+    return b.coords[i];
+}
+
+GeoPoint CompactGraph::Cursor::point(int node) const
+{
+    const GeoCoord& gc = block(node / BLOCK_NODES).coords[node % BLOCK_NODES];          // only the doubles are read
+    return GeoPoint{ gc.latitude, gc.longitude };
+}
+
+double CompactGraph::Cursor::milesTo(int node, const GeoCoord& gc) const
+{
+    return distanceEarthMiles(block(node / BLOCK_NODES).coords[node % BLOCK_NODES], gc);    // only the doubles are read
+}
+
+double CompactGraph::Cursor::milesTo(int node, const GeoCoord& gc, const FlatEarth& flat) const
+{
+    return flat.miles(block(node / BLOCK_NODES).coords[node % BLOCK_NODES], gc);
+}
+
+int CompactGraph::Cursor::firstEdge(int node) const
+{
+    m_edgeBlock = node / BLOCK_NODES;                                       // the node's edges are usually next
+    const Block& b = block(m_edgeBlock);
+    return b.firstEdge + b.edgeBegin[node % BLOCK_NODES];
+}
+
+int CompactGraph::Cursor::endEdge(int node) const
+{
+    const Block& b = block(node / BLOCK_NODES);
+    return b.firstEdge + b.edgeBegin[node % BLOCK_NODES + 1];
+}
+
+int CompactGraph::Cursor::target(int edge) const
+{
+    const Block& b = blockOfEdge(edge);
+    return b.edges[edge - b.firstEdge].first;
+}
+
+double CompactGraph::Cursor::length(int edge) const
+{
+    const Block& b = blockOfEdge(edge);
+    int source = static_cast<int>(upper_bound(b.edgeBegin, b.edgeBegin + BLOCK_NODES + 1, edge - b.firstEdge) - b.edgeBegin) - 1;
+    GeoCoord from = b.coords[source];                                       // copied: coord() may reuse the slot
+    int to = b.edges[edge - b.firstEdge].first;
+    return distanceEarthMiles(from, coord(to));
+}
+
+string CompactGraph::Cursor::name(int edge) const
+{
+    const Block& b = blockOfEdge(edge);
+    return m_graph.nameOf(b.edges[edge - b.firstEdge].second);
+}
+
+int CompactGraph::Cursor::nameId(int edge) const
+{
+    const Block& b = blockOfEdge(edge);
+    return b.edges[edge - b.firstEdge].second;
+}
+
+StreetSegment CompactGraph::Cursor::segment(int node, int edge) const
+{
+    const Block& b = blockOfEdge(edge);
+    int to = b.edges[edge - b.firstEdge].first;
+    int streetNameId = b.edges[edge - b.firstEdge].second;
+    string streetName = m_graph.nameOf(streetNameId);
+    GeoCoord from = coord(node);
+    return StreetSegment(from, coord(to), streetName, streetNameId);
+}
+
+//******************** compact mode *******************************************
+
+static bool s_compactMaps = false;
+
+void setCompactMaps(bool compact)
+{
+    s_compactMaps = compact;
+}
+
+bool compactMaps()
+{
+    return s_compactMaps;
+}
@@ -0,0 +1,126 @@
+// CompactGraph.h
+
+// The street network in a compressed, read-only form, for serving region-wide
+// maps (or many map shards) from one box.  StreetMap::load builds one from its
+// StreetGraph and drops the StreetGraph when compact maps are switched on.
+//
+// Nodes keep the StreetGraph's Hilbert-ordered ids and are stored in blocks of
+// BLOCK_NODES.  Within a block each node is a byte string of varints:
+// coordinates as fixed-point (1e-7 degree) deltas from the previous node,
+// the degree, then each edge's target as a delta from the node and its street
+// name id.  Edges stay in the StreetGraph's order, so searches see them
+// exactly as before.  Lengths are not stored; they are recomputed from the
+// coordinates, which decode to the same doubles the text parses to.  Street
+// names are deduplicated into a sorted table with front coding.
+//
+// Coordinates whose text does not survive the fixed-point round trip (more
+// than 7 decimals, a leading '+', ...) are kept aside verbatim, so
+// intersections still compare by their text.
+//
+// A Cursor presents StreetGraph's interface over the compressed bytes.  It
+// decodes the blocks a search touches into a small cache of its own and
+// belongs to one search on one thread.
+
+#ifndef COMPACTGRAPH_INCLUDED
+#define COMPACTGRAPH_INCLUDED
+
+#include "provided.h"
+#include "FlatEarth.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class StreetGraph;
+
+  // whether StreetMap::load keeps maps in compact form (off by default)
+void setCompactMaps(bool compact);
+bool compactMaps();
+
+class CompactGraph
+{
+public:
+    static const int BLOCK_NODES = 16;
+    static const int NAME_BUCKET = 16;          // names per front-coded run
+
+    CompactGraph();
+    void build(const StreetGraph& graph);
+
+    int numNodes() const { return static_cast<int>(m_component.size()); }
+    int numEdges() const { return m_numEdges; }
+      // node at the intersection gc, or -1 if gc is not an intersection
+    int nodeAt(const GeoCoord& gc) const;
+    int component(int node) const { return m_component[node]; }
+    int numNames() const { return m_numNames; }
+    std::string nameOf(int nameId) const;
+
+    long memoryUsage() const;
+    long indexMemoryUsage() const;              // the coordinate lookup within memoryUsage
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const CompactGraph& graph);
+        int numNodes() const { return m_graph.numNodes(); }
+        int nodeAt(const GeoCoord& gc) const { return m_graph.nodeAt(gc); }
+          // the reference is good until the next call on this cursor
+        const GeoCoord& coord(int node) const;
+        GeoPoint point(int node) const;                         // without decoding the node's text
+        double milesTo(int node, const GeoCoord& gc) const;     // without decoding the node's text
+        double milesTo(int node, const GeoCoord& gc, const FlatEarth& flat) const;
+        int component(int node) const { return m_graph.component(node); }
+        int firstEdge(int node) const;
+        int endEdge(int node) const;
+        int target(int edge) const;
+        double length(int edge) const;          // miles
+        bool open(int) const { return true; }
+        std::string name(int edge) const;
+        int nameId(int edge) const;
+        StreetSegment segment(int node, int edge) const;
+    private:
+        static const int CACHE_BLOCKS = 256;     // direct-mapped by block index
+
+        struct Block
+        {
+            int index;
+            int firstEdge;
+            GeoCoord coords[BLOCK_NODES];       // texts filled in on first use
+            int64_t fixed[BLOCK_NODES][2];
+            uint8_t decimals[BLOCK_NODES];
+            unsigned int hasText;               // bit per node
+            int edgeBegin[BLOCK_NODES + 1];     // relative to firstEdge
+            std::vector<std::pair<int, int> > edges;    // (target, name id)
+        };
+
+        const CompactGraph& m_graph;
+        mutable std::vector<Block> m_cache;
+        mutable int m_edgeBlock;                // block of the last edge lookup
+
+        const Block& block(int index) const;
+        const Block& blockOfEdge(int edge) const;
+    };
+
+    CompactGraph(const CompactGraph&) = delete;
+    CompactGraph& operator=(const CompactGraph&) = delete;
+private:
+    int m_numEdges;
+    std::vector<uint8_t> m_bytes;               // every block, back to back
+    std::vector<uint32_t> m_blockOffset;        // numBlocks+1 offsets into m_bytes
+    std::vector<int> m_blockFirstEdge;          // numBlocks+1
+    std::vector<int> m_component;
+
+      // lookup by fixed-point (latitude, longitude), sorted
+    std::vector<uint64_t> m_keys;
+    std::vector<int> m_keyNodes;
+    std::vector<uint8_t> m_keyDecimals;         // latitude decimals << 4 | longitude decimals
+    std::vector<std::pair<int, GeoCoord> > m_irregular;     // by node; not in the stream or the keys
+    std::vector<int> m_irregularByCoord;        // indexes into m_irregular, by coordinate
+
+    int m_numNames;
+    std::vector<char> m_nameBytes;
+    std::vector<uint32_t> m_nameBuckets;        // offset of every NAME_BUCKET-th name
+
+    const GeoCoord* irregular(int node) const;
+};
+
+#endif // COMPACTGRAPH_INCLUDED
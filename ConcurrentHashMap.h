@@ -0,0 +1,147 @@
+// ConcurrentHashMap.h
+
+// A hash map that many threads can insert into at once, for building indexes
+// in parallel.  Keys are spread over a fixed number of shards by hash, each an
+// ExpandableHashMap behind its own mutex, so writers only contend when they
+// hit the same shard and a resize only stalls the shard it happens in.
+//
+// find() takes the shard's lock and may run alongside writers.  Once building
+// is over and no thread writes any more, findWhenQuiet() reads without locking
+// and returns a pointer that stays valid until the next write.
+
+#ifndef CONCURRENTHASHMAP_INCLUDED
+#define CONCURRENTHASHMAP_INCLUDED
+
+#include "ExpandableHashMap.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+template<typename KeyType, typename ValueType>
+class ConcurrentHashMap
+{
+public:
+    ConcurrentHashMap(int numShards = 64, double maximumLoadFactor = 0.5);   // numShards is rounded up to a power of two
+
+      // If key is absent, associates it with makeValue(), called under the
+      // shard's lock.  Returns the value key ends up associated with.
+    template<typename MakeValue>
+    ValueType associateIfAbsent(const KeyType& key, MakeValue makeValue);
+    ValueType associateIfAbsent(const KeyType& key, const ValueType& value)
+    {
+        return associateIfAbsent(key, [&value]() { return value; });
+    }
+    void associate(const KeyType& key, const ValueType& value);
+    bool find(const KeyType& key, ValueType& value) const;
+    const ValueType* findWhenQuiet(const KeyType& key) const;
+
+      // calls f(key, value) for every association; not safe alongside writers
+    template<typename F>
+    void forEach(F f);
+      // empties every shard; not safe alongside other calls
+    void reset();
+
+    long memoryUsage() const;
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+private:
+    struct alignas(64) Shard                    // one cache line per lock
+    {
+        Shard(double maximumLoadFactor) : map(maximumLoadFactor) {}
+        mutable std::mutex lock;
+        ExpandableHashMap<KeyType, ValueType> map;
+    };
+
+    std::vector<std::unique_ptr<Shard> > m_shards;
+    int m_shardBits;
+
+    Shard& shardFor(const KeyType& key) const;
+};
+
+template<typename KeyType, typename ValueType>
+ConcurrentHashMap<KeyType, ValueType>::ConcurrentHashMap(int numShards, double maximumLoadFactor)
+{
+    m_shardBits = 0;
+    while ((1 << m_shardBits) < numShards)
+        m_shardBits++;
+    for (int i = 0; i < (1 << m_shardBits); i++)
+        m_shards.push_back(std::unique_ptr<Shard>(new Shard(maximumLoadFactor)));
+}
+
+template<typename KeyType, typename ValueType>
+typename ConcurrentHashMap<KeyType, ValueType>::Shard& ConcurrentHashMap<KeyType, ValueType>::shardFor(const KeyType& key) const
+{
+      // the shard comes from the top bits of the mixed hash; buckets within a
+      // shard use the low bits, so the two choices stay independent
+    if (m_shardBits == 0)
+        return *m_shards[0];
+    unsigned int mixed = hasher(key) * 2654435761u;
+    return *m_shards[mixed >> (32 - m_shardBits)];
+}
+
+template<typename KeyType, typename ValueType>
+template<typename MakeValue>
+ValueType ConcurrentHashMap<KeyType, ValueType>::associateIfAbsent(const KeyType& key, MakeValue makeValue)
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    const ValueType* existing = shard.map.find(key);
+    if (existing != nullptr)
+        return *existing;
+    ValueType value = makeValue();
+    shard.map.associate(key, value);
+    return value;
+}
+
+template<typename KeyType, typename ValueType>
+void ConcurrentHashMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.map.associate(key, value);
+}
+
+template<typename KeyType, typename ValueType>
+bool ConcurrentHashMap<KeyType, ValueType>::find(const KeyType& key, ValueType& value) const
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    const ValueType* found = shard.map.find(key);
+    if (found == nullptr)
+        return false;
+    value = *found;
+    return true;
+}
+
+template<typename KeyType, typename ValueType>
+const ValueType* ConcurrentHashMap<KeyType, ValueType>::findWhenQuiet(const KeyType& key) const
+{
+    return shardFor(key).map.find(key);
+}
+
+template<typename KeyType, typename ValueType>
+template<typename F>
+void ConcurrentHashMap<KeyType, ValueType>::forEach(F f)
+{
+    for (size_t i = 0; i < m_shards.size(); i++)
+        m_shards[i]->map.forEach(f);
+}
+
+template<typename KeyType, typename ValueType>
+void ConcurrentHashMap<KeyType, ValueType>::reset()
+{
+    for (size_t i = 0; i < m_shards.size(); i++)
+        m_shards[i]->map.reset();
+}
+
+template<typename KeyType, typename ValueType>
+long ConcurrentHashMap<KeyType, ValueType>::memoryUsage() const
+{
+    long bytes = static_cast<long>(sizeof(Shard)) * m_shards.size();
+    for (size_t i = 0; i < m_shards.size(); i++)
+        bytes += m_shards[i]->map.memoryUsage();
+    return bytes;
+}
+
+#endif // CONCURRENTHASHMAP_INCLUDED
@@ -1,4 +1,7 @@
 #include "provided.h"
+#include "FlatEarth.h"
+#include "HubLabels.h"
+#include "Stats.h"
 #include <vector>
 #include <algorithm>
 using namespace std;
@@ -15,6 +18,8 @@ public:
         double& newCrowDistance) const;
 private:
     const StreetMap* m_streetmap;
+
+    void improveByRoad(const HubLabels& labels, const GeoCoord& depot, vector<DeliveryRequest>& deliveries) const;
 };
 
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
@@ -32,6 +37,7 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     double& oldCrowDistance,
     double& newCrowDistance) const
 {
+    STATS_TIMER(optimizeMs);
     oldCrowDistance = 0;
     for (int i = 0; i < deliveries.size(); i++)
     {
@@ -44,19 +50,30 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     
     vector<DeliveryRequest> sortedDeliveries;
     GeoCoord currentStartPoint = depot;
-    auto compDistanceFromStartPoint = [&currentStartPoint](DeliveryRequest loc1, DeliveryRequest loc2)
+    auto compDistanceFromStartPoint = [&currentStartPoint](const DeliveryRequest& loc1, const DeliveryRequest& loc2)
     {
         if (distanceEarthMiles(currentStartPoint, loc1.location) < distanceEarthMiles(currentStartPoint, loc2.location))
             return true;
         else
             return false;
     };
+    FlatEarth flat(depot.latitude);                                         // the stops are all near the depot
+    auto compFlatDistanceFromStartPoint = [&currentStartPoint, &flat](const DeliveryRequest& loc1, const DeliveryRequest& loc2)
+    {
+        return flat.squaredMiles(currentStartPoint, loc1.location) < flat.squaredMiles(currentStartPoint, loc2.location);
+    };
     
     for (int i = 0; i < deliveries.size(); i++)
     {
-        sort(deliveries.begin()+i, deliveries.end(), compDistanceFromStartPoint);
+        if (fastDistance())
+            sort(deliveries.begin()+i, deliveries.end(), compFlatDistanceFromStartPoint);
+        else
+            sort(deliveries.begin()+i, deliveries.end(), compDistanceFromStartPoint);
         currentStartPoint = deliveries[i].location;
     }
+    const HubLabels* labels = m_streetmap->hubLabels();
+    if (labels != nullptr)                                                  // road costs are cheap enough to search on
+        improveByRoad(*labels, depot, deliveries);
     newCrowDistance = 0;
     for (int i = 0; i < deliveries.size(); i++)
     {
@@ -68,6 +85,82 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     oldCrowDistance += distanceEarthMiles(deliveries[deliveries.size()-1].location, depot);
 }
 
+  // Local search on the greedy order with road costs from the hub labels (miles,
+  // or whatever routeCost() the map was loaded with):
+  // 2-opt (reverse a stretch of the tour) and or-opt (move a run of up to
+  // three stops elsewhere), until neither shortens the tour.  The depot stays
+  // at both ends.  The order is left alone if any stop is off the road network.
+void DeliveryOptimizerImpl::improveByRoad(const HubLabels& labels, const GeoCoord& depot, vector<DeliveryRequest>& deliveries) const
+{
+    const double EPSILON = 1e-9;
+    int numStops = static_cast<int>(deliveries.size()) + 1;                 // stop 0 is the depot
+    vector<int> nodes(numStops);
+    nodes[0] = m_streetmap->intersectionId(depot);
+    for (int i = 1; i < numStops; i++)
+        nodes[i] = m_streetmap->intersectionId(deliveries[i - 1].location);
+    for (int i = 0; i < numStops; i++)
+        if (nodes[i] < 0)
+            return;
+    vector<double> road(numStops * numStops);
+    for (int i = 0; i < numStops; i++)
+        for (int j = 0; j < numStops; j++)
+        {
+            road[i * numStops + j] = labels.distance(nodes[i], nodes[j]);
+            if (road[i * numStops + j] < 0)                                 // unreachable; the planner reports it
+                return;
+        }
+    auto cost = [&road, numStops](int a, int b) { return road[a * numStops + b]; };
+
+    vector<int> tour(numStops);                                             // tour[k+1 mod numStops] follows tour[k]
+    for (int i = 0; i < numStops; i++)
+        tour[i] = i;
+    bool improved = true;
+    while (improved)
+    {
+        improved = false;
+        for (int i = 0; i + 2 < numStops; i++)                              // 2-opt: reverse tour[i+1..j]
+        {
+            for (int j = i + 2; j < numStops; j++)
+            {
+                int a = tour[i], b = tour[i + 1], c = tour[j], d = tour[(j + 1) % numStops];
+                if (cost(a, c) + cost(b, d) < cost(a, b) + cost(c, d) - EPSILON)
+                {
+                    reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+        for (int length = 1; length <= 3; length++)                         // or-opt: move tour[i..i+length-1]
+        {
+            for (int i = 1; i + length <= numStops; i++)
+            {
+                int prev = tour[i - 1], first = tour[i], last = tour[i + length - 1], next = tour[(i + length) % numStops];
+                double removed = cost(prev, first) + cost(last, next) - cost(prev, next);
+                for (int j = 0; j < numStops; j++)                          // insert between tour[j] and the stop after it
+                {
+                    if (j >= i - 1 && j < i + length)
+                        continue;
+                    int a = tour[j], b = tour[(j + 1) % numStops];
+                    if (cost(a, first) + cost(last, b) - cost(a, b) < removed - EPSILON)
+                    {
+                        vector<int> run(tour.begin() + i, tour.begin() + i + length);
+                        tour.erase(tour.begin() + i, tour.begin() + i + length);
+                        int at = (j < i ? j : j - length) + 1;
+                        tour.insert(tour.begin() + at, run.begin(), run.end());
+                        improved = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    vector<DeliveryRequest> ordered;
+    ordered.reserve(deliveries.size());
+    for (int k = 1; k < numStops; k++)
+        ordered.push_back(deliveries[tour[k] - 1]);
+    deliveries.swap(ordered);
+}
+
 //******************** DeliveryOptimizer functions ****************************
 
 // These functions simply delegate to DeliveryOptimizerImpl's functions.
@@ -1,4 +1,15 @@
 #include "provided.h"
+#include "Arena.h"
+#include "CommandWriter.h"
+#include "QueryLog.h"
+#include "Stats.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <thread>
 #include <vector>
 using namespace std;
 
@@ -10,14 +21,34 @@ public:
     DeliveryResult generateDeliveryPlan(
         const GeoCoord& depot,
         const vector<DeliveryRequest>& deliveries,
-        vector<DeliveryCommand>& commands,
+        CompactCommandList& commands,
         double& totalDistanceTravelled) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+    DeliveryResult streamDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        CompactCommandList& commands,
+        const LegReadyCallback& legReady,
+        double& totalDistanceTravelled,
+        int routeThreads) const;
+    DeliveryResult addDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery) const;
+    DeliveryResult removeDelivery(DeliveryPlan& plan, int deliveryIndex) const;
+    DeliveryResult moveStart(DeliveryPlan& plan, const GeoCoord& position) const;
 private:
     const StreetMap* m_streetMap;
     PointToPointRouter m_generateRoute;
     
-    string getDirection(double angle) const;
-    string getTurnDirection(double angle) const;
+    const GeoCoord& waypoint(const DeliveryPlan& plan, int i) const;
+    double crowCost(const DeliveryPlan& plan, int first, int last) const;
+    DeliveryResult routeLegs(const DeliveryPlan& plan, int firstLeg, int numLegs, vector<DeliveryLeg>& legs) const;
+    void spliceLegs(DeliveryPlan& plan, int firstLeg, int oldLegs, vector<DeliveryLeg>& newLegs) const;
+    DeliveryResult checkReachable(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries) const;
+    void addRouteCommands(const list<StreetSegment>& route, CompactCommandList& commands) const;
+    CompactCommand::Direction getDirection(double angle) const;
+    CompactCommand::Direction getTurnDirection(double angle) const;
 };
 
 DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm)
@@ -33,141 +64,436 @@ DeliveryPlannerImpl::~DeliveryPlannerImpl()
 DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     const GeoCoord& depot,
     const vector<DeliveryRequest>& deliveries,
-    vector<DeliveryCommand>& commands,
+    CompactCommandList& commands,
     double& totalDistanceTravelled) const
 {
+    ArenaScope planScratch(threadArena());                                  // per-plan temporaries, released on return
+    STATS_TIMER(planMs);
+    totalDistanceTravelled = 0;
+    if (deliveries.empty())
+        return DELIVERY_SUCCESS;
+    DeliveryResult reachable = checkReachable(depot, deliveries);                                     // fail before routing any leg
+    if (reachable != DELIVERY_SUCCESS)
+        return reachable;
     double oldCrowDistance, newCrowDistance;
     DeliveryOptimizer optimizer(m_streetMap);
     vector<DeliveryRequest> copyDeliveries = deliveries;
     optimizer.optimizeDeliveryOrder(depot, copyDeliveries, oldCrowDistance, newCrowDistance);                                           // optimize delivery order
-    totalDistanceTravelled = 0;
-    double requestDistance;
-    double segmentDistance;
-    double lineAngle;
-    string direction;
-    DeliveryCommand tempCommand;
+    
     list<StreetSegment> route;
-    DeliveryResult testPossible = m_generateRoute.generatePointToPointRoute(depot, copyDeliveries[0].location, route, requestDistance); // check if route is possible
-    if (testPossible == NO_ROUTE)
+    double requestDistance;
+    GeoCoord legStart = depot;
+    for (size_t deliveryNum = 0; deliveryNum <= copyDeliveries.size(); deliveryNum++)                  // one leg per delivery, then back to the depot
     {
-        return NO_ROUTE;
+        const GeoCoord& legEnd = deliveryNum < copyDeliveries.size() ? copyDeliveries[deliveryNum].location : depot;
+        DeliveryResult testPossible = m_generateRoute.generatePointToPointRoute(legStart, legEnd, route, requestDistance);  // check if route is possible
+        if (testPossible != DELIVERY_SUCCESS)
+            return testPossible;
+        totalDistanceTravelled += requestDistance;
+        addRouteCommands(route, commands);
+        if (deliveryNum < copyDeliveries.size())
+            commands.addDeliver(copyDeliveries[deliveryNum].item);
+        legStart = legEnd;
     }
-    else if (testPossible == BAD_COORD)
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    ArenaScope planScratch(threadArena());
+    STATS_TIMER(planMs);
+    DeliveryResult reachable = checkReachable(depot, deliveries);
+    if (reachable != DELIVERY_SUCCESS)
+        return reachable;
+    DeliveryPlan newPlan;
+    newPlan.depot = depot;
+    newPlan.start = depot;
+    newPlan.deliveries = deliveries;
+    newPlan.totalDistanceTravelled = 0;
+    if (!newPlan.deliveries.empty())
     {
-        return BAD_COORD;
+        double oldCrowDistance, newCrowDistance;
+        DeliveryOptimizer optimizer(m_streetMap);
+        optimizer.optimizeDeliveryOrder(depot, newPlan.deliveries, oldCrowDistance, newCrowDistance);
     }
-    list<StreetSegment>::iterator it = route.begin();
-    list<StreetSegment>::iterator segmentIt = route.begin()++;
-    totalDistanceTravelled += requestDistance;
-    
-    int deliveryNum = 0;
-    string tempItem = copyDeliveries[0].item;
-    while (it != route.end())                                                       // goes till end of a route
+    DeliveryResult result = routeLegs(newPlan, 0, static_cast<int>(newPlan.deliveries.size()) + 1, newPlan.legs);
+    if (result != DELIVERY_SUCCESS)
+        return result;
+    for (size_t i = 0; i < newPlan.legs.size(); i++)
+        newPlan.totalDistanceTravelled += newPlan.legs[i].distance;
+    plan = move(newPlan);
+    return DELIVERY_SUCCESS;
+}
+
+  // The routing threads take legs in order from a shared counter and post
+  // each route to its slot; this thread waits for the slots in order.  The
+  // routing threads' search counters stay in their own threadStats().
+DeliveryResult DeliveryPlannerImpl::streamDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    CompactCommandList& commands,
+    const LegReadyCallback& legReady,
+    double& totalDistanceTravelled,
+    int routeThreads) const
+{
+    STATS_TIMER(planMs);
+    totalDistanceTravelled = 0;
+    if (deliveries.empty())
+        return DELIVERY_SUCCESS;
+    DeliveryResult reachable = checkReachable(depot, deliveries);
+    if (reachable != DELIVERY_SUCCESS)
+        return reachable;
+    double oldCrowDistance, newCrowDistance;
+    DeliveryOptimizer optimizer(m_streetMap);
+    vector<DeliveryRequest> copyDeliveries = deliveries;
+    optimizer.optimizeDeliveryOrder(depot, copyDeliveries, oldCrowDistance, newCrowDistance);
+
+    struct RoutedLeg
     {
-        if (segmentIt == route.end())
+        list<StreetSegment> route;
+        double distance = 0;
+        DeliveryResult result = DELIVERY_SUCCESS;
+        bool ready = false;
+    };
+    int numLegs = static_cast<int>(copyDeliveries.size()) + 1;
+    vector<RoutedLeg> legs(numLegs);
+    mutex legsMutex;
+    condition_variable legRouted;
+    atomic<int> nextLeg(0);
+    atomic<bool> stop(false);
+    auto routeLegsInOrder = [&]()
+    {
+        QueryRecording insidePlan;                                          // the legs are part of this plan, not queries of their own
+        for (int leg = nextLeg++; leg < numLegs && !stop; leg = nextLeg++)
         {
-            if (deliveryNum == copyDeliveries.size()-1)
+            const GeoCoord& from = leg == 0 ? depot : copyDeliveries[leg - 1].location;
+            const GeoCoord& to = leg < numLegs - 1 ? copyDeliveries[leg].location : depot;
+            list<StreetSegment> route;
+            double distance;
+            DeliveryResult result = m_generateRoute.generatePointToPointRoute(from, to, route, distance);
             {
-                tempCommand.initAsDeliverCommand(tempItem);
-                testPossible = m_generateRoute.generatePointToPointRoute(copyDeliveries[copyDeliveries.size()-1].location, depot, route, requestDistance);  // add a new route to depot after delivered an item to location
-                if (testPossible == NO_ROUTE)
-                {
-                    return NO_ROUTE;
-                }
-                else if (testPossible == BAD_COORD)
-                {
-                    return BAD_COORD;
-                }
-                totalDistanceTravelled += requestDistance;
+                lock_guard<mutex> lock(legsMutex);
+                legs[leg].route.swap(route);
+                legs[leg].distance = distance;
+                legs[leg].result = result;
+                legs[leg].ready = true;
             }
-            else if (deliveryNum == copyDeliveries.size())
+            legRouted.notify_all();
+        }
+    };
+    vector<thread> routers;
+    for (int t = 0; t < max(1, routeThreads); t++)
+        routers.push_back(thread(routeLegsInOrder));
+    auto joinRouters = [&]()
+    {
+        stop = true;
+        for (size_t t = 0; t < routers.size(); t++)
+            routers[t].join();
+    };
+
+    DeliveryResult result = DELIVERY_SUCCESS;
+    try
+    {
+        for (int leg = 0; leg < numLegs; leg++)
+        {
+            list<StreetSegment> route;
             {
-                return DELIVERY_SUCCESS;
+                unique_lock<mutex> lock(legsMutex);
+                legRouted.wait(lock, [&legs, leg] { return legs[leg].ready; });
+                route.swap(legs[leg].route);
             }
-            else
+            if (legs[leg].result != DELIVERY_SUCCESS)
             {
-                tempCommand.initAsDeliverCommand(tempItem);
-                testPossible = m_generateRoute.generatePointToPointRoute(copyDeliveries[deliveryNum].location, copyDeliveries[deliveryNum+1].location, route, requestDistance); // add a new route after delivered an item to location
-                if (testPossible == NO_ROUTE)
-                {
-                    return NO_ROUTE;
-                }
-                else if (testPossible == BAD_COORD)
-                {
-                    return BAD_COORD;
-                }
-                tempItem = copyDeliveries[deliveryNum+1].item;
-                totalDistanceTravelled += requestDistance;
+                result = legs[leg].result;
+                break;
             }
-            deliveryNum++;
-            commands.push_back(tempCommand);
-            it = route.begin();
-            segmentIt = route.begin()++;
+            int firstCommand = commands.size();
+            addRouteCommands(route, commands);
+            if (leg < numLegs - 1)
+                commands.addDeliver(copyDeliveries[leg].item);
+            totalDistanceTravelled += legs[leg].distance;
+            legReady(leg, legs[leg].distance, firstCommand, commands.size());
         }
-        if (segmentIt != route.end())
+    }
+    catch (...)
+    {
+        joinRouters();
+        throw;
+    }
+    joinRouters();
+    return result;
+}
+
+  // Cheapest insertion by crow distance, then a local repair that lets the new
+  // stop trade places with the stop before or after it if that is shorter.
+DeliveryResult DeliveryPlannerImpl::addDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery) const
+{
+    DeliveryResult reachable = checkReachable(plan.depot, vector<DeliveryRequest>(1, delivery));
+    if (reachable != DELIVERY_SUCCESS)
+        return reachable;
+    int n = static_cast<int>(plan.deliveries.size());
+    int pos = 0;
+    double bestCost = 0;
+    for (int i = 0; i <= n; i++)                                                // between waypoints i and i+1
+    {
+        const GeoCoord& prev = waypoint(plan, i);
+        const GeoCoord& next = waypoint(plan, i + 1);
+        double cost = distanceEarthMiles(prev, delivery.location) + distanceEarthMiles(delivery.location, next) - distanceEarthMiles(prev, next);
+        if (i == 0 || cost < bestCost)
         {
-            segmentDistance = distanceEarthMiles(it->start, it->end);
-            lineAngle = angleOfLine(*it);
-            while (segmentIt->name == it->name && segmentIt != route.end())                         // add up all segments that are in a straight line
-            {
-                segmentDistance += distanceEarthMiles(segmentIt->start, segmentIt->end);
-                segmentIt++;
-            }
-            tempCommand.initAsProceedCommand(getDirection(lineAngle), it->name, segmentDistance);   // proceed forwards
-            commands.push_back(tempCommand);
+            pos = i;
+            bestCost = cost;
         }
-        
-        if (segmentIt != route.end() && it != route.end())                                          // turn 
+    }
+    plan.deliveries.insert(plan.deliveries.begin() + pos, delivery);
+    
+    int first = pos;                                                            // deliveries first..last are in new places
+    int last = pos;
+    double bestTour = crowCost(plan, pos - 1, pos + 3);
+    if (pos > 0)
+    {
+        swap(plan.deliveries[pos - 1], plan.deliveries[pos]);
+        double tour = crowCost(plan, pos - 1, pos + 3);
+        if (tour < bestTour)
         {
-            tempCommand.initAsTurnCommand(getTurnDirection(angleBetween2Lines(*it, *segmentIt)), segmentIt->name);
-            commands.push_back(tempCommand);
-            segmentDistance = 0;
+            bestTour = tour;
+            first = pos - 1;
         }
-        if (segmentIt != route.end())
+        swap(plan.deliveries[pos - 1], plan.deliveries[pos]);
+    }
+    if (pos + 1 < n + 1)
+    {
+        swap(plan.deliveries[pos], plan.deliveries[pos + 1]);
+        double tour = crowCost(plan, pos - 1, pos + 3);
+        if (tour < bestTour)
         {
-            it = segmentIt;
-            segmentIt++;
+            bestTour = tour;
+            first = pos;
+            last = pos + 1;
         }
+        swap(plan.deliveries[pos], plan.deliveries[pos + 1]);
+    }
+    if (first < pos)
+        swap(plan.deliveries[pos - 1], plan.deliveries[pos]);
+    else if (last > pos)
+        swap(plan.deliveries[pos], plan.deliveries[pos + 1]);
+    
+    vector<DeliveryLeg> legs;
+    DeliveryResult result = routeLegs(plan, first, last - first + 2, legs);
+    if (result != DELIVERY_SUCCESS)
+    {
+        int added = (first < pos) ? pos - 1 : (last > pos ? pos + 1 : pos);
+        plan.deliveries.erase(plan.deliveries.begin() + added);                 // the others are back in their old order
+        return result;
+    }
+    spliceLegs(plan, first, last - first + 1, legs);
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlannerImpl::removeDelivery(DeliveryPlan& plan, int deliveryIndex) const
+{
+    if (deliveryIndex < 0 || deliveryIndex >= static_cast<int>(plan.deliveries.size()))
+        return BAD_COORD;
+    DeliveryRequest removed = plan.deliveries[deliveryIndex];
+    plan.deliveries.erase(plan.deliveries.begin() + deliveryIndex);
+    vector<DeliveryLeg> legs;
+    DeliveryResult result = routeLegs(plan, deliveryIndex, 1, legs);           // straight from the stop before to the stop after
+    if (result != DELIVERY_SUCCESS)
+    {
+        plan.deliveries.insert(plan.deliveries.begin() + deliveryIndex, removed);
+        return result;
+    }
+    spliceLegs(plan, deliveryIndex, 2, legs);
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult DeliveryPlannerImpl::moveStart(DeliveryPlan& plan, const GeoCoord& position) const
+{
+    GeoCoord oldStart = plan.start;
+    plan.start = position;
+    vector<DeliveryLeg> legs;
+    DeliveryResult result = routeLegs(plan, 0, 1, legs);
+    if (result != DELIVERY_SUCCESS)
+    {
+        plan.start = oldStart;
+        return result;
+    }
+    spliceLegs(plan, 0, 1, legs);
+    return DELIVERY_SUCCESS;
+}
+
+  // Every stop must be on the map and in the depot's connected component.
+DeliveryResult DeliveryPlannerImpl::checkReachable(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries) const
+{
+    int depotComponent = m_streetMap->componentOf(depot);
+    if (depotComponent < 0)
+        return BAD_COORD;
+    DeliveryResult result = DELIVERY_SUCCESS;
+    for (size_t i = 0; i < deliveries.size(); i++)
+    {
+        int component = m_streetMap->componentOf(deliveries[i].location);
+        if (component < 0)
+            return BAD_COORD;
+        if (component != depotComponent)
+            result = NO_ROUTE;
+    }
+    return result;
+}
+
+  // waypoint 0 is the start, waypoints 1..n the deliveries, and n+1 the depot
+const GeoCoord& DeliveryPlannerImpl::waypoint(const DeliveryPlan& plan, int i) const
+{
+    if (i == 0)
+        return plan.start;
+    if (i <= static_cast<int>(plan.deliveries.size()))
+        return plan.deliveries[i - 1].location;
+    return plan.depot;
+}
+
+  // crow distance from waypoint first to waypoint last, clamped to the tour
+double DeliveryPlannerImpl::crowCost(const DeliveryPlan& plan, int first, int last) const
+{
+    int lastWaypoint = static_cast<int>(plan.deliveries.size()) + 1;
+    if (first < 0)
+        first = 0;
+    if (last > lastWaypoint)
+        last = lastWaypoint;
+    double cost = 0;
+    for (int i = first; i < last; i++)
+        cost += distanceEarthMiles(waypoint(plan, i), waypoint(plan, i + 1));
+    return cost;
+}
+
+DeliveryResult DeliveryPlannerImpl::routeLegs(const DeliveryPlan& plan, int firstLeg, int numLegs, vector<DeliveryLeg>& legs) const
+{
+    ArenaScope scratch(threadArena());
+    legs.resize(numLegs);
+    for (int i = 0; i < numLegs; i++)
+    {
+        int leg = firstLeg + i;
+        DeliveryLeg& out = legs[i];
+        DeliveryResult result = m_generateRoute.generatePointToPointRoute(waypoint(plan, leg), waypoint(plan, leg + 1), out.route, out.distance);
+        if (result != DELIVERY_SUCCESS)
+            return result;
+        CompactCommandList commands(&scratch.arena());
+        addRouteCommands(out.route, commands);
+        if (leg < static_cast<int>(plan.deliveries.size()))
+            commands.addDeliver(plan.deliveries[leg].item);
+        out.commands.clear();
+        out.commands.reserve(commands.size());
+        for (int c = 0; c < commands.size(); c++)
+            out.commands.push_back(commands.toDeliveryCommand(c));
     }
     return DELIVERY_SUCCESS;
 }
 
-string DeliveryPlannerImpl::getDirection(double angle) const
+  // replace oldLegs legs starting at firstLeg with newLegs
+void DeliveryPlannerImpl::spliceLegs(DeliveryPlan& plan, int firstLeg, int oldLegs, vector<DeliveryLeg>& newLegs) const
+{
+    for (int i = firstLeg; i < firstLeg + oldLegs; i++)
+        plan.totalDistanceTravelled -= plan.legs[i].distance;
+    for (size_t i = 0; i < newLegs.size(); i++)
+        plan.totalDistanceTravelled += newLegs[i].distance;
+    int common = min(oldLegs, static_cast<int>(newLegs.size()));
+    for (int i = 0; i < common; i++)
+        swap(plan.legs[firstLeg + i], newLegs[i]);
+    if (oldLegs > common)
+        plan.legs.erase(plan.legs.begin() + firstLeg + common, plan.legs.begin() + firstLeg + oldLegs);
+    else
+        plan.legs.insert(plan.legs.begin() + firstLeg + common, make_move_iterator(newLegs.begin() + common), make_move_iterator(newLegs.end()));
+}
+
+  // by the map's name ids, when both segments came from the map
+static bool sameStreet(const StreetSegment& s1, const StreetSegment& s2)
+{
+    if (s1.nameId >= 0 && s2.nameId >= 0)
+        return s1.nameId == s2.nameId;
+    return s1.name == s2.name;
+}
+
+void DeliveryPlannerImpl::addRouteCommands(const list<StreetSegment>& route, CompactCommandList& commands) const
+{
+    STATS_TIMER(commandsMs);
+    if (route.empty())
+        return;
+    list<StreetSegment>::const_iterator it = route.begin();
+    list<StreetSegment>::const_iterator segmentIt = route.begin();
+    for (;;)
+    {
+        double segmentDistance = distanceEarthMiles(it->start, it->end);
+        double lineAngle = angleOfLine(*it);
+        while (segmentIt != route.end() && sameStreet(*segmentIt, *it))                            // add up all segments that are in a straight line
+        {
+            segmentDistance += distanceEarthMiles(segmentIt->start, segmentIt->end);
+            segmentIt++;
+        }
+        commands.addProceed(getDirection(lineAngle), *it, segmentDistance);                         // proceed forwards
+        if (segmentIt == route.end())
+            return;
+        commands.addTurn(getTurnDirection(angleBetween2Lines(*it, *segmentIt)), *segmentIt);        // turn
+        it = segmentIt;
+        segmentIt++;
+        if (segmentIt == route.end())
+            return;
+    }
+}
+
+CompactCommand::Direction DeliveryPlannerImpl::getDirection(double angle) const
 {
     if (angle >= 0 && angle < 22.5)
-        return "east";
+        return CompactCommand::EAST;
     else if (angle >= 22.5 && angle < 67.5)
-        return "northeast";
+        return CompactCommand::NORTHEAST;
     else if (angle >= 67.5 && angle < 112.5)
-        return "north";
+        return CompactCommand::NORTH;
     else if (angle >= 112.5 && angle < 157.5)
-        return "northwest";
+        return CompactCommand::NORTHWEST;
     else if (angle >= 157.5 && angle < 202.5)
-        return "west";
+        return CompactCommand::WEST;
     else if (angle >= 202.5 && angle < 247.5)
-        return "southwest";
+        return CompactCommand::SOUTHWEST;
     else if (angle >= 247.5 && angle < 292.5)
-        return "south";
+        return CompactCommand::SOUTH;
     else if (angle >= 292.5 && angle < 337.5)
-        return "southeast";
+        return CompactCommand::SOUTHEAST;
     else
-        return "east";
+        return CompactCommand::EAST;
 }
 
-string DeliveryPlannerImpl::getTurnDirection(double angle) const
+CompactCommand::Direction DeliveryPlannerImpl::getTurnDirection(double angle) const
 {
     if (angle < 1 || angle > 359)
-        return "proceed";
+        return CompactCommand::STRAIGHT;
     else if (angle >= 1 && angle < 180)
-        return "left";
+        return CompactCommand::LEFT;
     else
-        return "right";
+        return CompactCommand::RIGHT;
 }
 
 //******************** DeliveryPlanner functions ******************************
 
-// These functions simply delegate to DeliveryPlannerImpl's functions.
-// You probably don't want to change any of this code.
+// These functions simply delegate to DeliveryPlannerImpl's functions, recording
+// each plan request when a query log is installed.
+
+static void recordPlan(QueryRecording& recording, const char* options,
+    const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+    DeliveryResult result, double distance, unsigned long commandCount)
+{
+    if (!recording.active())
+        return;
+    QueryRecord record;
+    record.kind = QueryRecord::PLAN;
+    record.options = options;
+    record.start = depot;
+    record.deliveries = deliveries;
+    record.result = result;
+    record.distance = distance;
+    record.outputSize = commandCount;
+    recording.finish(record);
+}
 
 DeliveryPlanner::DeliveryPlanner(const StreetMap* sm)
 {
@@ -185,5 +511,80 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
     vector<DeliveryCommand>& commands,
     double& totalDistanceTravelled) const
 {
-    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
+    QueryRecording recording;
+    CompactCommandList compact;
+    DeliveryResult result = m_impl->generateDeliveryPlan(depot, deliveries, compact, totalDistanceTravelled);
+    commands.reserve(commands.size() + compact.size());
+    for (int i = 0; i < compact.size(); i++)
+        commands.push_back(compact.toDeliveryCommand(i));
+    recordPlan(recording, "plan commands", depot, deliveries, result, totalDistanceTravelled, compact.size());
+    return result;
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    CompactCommandList& commands,
+    double& totalDistanceTravelled) const
+{
+    QueryRecording recording;
+    int before = commands.size();
+    DeliveryResult result = m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
+    recordPlan(recording, "plan compact", depot, deliveries, result, totalDistanceTravelled, commands.size() - before);
+    return result;
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryPlan& plan) const
+{
+    QueryRecording recording;
+    DeliveryResult result = m_impl->generateDeliveryPlan(depot, deliveries, plan);
+    if (recording.active())
+    {
+        unsigned long commandCount = 0;
+        for (size_t i = 0; i < plan.legs.size(); i++)
+            commandCount += plan.legs[i].commands.size();
+        recordPlan(recording, "plan legs", depot, deliveries, result, plan.totalDistanceTravelled, commandCount);
+    }
+    return result;
+}
+
+DeliveryResult DeliveryPlanner::streamDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    CompactCommandList& commands,
+    const LegReadyCallback& legReady,
+    double& totalDistanceTravelled,
+    int routeThreads) const
+{
+    QueryRecording recording;
+    int before = commands.size();
+    DeliveryResult result = m_impl->streamDeliveryPlan(depot, deliveries, commands, legReady, totalDistanceTravelled, routeThreads);
+    recordPlan(recording, "plan stream", depot, deliveries, result, totalDistanceTravelled, commands.size() - before);
+    return result;
+}
+
+DeliveryResult DeliveryPlanner::addDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery) const
+{
+    return m_impl->addDelivery(plan, delivery);
+}
+
+DeliveryResult DeliveryPlanner::removeDelivery(DeliveryPlan& plan, int deliveryIndex) const
+{
+    return m_impl->removeDelivery(plan, deliveryIndex);
+}
+
+DeliveryResult DeliveryPlanner::moveStart(DeliveryPlan& plan, const GeoCoord& position) const
+{
+    return m_impl->moveStart(plan, position);
+}
+
+//******************** DeliveryPlan functions *********************************
+
+void DeliveryPlan::allCommands(vector<DeliveryCommand>& commands) const
+{
+    for (size_t i = 0; i < legs.size(); i++)
+        commands.insert(commands.end(), legs[i].commands.begin(), legs[i].commands.end());
 }
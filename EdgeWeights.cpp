@@ -0,0 +1,172 @@
+#include "EdgeWeights.h"
+#include "CompactGraph.h"
+#include "ExpandableHashMap.h"
+#include "StreetGraph.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+EdgeWeights::EdgeWeights()
+ : m_nextComponent(0), m_numChanged(0), m_version(0)
+{
+}
+
+bool EdgeWeights::build(const StreetMap& map, const EdgeWeights* base, const vector<EdgeUpdate>& updates)
+{
+    if (map.tiles() != nullptr)
+        return false;
+    if (map.compactGraph() != nullptr)
+    {
+        CompactGraph::Cursor cursor(*map.compactGraph());
+        m_factor.assign(map.compactGraph()->numEdges(), 1);
+        return apply(cursor, base, updates);
+    }
+    m_factor.assign(map.graph().numEdges(), 1);
+    return apply(map.graph(), base, updates);
+}
+
+template<typename Network>
+bool EdgeWeights::apply(const Network& network, const EdgeWeights* base, const vector<EdgeUpdate>& updates)
+{
+    if (base != nullptr)
+    {
+        m_factor = base->m_factor;
+        m_component = base->m_component;
+        m_nextComponent = base->m_nextComponent;
+        m_numChanged = base->m_numChanged;
+        m_version = base->m_version + 1;
+    }
+    else
+    {
+        m_component.resize(network.numNodes());
+        m_nextComponent = 0;
+        for (int node = 0; node < network.numNodes(); node++)
+        {
+            m_component[node] = network.component(node);
+            m_nextComponent = max(m_nextComponent, m_component[node] + 1);
+        }
+        m_numChanged = 0;
+        m_version = 1;
+    }
+    for (size_t i = 0; i < updates.size(); i++)
+    {
+        const EdgeUpdate& update = updates[i];
+        int a = network.nodeAt(update.from);
+        int b = network.nodeAt(update.to);
+        if (a == -1 || b == -1 || (!update.closed && !(update.factor > 0 && isfinite(update.factor))))
+            return false;
+        float factor = update.closed ? CLOSED : static_cast<float>(update.factor);
+        bool wasLinked = linked(network, a, b);
+        bool found = false;
+        for (int pass = 0; pass < (update.bothWays ? 2 : 1); pass++)
+        {
+            int from = pass == 0 ? a : b;
+            int to = pass == 0 ? b : a;
+            for (int e = network.firstEdge(from); e < network.endEdge(from); e++)
+            {
+                if (network.target(e) != to)
+                    continue;
+                m_numChanged += (factor != 1) - (m_factor[e] != 1);
+                m_factor[e] = factor;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+        bool nowLinked = linked(network, a, b);
+        if (wasLinked && !nowLinked)
+            splitIfCut(network, a, b);
+        else if (!wasLinked && nowLinked && m_component[a] != m_component[b])
+            join(network, a, b);
+    }
+    return true;
+}
+
+  // whether some edge between a and b is open, in either direction
+template<typename Network>
+bool EdgeWeights::linked(const Network& network, int a, int b) const
+{
+    for (int e = network.firstEdge(a); e < network.endEdge(a); e++)
+        if (network.target(e) == b && open(e))
+            return true;
+    for (int e = network.firstEdge(b); e < network.endEdge(b); e++)
+        if (network.target(e) == a && open(e))
+            return true;
+    return false;
+}
+
+  // After the last link between a and b closed: searches from a and from b
+  // take turns settling a node; if they meet, a and b are still connected,
+  // and if one runs out first, what it reached is cut off.
+template<typename Network>
+void EdgeWeights::splitIfCut(const Network& network, int a, int b)
+{
+    ExpandableHashMap<int, int> sideOf;
+    vector<int> reached[2] = { vector<int>(1, a), vector<int>(1, b) };
+    size_t settled[2] = { 0, 0 };
+    sideOf.associate(a, 0);
+    sideOf.associate(b, 1);
+    for (int side = 0; ; side ^= 1)
+    {
+        if (settled[side] == reached[side].size())
+        {
+            for (size_t i = 0; i < reached[side].size(); i++)
+                m_component[reached[side][i]] = m_nextComponent;
+            m_nextComponent++;
+            return;
+        }
+        int node = reached[side][settled[side]++];
+        for (int e = network.firstEdge(node); e < network.endEdge(node); e++)
+        {
+            int next = network.target(e);
+            if (!open(e) && !linked(network, node, next))
+                continue;
+            const int* nextSide = sideOf.find(next);
+            if (nextSide == nullptr)
+            {
+                sideOf.associate(next, side);
+                reached[side].push_back(next);
+            }
+            else if (*nextSide != side)
+                return;
+        }
+    }
+}
+
+  // After a link between two components opened: each is searched within its
+  // own label, in turns, and the one that runs out first takes the other's.
+template<typename Network>
+void EdgeWeights::join(const Network& network, int a, int b)
+{
+    ExpandableHashMap<int, int> seen;
+    int label[2] = { m_component[a], m_component[b] };
+    vector<int> reached[2] = { vector<int>(1, a), vector<int>(1, b) };
+    size_t settled[2] = { 0, 0 };
+    seen.associate(a, 0);
+    seen.associate(b, 1);
+    for (int side = 0; ; side ^= 1)
+    {
+        if (settled[side] == reached[side].size())
+        {
+            for (size_t i = 0; i < reached[side].size(); i++)
+                m_component[reached[side][i]] = label[side ^ 1];
+            return;
+        }
+        int node = reached[side][settled[side]++];
+        for (int e = network.firstEdge(node); e < network.endEdge(node); e++)
+        {
+            int next = network.target(e);
+            if (m_component[next] != label[side] || seen.find(next) != nullptr)
+                continue;
+            if (!open(e) && !linked(network, node, next))
+                continue;
+            seen.associate(next, side);
+            reached[side].push_back(next);
+        }
+    }
+}
+
+long EdgeWeights::memoryUsage() const
+{
+    return static_cast<long>(m_factor.capacity() * sizeof(float) + m_component.capacity() * sizeof(int));
+}
@@ -0,0 +1,126 @@
+// EdgeWeights.h
+
+// Live changes to what streets cost the router, for closures and traffic,
+// layered over a loaded map without rebuilding it.
+//
+// An EdgeWeights is one immutable version of the changes: a length factor
+// per edge (by the StreetGraph's edge ids, which the compact form keeps),
+// with closed edges marked, and the connected components of the streets
+// still open.  Applying a batch of EdgeUpdates copies the previous version
+// and changes only what the batch names, so a map in service moves to the
+// next version in one pointer swap (StreetMapVersions.h) while queries
+// pinned to the last one finish undisturbed.
+//
+// Components are kept up to date incrementally.  Closing a street searches
+// outward from both of its ends, one node at a time from each, until the
+// searches meet (still connected) or one side runs out, which is then
+// relabeled as a component of its own; reopening one between two components
+// relabels the one that runs out first as the other.  Either way the work is
+// bounded by the smaller side, so closing a street within a block costs a
+// walk around the block, not a pass over the map.  A street counts as a link
+// while either direction of it is open, which keeps components a sound test
+// for "no route" even when only one direction is closed.
+//
+// The other accelerations are not reweighted: hub labels hold distances for
+// the loaded lengths, so StreetMap stops offering them while any change is in
+// effect, and offers them again once every change has been undone.  Turn
+// data and tiles describe geometry only and are unaffected.  Tiled maps take
+// no updates.
+//
+// WeightedNetwork presents a network with the changes applied, for the
+// searches; roadsOf() gets the plain network back, for reporting routes in
+// road miles.
+
+#ifndef EDGEWEIGHTS_INCLUDED
+#define EDGEWEIGHTS_INCLUDED
+
+#include "provided.h"
+#include "FlatEarth.h"
+#include <vector>
+
+class EdgeWeights
+{
+public:
+    EdgeWeights();
+      // base's changes (none if base is null) and then updates', over map;
+      // false if an update names two intersections no street joins, has a
+      // factor that is not positive, or the map is tiled
+    bool build(const StreetMap& map, const EdgeWeights* base, const std::vector<EdgeUpdate>& updates);
+
+    bool open(int edge) const { return m_factor[edge] >= 0; }
+      // an open edge's cost, given its length on the map
+    double length(int edge, double miles) const { return miles * m_factor[edge]; }
+    int component(int node) const { return m_component[node]; }
+      // edges whose cost differs from the map's
+    int numChanged() const { return m_numChanged; }
+      // batches applied since the map was loaded
+    unsigned long version() const { return m_version; }
+    long memoryUsage() const;
+
+    EdgeWeights(const EdgeWeights&) = delete;
+    EdgeWeights& operator=(const EdgeWeights&) = delete;
+private:
+    static constexpr float CLOSED = -1;
+
+    std::vector<float> m_factor;                // length multiplier per edge, or CLOSED
+    std::vector<int> m_component;               // component of each node over open streets
+    int m_nextComponent;                        // an id no node has yet
+    int m_numChanged;
+    unsigned long m_version;
+
+    template<typename Network>
+    bool apply(const Network& network, const EdgeWeights* base, const std::vector<EdgeUpdate>& updates);
+    template<typename Network>
+    bool linked(const Network& network, int a, int b) const;
+    template<typename Network>
+    void splitIfCut(const Network& network, int a, int b);
+    template<typename Network>
+    void join(const Network& network, int a, int b);
+};
+
+  // A network with an EdgeWeights version applied: closed edges are not
+  // open(), lengths are costs, and components are over the open streets.
+template<typename Network>
+class WeightedNetwork
+{
+public:
+    WeightedNetwork(const Network& network, const EdgeWeights& weights)
+     : m_network(network), m_weights(weights)
+    {}
+    const Network& roads() const { return m_network; }
+
+    int numNodes() const { return m_network.numNodes(); }
+    int nodeAt(const GeoCoord& gc) const { return m_network.nodeAt(gc); }
+    decltype(auto) coord(int node) const { return m_network.coord(node); }
+    GeoPoint point(int node) const { return m_network.point(node); }
+    double milesTo(int node, const GeoCoord& gc) const { return m_network.milesTo(node, gc); }
+    double milesTo(int node, const GeoCoord& gc, const FlatEarth& flat) const { return m_network.milesTo(node, gc, flat); }
+    int component(int node) const { return m_weights.component(node); }
+
+    int firstEdge(int node) const { return m_network.firstEdge(node); }
+    int endEdge(int node) const { return m_network.endEdge(node); }
+    int target(int edge) const { return m_network.target(edge); }
+    bool open(int edge) const { return m_weights.open(edge); }
+    double length(int edge) const { return m_weights.length(edge, m_network.length(edge)); }
+    decltype(auto) name(int edge) const { return m_network.name(edge); }
+    int nameId(int edge) const { return m_network.nameId(edge); }
+    StreetSegment segment(int node, int edge) const { return m_network.segment(node, edge); }
+private:
+    const Network& m_network;
+    const EdgeWeights& m_weights;
+};
+
+  // the network as loaded, whether or not it has weights applied
+template<typename Network>
+const Network& roadsOf(const Network& network)
+{
+    return network;
+}
+
+template<typename Network>
+const Network& roadsOf(const WeightedNetwork<Network>& network)
+{
+    return network.roads();
+}
+
+#endif // EDGEWEIGHTS_INCLUDED
@@ -8,17 +8,22 @@
 #ifndef expandableHashMap_h
 #define expandableHashMap_h
 
+#include "Arena.h"
+#include "Stats.h"
+#include <new>
 #include <iostream>
 #include <vector>
 
 unsigned int hasher(const GeoCoord& g);
+unsigned int hasher(int i);
 unsigned int hasher(const std::string &testString);
 
 template<typename KeyType, typename ValueType>
 class ExpandableHashMap
 {
 public:
-    ExpandableHashMap(double maximumLoadFactor = 0.5);
+    // with an arena, buckets and chained nodes are carved from it instead of the heap
+    ExpandableHashMap(double maximumLoadFactor = 0.5, Arena* arena = nullptr);
     ~ExpandableHashMap();
     void reset();
     int size() const;
@@ -33,6 +38,13 @@ public:
         return const_cast<ValueType*>(const_cast<const ExpandableHashMap*>(this)->find(key));
     }
     
+    // calls f(key, value) for every association; f may change the value
+    template<typename F>
+    void forEach(F f);
+    
+    // bytes held by the table itself (buckets and chained nodes, not what values point to)
+    long memoryUsage() const;
+    
     // C++11 syntax for preventing copying and assignment
     ExpandableHashMap(const ExpandableHashMap&) = delete;
     ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
@@ -49,7 +61,12 @@ private:
     int m_size;
     int m_numBuckets;
     double m_maxLoadFactor;
+    Arena* m_arena;
     
+    Node* newNode();
+    void deleteNode(Node* node);
+    Node* newBuckets(int numBuckets);
+    void deleteBuckets(Node* buckets, int numBuckets);
     void resize();
     double getCurrLoadFactor();
     unsigned int getBucketNumber(const KeyType& key, int numBuckets) const;
@@ -60,9 +77,10 @@ private:
 };
 
 template<typename KeyType, typename ValueType>
-ExpandableHashMap<KeyType, ValueType>::ExpandableHashMap(double maximumLoadFactor)
+ExpandableHashMap<KeyType, ValueType>::ExpandableHashMap(double maximumLoadFactor, Arena* arena)
 {
-    m_map = new Node[8];
+    m_arena = arena;
+    m_map = newBuckets(8);
     m_size = 0;
     m_numBuckets = 8;
     m_maxLoadFactor = maximumLoadFactor;
@@ -88,7 +106,7 @@ ExpandableHashMap<KeyType, ValueType>::~ExpandableHashMap()
             }
             while (track != nullptr)
             {
-                delete track;
+                deleteNode(track);
                 track = trackNext;
                 if (trackNext != nullptr)
                     trackNext = trackNext->next;
@@ -96,12 +114,30 @@ ExpandableHashMap<KeyType, ValueType>::~ExpandableHashMap()
         }
         i++;
     }
-    delete [] m_map;
+    deleteBuckets(m_map, m_numBuckets);
 }
 
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::reset()
 {
+    for (int i = 0; i < m_numBuckets; i++)
+    {
+        Node* track = m_map[i].isDummy ? nullptr : m_map[i].next;
+        while (track != nullptr)
+        {
+            Node* trackNext = track->next;
+            deleteNode(track);
+            track = trackNext;
+        }
+    }
+    deleteBuckets(m_map, m_numBuckets);
+    m_map = newBuckets(8);
+    m_size = 0;
+    m_numBuckets = 8;
+    for (int i = 0; i < m_numBuckets; i++)
+    {
+        insertDummy(i);
+    }
 }
 
 template<typename KeyType, typename ValueType>
@@ -113,6 +149,7 @@ int ExpandableHashMap<KeyType, ValueType>::size() const
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
 {
+    STATS_ADD(hashInserts, 1);
     resize();
     int bucketNum = getBucketNumber(key, m_numBuckets);
     if (m_map[bucketNum].isDummy == true)   // if bucket is empty
@@ -140,7 +177,7 @@ void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, const
             track->m_value = value;     // replace with new value
             return;
         }
-        track->next = new Node;                // no existing association
+        track->next = newNode();                // no existing association
         track = track->next;
         track->m_key = key;
         track->m_value = value;
@@ -151,12 +188,20 @@ void ExpandableHashMap<KeyType, ValueType>::associate(const KeyType& key, const
 template<typename KeyType, typename ValueType>
 const ValueType* ExpandableHashMap<KeyType, ValueType>::find(const KeyType& key) const
 {
+    STATS_ADD(hashFinds, 1);
     int bucketNum = getBucketNumber(key, m_numBuckets);
     Node* track = &m_map[bucketNum];
     if (track->isDummy == true)
         return nullptr;
+#ifdef DELIVERY_STATS
+    long probes = 0;
+#endif
     while (track != nullptr)
     {
+#ifdef DELIVERY_STATS
+        STATS_ADD(hashProbes, 1);
+        STATS_MAX(hashMaxProbe, ++probes);
+#endif
         if (track->m_key == key)
         {
             return &track->m_value;
@@ -166,14 +211,42 @@ const ValueType* ExpandableHashMap<KeyType, ValueType>::find(const KeyType& key)
     return nullptr;
 }
 
+template<typename KeyType, typename ValueType>
+template<typename F>
+void ExpandableHashMap<KeyType, ValueType>::forEach(F f)
+{
+    for (int i = 0; i < m_numBuckets; i++)
+    {
+        if (m_map[i].isDummy)
+            continue;
+        for (Node* track = &m_map[i]; track != nullptr; track = track->next)
+            f(static_cast<const KeyType&>(track->m_key), track->m_value);
+    }
+}
+
+template<typename KeyType, typename ValueType>
+long ExpandableHashMap<KeyType, ValueType>::memoryUsage() const
+{
+    long bytes = static_cast<long>(sizeof(Node)) * m_numBuckets;
+    for (int i = 0; i < m_numBuckets; i++)
+    {
+        if (m_map[i].isDummy)
+            continue;
+        for (Node* track = m_map[i].next; track != nullptr; track = track->next)
+            bytes += sizeof(Node);
+    }
+    return bytes;
+}
+
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::resize()
 {
     if (getCurrLoadFactor() >= m_maxLoadFactor)
     {
+        STATS_ADD(hashResizes, 1);
         m_size = 0;
         int numOfBuckets = m_numBuckets * 2;
-        Node* newMap = new Node[m_numBuckets*2];
+        Node* newMap = newBuckets(numOfBuckets);
         for (int n = 0; n < numOfBuckets; n++)
         {
             newMap[n].isDummy = true;
@@ -198,7 +271,7 @@ void ExpandableHashMap<KeyType, ValueType>::resize()
                     {
                         track = track->next;
                     }
-                    track = new Node;
+                    track = newNode();
                     track->m_key = m_map[i].m_key;
                     track->m_value = m_map[i].m_value;
                     track->next = nullptr;
@@ -228,13 +301,13 @@ void ExpandableHashMap<KeyType, ValueType>::resize()
                         {
                             track3 = track3->next;
                         }
-                        track3->next = new Node;
+                        track3->next = newNode();
                         track3 = track3->next;
                         track3->m_key = track2->m_key;
                         track3->m_value = track2->m_value;
                         track3->next = nullptr;
                     }
-                    delete track2;
+                    deleteNode(track2);
                     track2 = trackNext;
                     if (trackNext != nullptr)
                     {
@@ -243,7 +316,7 @@ void ExpandableHashMap<KeyType, ValueType>::resize()
                 }
             }
         }
-        delete [] m_map;
+        deleteBuckets(m_map, m_numBuckets);
         m_map = newMap;
         m_numBuckets = numOfBuckets;
     }
@@ -264,6 +337,46 @@ unsigned int ExpandableHashMap<KeyType, ValueType>::getBucketNumber(const KeyTyp
     return temp % numBuckets;
 }
 
+template<typename KeyType, typename ValueType>
+typename ExpandableHashMap<KeyType, ValueType>::Node* ExpandableHashMap<KeyType, ValueType>::newNode()
+{
+    if (m_arena == nullptr)
+        return new Node;
+    return new (m_arena->allocate(sizeof(Node), alignof(Node))) Node;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::deleteNode(Node* node)
+{
+    if (m_arena == nullptr)
+        delete node;
+    else
+        node->~Node();                          // the memory goes back when the arena is rewound
+}
+
+template<typename KeyType, typename ValueType>
+typename ExpandableHashMap<KeyType, ValueType>::Node* ExpandableHashMap<KeyType, ValueType>::newBuckets(int numBuckets)
+{
+    if (m_arena == nullptr)
+        return new Node[numBuckets];
+    Node* buckets = static_cast<Node*>(m_arena->allocate(sizeof(Node) * numBuckets, alignof(Node)));
+    for (int i = 0; i < numBuckets; i++)
+        new (&buckets[i]) Node;
+    return buckets;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType, ValueType>::deleteBuckets(Node* buckets, int numBuckets)
+{
+    if (m_arena == nullptr)
+    {
+        delete [] buckets;
+        return;
+    }
+    for (int i = 0; i < numBuckets; i++)
+        buckets[i].~Node();
+}
+
 template<typename KeyType, typename ValueType>
 void ExpandableHashMap<KeyType, ValueType>::insertDummy(int bucketNum)
 {
@@ -282,7 +395,7 @@ void ExpandableHashMap<KeyType, ValueType>::removeNode(const KeyType &key)
             m_map[bucketNum].m_key = temp->m_key;
             m_map[bucketNum].m_value = temp->m_value;
             m_map[bucketNum].next = temp->next;
-            delete temp;
+            deleteNode(temp);
         }
         else
             m_map[bucketNum].isDummy = true;
@@ -296,7 +409,7 @@ void ExpandableHashMap<KeyType, ValueType>::removeNode(const KeyType &key)
         {
             Node* temp = track->next;
             track->next = temp->next;
-            delete temp;
+            deleteNode(temp);
         }
         if (track != nullptr)
             track = track->next;
@@ -0,0 +1,16 @@
+#include "FlatEarth.h"
+using namespace std;
+
+//******************** fast distance mode *************************************
+
+static bool s_fastDistance = false;
+
+void setFastDistance(bool fast)
+{
+    s_fastDistance = fast;
+}
+
+bool fastDistance()
+{
+    return s_fastDistance;
+}
@@ -0,0 +1,57 @@
+// FlatEarth.h
+
+// Approximate distances for comparing nearby points, without the sines,
+// cosines and arcsine of distanceEarthMiles.  A FlatEarth treats the map as
+// flat around a reference latitude (an equirectangular projection): a degree
+// of latitude is always MILES_PER_DEGREE, and a degree of longitude is that
+// times the cosine of the two points' mean latitude, taken to first order from
+// the cosine and sine at the reference, which are computed once.
+//
+// Error against distanceEarthMiles, for points up to 20 miles apart that lie
+// within 100 miles (north or south) of the reference latitude, anywhere from
+// the equator to 60 degrees: under 0.05% of the distance, and under 0.005%
+// within 30 miles of the reference.  It grows with the square of the distance
+// from the reference latitude, so one FlatEarth should serve one city or
+// region, not the globe.  Longitudes are assumed not to wrap across the 180th
+// meridian between the two points.
+//
+// Use it to rank candidates; totals that are reported still come from
+// distanceEarthMiles.
+
+#ifndef FLATEARTH_INCLUDED
+#define FLATEARTH_INCLUDED
+
+#include "provided.h"
+#include <cmath>
+
+  // whether the optimizer and the router rank candidates by FlatEarth
+  // distances (off by default)
+void setFastDistance(bool fast);
+bool fastDistance();
+
+class FlatEarth
+{
+public:
+    static constexpr double EARTH_RADIUS_MILES = 6371.0 / 1.609344;      // as distanceEarthMiles
+    static constexpr double MILES_PER_DEGREE = EARTH_RADIUS_MILES * 3.14159265358979323846 / 180;
+
+    explicit FlatEarth(double latitude)
+     : m_latitude(latitude), m_cos(std::cos(deg2rad(latitude))),
+       m_sinPerDegree(std::sin(deg2rad(latitude)) * deg2rad(1))
+    {}
+
+    double squaredMiles(const GeoCoord& a, const GeoCoord& b) const
+    {
+        double dLat = b.latitude - a.latitude;
+        double midOffset = (a.latitude + b.latitude) / 2 - m_latitude;
+        double dLon = (b.longitude - a.longitude) * (m_cos - m_sinPerDegree * midOffset);
+        return MILES_PER_DEGREE * MILES_PER_DEGREE * (dLat * dLat + dLon * dLon);
+    }
+    double miles(const GeoCoord& a, const GeoCoord& b) const { return std::sqrt(squaredMiles(a, b)); }
+private:
+    double m_latitude;                          // degrees
+    double m_cos;                               // of the reference latitude
+    double m_sinPerDegree;                      // change in that cosine per degree north
+};
+
+#endif // FLATEARTH_INCLUDED
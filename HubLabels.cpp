@@ -0,0 +1,203 @@
+#include "HubLabels.h"
+#include "StreetGraph.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+using namespace std;
+
+static const double UNREACHED = numeric_limits<double>::infinity();
+
+  // Nodes by how many shortest paths run through them, estimated from a few
+  // shortest-path trees: a node's score is the size of its subtrees.  Hubs
+  // taken in this order prune the later searches early, which keeps labels
+  // short.  Ties go to the node with more streets.
+template<typename Cost>
+static vector<int> rankByImportance(const StreetGraph& graph, const Cost& cost)
+{
+    const int SAMPLE_TREES = 64;
+    int numNodes = graph.numNodes();
+    vector<double> score(numNodes, 0);
+    vector<double> miles(numNodes);
+    vector<int> parent(numNodes);
+    vector<int> settled;
+    typedef pair<double, int> Entry;
+    for (int t = 0; t < SAMPLE_TREES && numNodes > 0; t++)
+    {
+        int root = static_cast<int>((static_cast<long>(t) * 2654435761u) % numNodes);   // spread over the id range
+        fill(miles.begin(), miles.end(), UNREACHED);
+        settled.clear();
+        priority_queue<Entry, vector<Entry>, greater<Entry> > frontier;
+        miles[root] = 0;
+        parent[root] = -1;
+        frontier.push(Entry(0, root));
+        while (!frontier.empty())
+        {
+            Entry top = frontier.top();
+            frontier.pop();
+            int node = top.second;
+            if (top.first > miles[node])
+                continue;
+            settled.push_back(node);
+            for (int e = graph.firstEdge(node); e < graph.endEdge(node); e++)
+            {
+                int next = graph.target(e);
+                double m = top.first + cost(graph, e);
+                if (m < miles[next])
+                {
+                    miles[next] = m;
+                    parent[next] = node;
+                    frontier.push(Entry(m, next));
+                }
+            }
+        }
+        vector<double> below(numNodes, 0);
+        for (size_t i = settled.size(); i-- > 0; )                         // leaves first
+        {
+            int node = settled[i];
+            below[node] += 1;
+            score[node] += below[node];
+            if (parent[node] >= 0)
+                below[parent[node]] += below[node];
+        }
+    }
+    vector<int> order(numNodes);
+    for (int i = 0; i < numNodes; i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [&graph, &score](int a, int b)
+    {
+        if (score[a] != score[b])
+            return score[a] > score[b];
+        return graph.endEdge(a) - graph.firstEdge(a) > graph.endEdge(b) - graph.firstEdge(b);
+    });
+    return order;
+}
+
+HubLabels::HubLabels()
+ : m_labelBegin(1, 0)
+{
+}
+
+void HubLabels::build(const StreetGraph& graph, RouteCost cost, const uint8_t* roadClasses)
+{
+    if (cost == DISTANCE_COST)
+        buildFor(graph, DistanceCost());
+    else
+        buildFor(graph, RoadClassCost(cost, roadClasses));
+}
+
+template<typename Cost>
+void HubLabels::buildFor(const StreetGraph& graph, const Cost& cost)
+{
+    int numNodes = graph.numNodes();
+    vector<int> order = rankByImportance(graph, cost);
+    vector<vector<pair<uint32_t, double> > > labels(numNodes);
+    vector<double> miles(numNodes, UNREACHED);
+    vector<double> rootMiles(numNodes, UNREACHED);                          // the root's label, by hub rank
+    vector<int> touched;
+    typedef pair<double, int> Entry;
+    priority_queue<Entry, vector<Entry>, greater<Entry> > frontier;
+    for (int rank = 0; rank < numNodes; rank++)
+    {
+        int root = order[rank];
+        for (size_t i = 0; i < labels[root].size(); i++)
+            rootMiles[labels[root][i].first] = labels[root][i].second;
+        miles[root] = 0;
+        touched.push_back(root);
+        frontier.push(Entry(0, root));
+        while (!frontier.empty())
+        {
+            Entry top = frontier.top();
+            frontier.pop();
+            int node = top.second;
+            if (top.first > miles[node])                                    // a stale entry
+                continue;
+            double known = UNREACHED;                                       // what higher-ranked hubs already give
+            const vector<pair<uint32_t, double> >& label = labels[node];
+            for (size_t i = 0; i < label.size(); i++)
+                known = min(known, label[i].second + rootMiles[label[i].first]);
+            if (known <= top.first)                                         // pruned: nothing new below here
+                continue;
+            labels[node].push_back(make_pair(static_cast<uint32_t>(rank), top.first));
+            for (int e = graph.firstEdge(node); e < graph.endEdge(node); e++)
+            {
+                int next = graph.target(e);
+                double m = top.first + cost(graph, e);
+                if (m < miles[next])
+                {
+                    if (miles[next] == UNREACHED)
+                        touched.push_back(next);
+                    miles[next] = m;
+                    frontier.push(Entry(m, next));
+                }
+            }
+        }
+        for (size_t i = 0; i < touched.size(); i++)
+            miles[touched[i]] = UNREACHED;
+        touched.clear();
+        for (size_t i = 0; i < labels[root].size(); i++)
+            rootMiles[labels[root][i].first] = UNREACHED;
+    }
+
+    m_labelBegin.assign(1, 0);
+    m_hub.clear();
+    m_miles.clear();
+    for (int n = 0; n < numNodes; n++)                                      // ranks were appended in order, so each label is sorted
+    {
+        for (size_t i = 0; i < labels[n].size(); i++)
+        {
+            m_hub.push_back(labels[n][i].first);
+            m_miles.push_back(labels[n][i].second);
+        }
+        vector<pair<uint32_t, double> >().swap(labels[n]);
+        m_labelBegin.push_back(static_cast<uint32_t>(m_hub.size()));
+    }
+    m_hub.shrink_to_fit();
+    m_miles.shrink_to_fit();
+}
+
+double HubLabels::distance(int from, int to) const
+{
+    uint32_t i = m_labelBegin[from], iEnd = m_labelBegin[from + 1];
+    uint32_t j = m_labelBegin[to], jEnd = m_labelBegin[to + 1];
+    double best = UNREACHED;
+    while (i < iEnd && j < jEnd)                                            // merge on hub rank
+    {
+        if (m_hub[i] < m_hub[j])
+            i++;
+        else if (m_hub[j] < m_hub[i])
+            j++;
+        else
+        {
+            best = min(best, m_miles[i] + m_miles[j]);
+            i++;
+            j++;
+        }
+    }
+    return best == UNREACHED ? -1 : best;
+}
+
+double HubLabels::averageLabelSize() const
+{
+    return numNodes() > 0 ? static_cast<double>(m_hub.size()) / numNodes() : 0;
+}
+
+long HubLabels::memoryUsage() const
+{
+    return m_labelBegin.capacity() * sizeof(uint32_t) + m_hub.capacity() * sizeof(uint32_t) + m_miles.capacity() * sizeof(double);
+}
+
+//******************** build switch *******************************************
+
+static bool s_hubLabelMaps = false;
+
+void setHubLabelMaps(bool build)
+{
+    s_hubLabelMaps = build;
+}
+
+bool hubLabelMaps()
+{
+    return s_hubLabelMaps;
+}
@@ -0,0 +1,64 @@
+// HubLabels.h
+
+// A hub-label distance oracle over a StreetGraph: the shortest road distance
+// between any two intersections in the time of a merge of two short sorted
+// lists, instead of a search.
+//
+// Every node gets a label, a list of (hub, distance) pairs, such that some
+// shortest path between any two nodes of one component passes a hub in both
+// of their labels.  build() computes the labels by pruned Dijkstra searches
+// from every node in order of importance (most connected first); a search
+// stops wherever the labels found so far already give the distance.  Labels
+// are sorted by hub rank and stored back to back.
+//
+// Streets are two-way and the same length both ways, so one label per node
+// serves as both its forward and its backward label.
+//
+// Distances are in the units of the route cost the labels are built for
+// (RouteCosts.h): road miles, or minutes of travel time, or custom weights.
+// The build is compiled for each cost policy.
+//
+// Label sizes grow with the map.  Building is practical for maps of city size:
+// mapdata.txt (18,000 intersections) takes under a second and averages 87
+// hubs per label, but a 110,000-intersection grid takes a minute and half a
+// gigabyte.
+
+#ifndef HUBLABELS_INCLUDED
+#define HUBLABELS_INCLUDED
+
+#include "RouteCosts.h"
+#include <cstdint>
+#include <vector>
+
+class StreetGraph;
+
+  // whether StreetMap::load builds hub labels for its map (off by default)
+void setHubLabelMaps(bool build);
+bool hubLabelMaps();
+
+class HubLabels
+{
+public:
+    HubLabels();
+      // roadClasses (by the graph's name ids) is needed for costs other than
+      // distance
+    void build(const StreetGraph& graph, RouteCost cost = DISTANCE_COST, const uint8_t* roadClasses = nullptr);
+
+    int numNodes() const { return static_cast<int>(m_labelBegin.size()) - 1; }
+      // least cost from one node to another, or -1 if no road joins them
+    double distance(int from, int to) const;
+    double averageLabelSize() const;
+    long memoryUsage() const;
+
+    HubLabels(const HubLabels&) = delete;
+    HubLabels& operator=(const HubLabels&) = delete;
+private:
+    std::vector<uint32_t> m_labelBegin;         // numNodes()+1 offsets into the label arrays
+    std::vector<uint32_t> m_hub;                // hub rank, ascending within a label
+    std::vector<double> m_miles;                // costs, in miles for DISTANCE_COST
+
+    template<typename Cost>
+    void buildFor(const StreetGraph& graph, const Cost& cost);
+};
+
+#endif // HUBLABELS_INCLUDED
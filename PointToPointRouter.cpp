@@ -1,10 +1,23 @@
 #include "provided.h"
+#include "Arena.h"
+#include "CompactGraph.h"
+#include "EdgeWeights.h"
 #include "ExpandableHashMap.h"
+#include "FlatEarth.h"
+#include "QueryLog.h"
+#include "RouteCosts.h"
+#include "RouteQueues.h"
+#include "Stats.h"
+#include "StreetGraph.h"
+#include "TiledMap.h"
+#include "TurnGraph.h"
 #include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <list>
 #include <queue>
-#include <set>
-#include <stack>
 using namespace std;
 
 class PointToPointRouterImpl
@@ -17,8 +30,25 @@ public:
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+    DeliveryResult generateRouteGeometry(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        vector<GeoPoint>& points,
+        double& totalDistanceTravelled) const;
+    DeliveryResult generateAlternativeRoutes(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        int maxRoutes,
+        vector<EdgeRoute>& routes,
+        const AlternativeRouteLimits& limits) const;
+    DeliveryResult expandRoute(const GeoCoord& start, const EdgeRoute& route, list<StreetSegment>& segments) const;
 private:
     const StreetMap* m_streetMap;
+
+    template<typename Search>
+    DeliveryResult onMap(Search search) const;
+    template<typename WalkPath>
+    DeliveryResult searchMap(const GeoCoord& start, const GeoCoord& end, WalkPath walkPath) const;
 };
 
 PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
@@ -30,77 +60,683 @@ PointToPointRouterImpl::~PointToPointRouterImpl()
 {
 }
 
-DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
-        const GeoCoord& start,
-        const GeoCoord& end,
-        list<StreetSegment>& route,
-        double& totalDistanceTravelled) const
+  // Which nodes (or edges, for turn costs) a search has reached, by which edge
+  // from which node, and (for shortest-path searches) at what distance key.
+  // ArrayMarks are per-thread arrays over every node id of a resident graph;
+  // a node's entries belong to the current search only when its stamp
+  // matches, so nothing is cleared between searches.  HashMarks keep only the
+  // nodes reached, in the search's arena, for tiled maps too big to index, and
+  // a search with them indexes its heap the same way.
+namespace
 {
-    route.clear();
-    totalDistanceTravelled = 0;
-    vector<StreetSegment> throwAway;
-    if (!m_streetMap->getSegmentsThatStartWith(start, throwAway) || !m_streetMap->getSegmentsThatStartWith(end, throwAway))
-        return BAD_COORD;
-    queue<GeoCoord> routeQueue;
-    routeQueue.push(start);
-    ExpandableHashMap<GeoCoord, bool> encountered;                          // keeps track of points that have been visited
-    encountered.associate(start, true);
-    ExpandableHashMap<GeoCoord, GeoCoord> locationOfPreviousWayPoint;
-    
-    auto compDistanceFromEnd = [&end](StreetSegment seg1, StreetSegment seg2)
-    {
-        return (distanceEarthMiles(seg1.end, end) > distanceEarthMiles(seg2.end, end));
+    struct ArrayMarks
+    {
+        vector<unsigned int> stamp;
+        vector<int> prevEdge;           // edge the search reached each node by
+        vector<int> prevNode;
+        vector<long long> key;
+        unsigned int current = 0;
+
+        void begin(int numNodes)
+        {
+            if (static_cast<int>(stamp.size()) < numNodes)
+            {
+                stamp.resize(numNodes, 0);
+                prevEdge.resize(numNodes);
+                prevNode.resize(numNodes);
+                key.resize(numNodes);
+            }
+            if (++current == 0)                                             // wrapped: forget every old stamp
+            {
+                fill(stamp.begin(), stamp.end(), 0);
+                current = 1;
+            }
+        }
+        bool reached(int node) const { return stamp[node] == current; }
+        void reach(int node, int from, int edge)
+        {
+            stamp[node] = current;
+            prevNode[node] = from;
+            prevEdge[node] = edge;
+        }
+        int from(int node) const { return prevNode[node]; }
+        int edgeTo(int node) const { return prevEdge[node]; }
+        long long keyOf(int node) const { return key[node]; }
+        void setKey(int node, long long k) { key[node] = k; }
     };
-    
-    while (!routeQueue.empty())
+
+    thread_local ArrayMarks t_marks;
+    thread_local ArrayMarks t_reverseMarks;     // the backward search of a pair
+
+    class HashMarks
+    {
+    public:
+        HashMarks(Arena* arena) : m_reached(0.5, arena) {}
+        void begin(int) {}
+        bool reached(int node) const { return m_reached.find(node) != nullptr; }
+        void reach(int node, int from, int edge)
+        {
+            Mark m = { from, edge, 0 };
+            m_reached.associate(node, m);
+        }
+        int from(int node) const { return m_reached.find(node)->from; }
+        int edgeTo(int node) const { return m_reached.find(node)->edge; }
+        long long keyOf(int node) const { return m_reached.find(node)->key; }
+        void setKey(int node, long long k) { m_reached.find(node)->key = k; }
+    private:
+        struct Mark
+        {
+            int from;
+            int edge;
+            long long key;
+        };
+        ExpandableHashMap<int, Mark> m_reached;
+    };
+
+      // a heap position index over only the nodes queued, to go with HashMarks
+    class HashPositions
+    {
+    public:
+        HashPositions(Arena* arena) : m_at(0.5, arena) {}
+        void clear(int) {}
+        int find(int node) const
+        {
+            const int* at = m_at.find(node);
+            return at != nullptr ? *at : -1;
+        }
+        void set(int node, int at)
+        {
+            int* found = m_at.find(node);
+            if (found != nullptr)
+                *found = at;
+            else
+                m_at.associate(node, at);
+        }
+    private:
+        ExpandableHashMap<int, int> m_at;
+    };
+
+    thread_local QuaternaryHeap t_heap;
+    thread_local RadixHeap t_radix;
+    thread_local BucketQueue t_buckets;
+
+      // search(heap) with a heap indexed the way marks are: the thread's
+      // array-indexed one, or a hashed one in the search's arena
+    template<typename Search>
+    auto withHeap(const ArrayMarks&, Arena*, Search search)
+    {
+        return search(t_heap);
+    }
+
+    template<typename Search>
+    auto withHeap(const HashMarks&, Arena* arena, Search search)
+    {
+        BasicQuaternaryHeap<HashPositions> heap(arena);
+        return search(heap);
+    }
+
+    typedef vector<int, ArenaAllocator<int> > EdgePath;
+
+      // Breadth-first search from startNode until it reaches endNode, trying
+      // each node's streets farthest-from-the-end first (by FlatEarth miles in
+      // fast distance mode).
+    template<typename Network, typename Marks>
+    bool breadthFirst(const Network& network, Marks& marks, Arena* arena,
+                      int startNode, int endNode, const GeoCoord& end)
+    {
+        queue<int, deque<int, ArenaAllocator<int> > > routeQueue((deque<int, ArenaAllocator<int> >(arena)));
+        routeQueue.push(startNode);
+        vector<pair<double, int>, ArenaAllocator<pair<double, int> > > edges(arena);   // (distance of the far end from the end, edge)
+        FlatEarth flat(end.latitude);
+        bool fast = fastDistance();
+        
+        auto compDistanceFromEnd = [](const pair<double, int>& edge1, const pair<double, int>& edge2)   // farthest from the end first
+        {
+            return edge1.first > edge2.first;
+        };
+        
+        while (!routeQueue.empty())
+        {
+            int node = routeQueue.front();
+            routeQueue.pop();
+            STATS_ADD(nodesSettled, 1);
+            if (node == endNode)
+                return true;
+            edges.clear();
+            for (int e = network.firstEdge(node), last = network.endEdge(node); e < last; e++)
+            {
+                if (!network.open(e))
+                    continue;
+                int next = network.target(e);
+                edges.push_back(make_pair(fast ? network.milesTo(next, end, flat) : network.milesTo(next, end), e));
+            }
+            sort(edges.begin(), edges.end(), compDistanceFromEnd);        // each distance computed once, not per comparison
+            STATS_ADD(edgesRelaxed, edges.size());
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                int next = network.target(edges[i].second);
+                if (!marks.reached(next))                                   // checks to see if this node has already been traveled to
+                {
+                    routeQueue.push(next);
+                    marks.reach(next, node, edges[i].second);
+                }
+            }
+        }
+        return false;
+    }
+
+      // Dijkstra's search from startNode until it settles endNode, over edge
+      // costs as integer keys.  A node comes out of a lazy queue once for
+      // every time its key was lowered; all but the first are skipped.
+    template<typename Network, typename Cost, typename Marks, typename Queue>
+    bool shortestFirst(const Network& network, const Cost& cost, Marks& marks, Queue& frontier,
+                       int startNode, int endNode)
     {
-        GeoCoord temp = routeQueue.front();
-        routeQueue.pop();
-        if (temp == end)                                                    // if route has finished
+        frontier.clear(network.numNodes());
+        marks.setKey(startNode, 0);
+        frontier.push(startNode, 0);
+        while (!frontier.empty())
         {
-            GeoCoord endSegment = end;
-            GeoCoord startSegment = *locationOfPreviousWayPoint.find(end);
-            StreetSegment tempSegment;
-            while (startSegment != start)
+            long long key;
+            int node = frontier.pop(key);
+            if (key > marks.keyOf(node))                                    // a stale entry
+                continue;
+            STATS_ADD(nodesSettled, 1);
+            if (node == endNode)
+                return true;
+            int last = network.endEdge(node);
+            STATS_ADD(edgesRelaxed, last - network.firstEdge(node));
+            for (int e = network.firstEdge(node); e < last; e++)
             {
-                m_streetMap->getSegmentsThatStartWith(startSegment, throwAway);
-                for (int i = 0; i < throwAway.size(); i++)
+                if (!network.open(e))
+                    continue;
+                int next = network.target(e);
+                long long nextKey = key + milesToKey(cost(network, e));
+                if (marks.reached(next) && nextKey >= marks.keyOf(next))
+                    continue;
+                marks.reach(next, node, e);
+                marks.setKey(next, nextKey);
+                frontier.push(next, nextKey);
+            }
+        }
+        return false;
+    }
+
+      // Dijkstra's search over edges instead of nodes, for turn costs: an
+      // edge's key is the cost of arriving at its target along it, the turn
+      // onto it included, and its mark's "from" is the edge before it.  Ends
+      // when an edge into endNode is settled, and fills in path.  Penalties
+      // are miles, charged as that much more of the street turned onto.
+    template<typename Network, typename Cost, typename Marks, typename Queue>
+    bool turnCostFirst(const Network& network, const Cost& cost, const TurnGraph& turns, Marks& marks, Queue& frontier,
+                       int startNode, int endNode, EdgePath& path)
+    {
+        const TurnPenalties& penalties = turnPenalties();
+        const double turnMiles[] = { penalties.straight, penalties.right, penalties.left, penalties.uTurn };   // by TurnGraph::Turn
+        marks.begin(turns.numEdges());
+        frontier.clear(turns.numEdges());
+        for (int e = network.firstEdge(startNode), last = network.endEdge(startNode); e < last; e++)
+        {
+            if (!network.open(e))
+                continue;
+            long long key = milesToKey(cost(network, e));                   // no turn to start with
+            marks.reach(e, -1, -1);
+            marks.setKey(e, key);
+            frontier.push(e, key);
+        }
+        while (!frontier.empty())
+        {
+            long long key;
+            int edge = frontier.pop(key);
+            if (key > marks.keyOf(edge))                                    // a stale entry
+                continue;
+            STATS_ADD(nodesSettled, 1);
+            int node = network.target(edge);
+            if (node == endNode)
+            {
+                for (int e = edge; e != -1; e = marks.from(e))
+                    path.push_back(e);
+                reverse(path.begin(), path.end());
+                return true;
+            }
+            int last = network.endEdge(node);
+            STATS_ADD(edgesRelaxed, last - network.firstEdge(node));
+            for (int next = network.firstEdge(node); next < last; next++)
+            {
+                if (!network.open(next))
+                    continue;
+                long long nextKey = key + milesToKey(cost(network, next)) + milesToKey(cost.extra(network, next, turnMiles[turns.turn(edge, next)]));
+                if (marks.reached(next) && nextKey >= marks.keyOf(next))
+                    continue;
+                marks.reach(next, edge, -1);
+                marks.setKey(next, nextKey);
+                frontier.push(next, nextKey);
+            }
+        }
+        return false;
+    }
+
+      // search(cost) with the policy for routeCost(); the search is compiled
+      // once for each
+    template<typename Search>
+    auto withRouteCost(const uint8_t* roadClasses, Search search)
+    {
+        if (routeCost() == DISTANCE_COST)
+            return search(DistanceCost());
+        return search(RoadClassCost(routeCost(), roadClasses));
+    }
+
+      // A route over any network with StreetGraph's interface, searched with
+      // the frontier queue routeQueue() selects for the cost routeCost()
+      // selects (roadClasses is by the network's name ids), and with turn
+      // costs when turns is given.  walkPath(network, startNode, path) reads
+      // the route off the path's edges, in road miles even if network is
+      // weighted.
+    template<typename Network, typename Marks, typename WalkPath>
+    DeliveryResult searchRoute(const Network& network, Marks& marks, const TurnGraph* turns, const uint8_t* roadClasses,
+                               Arena* arena, const GeoCoord& start, const GeoCoord& end, WalkPath& walkPath)
+    {
+        int startNode = network.nodeAt(start);
+        int endNode = network.nodeAt(end);
+        if (startNode == -1 || endNode == -1)
+            return BAD_COORD;
+        EdgePath path((ArenaAllocator<int>(arena)));
+        if (startNode == endNode)                                           // already there
+        {
+            walkPath(roadsOf(network), startNode, path);
+            return DELIVERY_SUCCESS;
+        }
+        if (network.component(startNode) != network.component(endNode))     // no search can connect them
+            return NO_ROUTE;
+        
+        bool found;
+        if (turns != nullptr)
+        {
+            found = withRouteCost(roadClasses, [&](const auto& cost)
+            {
+                switch (routeQueue())                                       // breadth-first search has no costs to add turns to
+                {
+                case RADIX_QUEUE:
+                    return turnCostFirst(network, cost, *turns, marks, t_radix, startNode, endNode, path);
+                case BUCKET_QUEUE:
+                    return turnCostFirst(network, cost, *turns, marks, t_buckets, startNode, endNode, path);
+                default:
+                    return withHeap(marks, arena, [&](auto& heap)
+                    {
+                        return turnCostFirst(network, cost, *turns, marks, heap, startNode, endNode, path);
+                    });
+                }
+            });
+            if (!found)
+                return NO_ROUTE;
+            walkPath(roadsOf(network), startNode, path);
+            return DELIVERY_SUCCESS;
+        }
+        marks.begin(network.numNodes());
+        marks.reach(startNode, -1, -1);
+        if (routeQueue() == FIFO_QUEUE && routeCost() == DISTANCE_COST)
+            found = breadthFirst(network, marks, arena, startNode, endNode, end);
+        else
+        {
+            found = withRouteCost(roadClasses, [&](const auto& cost)
+            {
+                switch (routeQueue())
                 {
-                    if (throwAway[i].end == endSegment)                     // find segment that we traveled through
+                case RADIX_QUEUE:
+                    return shortestFirst(network, cost, marks, t_radix, startNode, endNode);
+                case BUCKET_QUEUE:
+                    return shortestFirst(network, cost, marks, t_buckets, startNode, endNode);
+                default:                                                    // breadth-first search has no costs to minimize
+                    return withHeap(marks, arena, [&](auto& heap)
                     {
-                        tempSegment = throwAway[i];
-                        route.insert(route.begin(), tempSegment);
-                        break;
-                    }
+                        return shortestFirst(network, cost, marks, heap, startNode, endNode);
+                    });
                 }
-                totalDistanceTravelled += distanceEarthMiles(tempSegment.start, tempSegment.end);
-                endSegment = tempSegment.start;
-                startSegment = *locationOfPreviousWayPoint.find(endSegment);
+            });
+        }
+        if (!found)
+            return NO_ROUTE;
+        for (int at = endNode; at != startNode; at = marks.from(at))       // walk the edges back to the start
+            path.push_back(marks.edgeTo(at));
+        reverse(path.begin(), path.end());
+        walkPath(roadsOf(network), startNode, path);
+        return DELIVERY_SUCCESS;
+    }
+
+    typedef vector<int, ArenaAllocator<int> > NodeList;
+
+      // the cheapest open edge from one node to another, or -1
+    template<typename Network, typename Cost>
+    int edgeBetween(const Network& network, const Cost& cost, int from, int to)
+    {
+        int best = -1;
+        for (int e = network.firstEdge(from), last = network.endEdge(from); e < last; e++)
+            if (network.target(e) == to && network.open(e) && (best == -1 || cost(network, e) < cost(network, best)))
+                best = e;
+        return best;
+    }
+
+      // Dijkstra's search from root that settles every node within bound.  A
+      // reverse search follows edges backward, so a node's mark holds the edge
+      // out of it toward root.  If stopAt is settled while bound is still
+      // LLONG_MAX, bound becomes its key times stretch.  Returns the bound;
+      // settled (if given) lists the nodes settled, in order.
+    template<typename Network, typename Cost, typename Marks, typename Queue>
+    long long boundedSearch(const Network& network, const Cost& cost, Marks& marks, Queue& frontier, bool reverse,
+                            int root, int stopAt, double stretch, long long bound, NodeList* settled)
+    {
+        marks.begin(network.numNodes());
+        frontier.clear(network.numNodes());
+        marks.reach(root, -1, -1);
+        marks.setKey(root, 0);
+        frontier.push(root, 0);
+        while (!frontier.empty())
+        {
+            long long key;
+            int node = frontier.pop(key);
+            if (key > bound)
+                break;
+            if (key > marks.keyOf(node))                                    // a stale entry
+                continue;
+            STATS_ADD(nodesSettled, 1);
+            if (settled != nullptr)
+                settled->push_back(node);
+            if (node == stopAt && bound == LLONG_MAX)
+                bound = llround(key * stretch);
+            int last = network.endEdge(node);
+            STATS_ADD(edgesRelaxed, last - network.firstEdge(node));
+            for (int e = network.firstEdge(node); e < last; e++)
+            {
+                int next = network.target(e);
+                int edge = reverse ? edgeBetween(network, cost, next, node) : e;
+                if (edge == -1 || !network.open(edge))
+                    continue;
+                long long nextKey = key + milesToKey(cost(network, edge));
+                if (marks.reached(next) && nextKey >= marks.keyOf(next))
+                    continue;
+                marks.reach(next, node, edge);
+                marks.setKey(next, nextKey);
+                frontier.push(next, nextKey);
             }
-            route.insert(route.begin(), tempSegment);
-            totalDistanceTravelled += distanceEarthMiles(tempSegment.start, tempSegment.end);
+        }
+        return bound;
+    }
+
+      // Alternatives by via nodes, from one forward search from the start and
+      // one backward search from the end, each over every node within
+      // maxStretch of the shortest route's cost.  A via node v settled by both
+      // gives the route along the forward tree to v and the backward tree on
+      // to the end.  Where the two trees share a run of edges (a plateau),
+      // every node on it gives the same route, and that run is a shortest path
+      // along its whole length, so the plateau is both the candidate and its
+      // proof of local optimality.  Candidates are ranked by twice their cost,
+      // plus the cost they share with the shortest route, less their plateau,
+      // and accepted best first while they share little enough with every
+      // route accepted before them and visit no node twice.
+    template<typename Network, typename Cost, typename Marks>
+    DeliveryResult alternativesOver(const Network& network, const Cost& cost, Marks& forward, Marks& backward, Arena* arena,
+                                    const GeoCoord& start, const GeoCoord& end, int maxRoutes,
+                                    const AlternativeRouteLimits& limits, vector<EdgeRoute>& routes)
+    {
+        struct Candidate
+        {
+            int via;
+            long long cost;
+            long long plateau;
+            long long shared;           // with the shortest route
+        };
+
+        int startNode = network.nodeAt(start);
+        int endNode = network.nodeAt(end);
+        if (startNode == -1 || endNode == -1)
+            return BAD_COORD;
+        if (maxRoutes <= 0)
+            return DELIVERY_SUCCESS;
+        if (startNode == endNode)
+        {
+            routes.push_back(EdgeRoute());
             return DELIVERY_SUCCESS;
         }
-        vector<StreetSegment> streetSegs;
-        m_streetMap->getSegmentsThatStartWith(temp, streetSegs);
-        sort(streetSegs.begin(), streetSegs.end(), compDistanceFromEnd);
-        for (int i = 0; i < streetSegs.size(); i++)
+        if (network.component(startNode) != network.component(endNode))
+            return NO_ROUTE;
+        NodeList settled((ArenaAllocator<int>(arena)));
+        long long bound = withHeap(forward, arena, [&](auto& heap)
+        {
+            return boundedSearch(network, cost, forward, heap, false, startNode, endNode, limits.maxStretch, LLONG_MAX, &settled);
+        });
+        if (bound == LLONG_MAX)
+            return NO_ROUTE;
+        long long shortest = forward.keyOf(endNode);
+        withHeap(backward, arena, [&](auto& heap)
+        {
+            return boundedSearch(network, cost, backward, heap, true, endNode, -1, 1, bound, nullptr);
+        });
+        auto settledBy = [bound](const Marks& marks, int node) { return marks.reached(node) && marks.keyOf(node) <= bound; };
+
+          // the edges of the route via v, start to end
+        auto viaRoute = [&](int via, EdgePath& path)
+        {
+            path.clear();
+            for (int at = via; at != startNode; at = forward.from(at))
+                path.push_back(forward.edgeTo(at));
+            reverse(path.begin(), path.end());
+            for (int at = via; at != endNode; at = backward.from(at))
+                path.push_back(backward.edgeTo(at));
+        };
+        auto addRoute = [&](const EdgePath& path, ExpandableHashMap<int, char>& chosen)
+        {
+            routes.push_back(EdgeRoute());
+            EdgeRoute& route = routes.back();
+            route.edges.assign(path.begin(), path.end());
+            for (size_t i = 0; i < path.size(); i++)
+            {
+                route.distance += roadsOf(network).length(path[i]);
+                chosen.associate(path[i], 1);
+            }
+        };
+        auto sharedCost = [&](const EdgePath& path, const ExpandableHashMap<int, char>& chosen)
+        {
+            long long shared = 0;
+            for (size_t i = 0; i < path.size(); i++)
+                if (chosen.find(path[i]) != nullptr)
+                    shared += milesToKey(cost(network, path[i]));
+            return shared;
+        };
+
+        EdgePath path((ArenaAllocator<int>(arena)));
+        ExpandableHashMap<int, char> chosen(0.5, arena);
+        viaRoute(endNode, path);
+        addRoute(path, chosen);
+
+        long long minPlateau = llround(shortest * limits.minLocalOptimality);
+        ExpandableHashMap<int, char> onPlateau(0.5, arena);
+        vector<Candidate, ArenaAllocator<Candidate> > candidates((ArenaAllocator<Candidate>(arena)));
+        for (size_t i = 0; i < settled.size() && maxRoutes > 1; i++)
+        {
+            int via = settled[i];
+            if (onPlateau.find(via) != nullptr || !settledBy(backward, via))
+                continue;
+            long long viaCost = forward.keyOf(via) + backward.keyOf(via);
+            if (viaCost > bound)
+                continue;
+            int first = via;                                                // widen to the whole plateau
+            while (first != startNode && settledBy(backward, forward.from(first)) &&
+                   backward.edgeTo(forward.from(first)) == forward.edgeTo(first))
+                first = forward.from(first);
+            int last = via;
+            while (last != endNode && settledBy(forward, backward.from(last)) &&
+                   forward.edgeTo(backward.from(last)) == backward.edgeTo(last))
+                last = backward.from(last);
+            for (int at = first; ; at = backward.from(at))
+            {
+                onPlateau.associate(at, 1);
+                if (at == last)
+                    break;
+            }
+            long long plateau = forward.keyOf(last) - forward.keyOf(first);
+            if (plateau < minPlateau || (first == startNode && last == endNode))    // not locally optimal, or the shortest route
+                continue;
+            viaRoute(via, path);
+            candidates.push_back(Candidate{ via, viaCost, plateau, sharedCost(path, chosen) });
+        }
+        sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+        {
+            return 2 * a.cost + a.shared - a.plateau < 2 * b.cost + b.shared - b.plateau;
+        });
+
+        long long maxShared = llround(shortest * limits.maxSharing);
+        for (size_t i = 0; i < candidates.size() && static_cast<int>(routes.size()) < maxRoutes; i++)
         {
-            if (encountered.find(streetSegs[i].end) == nullptr)             // checks to see if endpoint of segment has already been traveled to
+            if (candidates[i].shared > maxShared)
+                continue;
+            viaRoute(candidates[i].via, path);
+            if (sharedCost(path, chosen) > maxShared)
+                continue;
+            ExpandableHashMap<int, char> visited(0.5, arena);
+            bool simple = true;
+            int node = startNode;
+            for (size_t j = 0; j < path.size() && simple; j++)
             {
-                routeQueue.push(streetSegs[i].end);
-                encountered.associate(streetSegs[i].end, true);
-                locationOfPreviousWayPoint.associate(streetSegs[i].end, streetSegs[i].start);
+                simple = visited.find(node) == nullptr;
+                visited.associate(node, 1);
+                node = network.target(path[j]);
             }
+            if (simple)
+                addRoute(path, chosen);
         }
+        return DELIVERY_SUCCESS;
     }
-    return NO_ROUTE;
 }
 
+  // search(network, marks, reverseMarks, arena) over whichever form the map is
+  // in, with the map's edge updates if it has any.
+template<typename Search>
+DeliveryResult PointToPointRouterImpl::onMap(Search search) const
+{
+    ArenaScope scratch(threadArena());                                      // search state is released in one shot on return
+    Arena* arena = &scratch.arena();
+    const TiledMap* tiles = m_streetMap->tiles();
+    if (tiles != nullptr)                                                   // tiles are faulted in as the search reaches them
+    {
+        TiledMap::Cursor cursor(*tiles);
+        HashMarks marks(arena);
+        HashMarks reverseMarks(arena);
+        return search(cursor, marks, reverseMarks, arena);
+    }
+    const CompactGraph* compact = m_streetMap->compactGraph();
+    const EdgeWeights* weights = m_streetMap->edgeWeights();
+    if (compact != nullptr)                                                 // blocks are decoded as the search reaches them
+    {
+        CompactGraph::Cursor cursor(*compact);
+        if (weights != nullptr)
+            return search(WeightedNetwork<CompactGraph::Cursor>(cursor, *weights), t_marks, t_reverseMarks, arena);
+        return search(cursor, t_marks, t_reverseMarks, arena);
+    }
+    if (weights != nullptr)
+        return search(WeightedNetwork<StreetGraph>(m_streetMap->graph(), *weights), t_marks, t_reverseMarks, arena);
+    return search(m_streetMap->graph(), t_marks, t_reverseMarks, arena);
+}
+
+template<typename WalkPath>
+DeliveryResult PointToPointRouterImpl::searchMap(const GeoCoord& start, const GeoCoord& end, WalkPath walkPath) const
+{
+    const TurnGraph* turns = m_streetMap->tiles() != nullptr ? nullptr : m_streetMap->turnGraph();
+    const uint8_t* roadClasses = m_streetMap->roadClasses();
+    return onMap([&](const auto& network, auto& marks, auto&, Arena* arena)
+    {
+        return searchRoute(network, marks, turns, roadClasses, arena, start, end, walkPath);
+    });
+}
+
+DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled) const
+{
+    STATS_TIMER(routeMs);
+    STATS_ADD(routeQueries, 1);
+    route.clear();
+    totalDistanceTravelled = 0;
+    auto addSegments = [&route, &totalDistanceTravelled](const auto& network, int node, const EdgePath& path)
+    {
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            route.push_back(network.segment(node, path[i]));
+            totalDistanceTravelled += network.length(path[i]);
+            node = network.target(path[i]);
+        }
+    };
+    return searchMap(start, end, addSegments);
+}
+
+  // The same search, but only the nodes' positions are read off the path.
+DeliveryResult PointToPointRouterImpl::generateRouteGeometry(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        vector<GeoPoint>& points,
+        double& totalDistanceTravelled) const
+{
+    STATS_TIMER(routeMs);
+    STATS_ADD(routeQueries, 1);
+    points.clear();
+    totalDistanceTravelled = 0;
+    auto addPoints = [&points, &totalDistanceTravelled](const auto& network, int node, const EdgePath& path)
+    {
+        points.push_back(network.point(node));
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            node = network.target(path[i]);
+            points.push_back(network.point(node));
+            totalDistanceTravelled += network.length(path[i]);
+        }
+    };
+    return searchMap(start, end, addPoints);
+}
+
+  // Alternatives ignore turn costs: via nodes are intersections, and the two
+  // trees meet at them, not at edges.
+DeliveryResult PointToPointRouterImpl::generateAlternativeRoutes(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        int maxRoutes,
+        vector<EdgeRoute>& routes,
+        const AlternativeRouteLimits& limits) const
+{
+    STATS_TIMER(routeMs);
+    STATS_ADD(routeQueries, 1);
+    routes.clear();
+    const uint8_t* roadClasses = m_streetMap->roadClasses();
+    return onMap([&](const auto& network, auto& marks, auto& reverseMarks, Arena* arena)
+    {
+        return withRouteCost(roadClasses, [&](const auto& cost)
+        {
+            return alternativesOver(network, cost, marks, reverseMarks, arena, start, end, maxRoutes, limits, routes);
+        });
+    });
+}
+
+DeliveryResult PointToPointRouterImpl::expandRoute(const GeoCoord& start, const EdgeRoute& route, list<StreetSegment>& segments) const
+{
+    segments.clear();
+    return onMap([&](const auto& network, auto&, auto&, Arena*)
+    {
+        int node = network.nodeAt(start);
+        if (node == -1)
+            return BAD_COORD;
+        for (size_t i = 0; i < route.edges.size(); i++)
+        {
+            segments.push_back(network.segment(node, route.edges[i]));
+            node = network.target(route.edges[i]);
+        }
+        return DELIVERY_SUCCESS;
+    });
+}
 
 //******************** PointToPointRouter functions ***************************
 
-// These functions simply delegate to PointToPointRouterImpl's functions.
+// These functions simply delegate to PointToPointRouterImpl's functions,
+// recording each route request when a query log is installed.
 // You probably don't want to change any of this code.
 
 PointToPointRouter::PointToPointRouter(const StreetMap* sm)
@@ -113,12 +749,80 @@ PointToPointRouter::~PointToPointRouter()
     delete m_impl;
 }
 
+  // as few digits as read back as d
+static string exactText(double d)
+{
+    char text[32];
+    for (int digits = 6; digits <= 17; digits++)
+    {
+        snprintf(text, sizeof(text), "%.*g", digits, d);
+        if (strtod(text, nullptr) == d)
+            break;
+    }
+    return text;
+}
+
+static void recordRoute(QueryRecording& recording, const string& options,
+    const GeoCoord& start, const GeoCoord& end,
+    DeliveryResult result, double distance, unsigned long outputSize)
+{
+    if (!recording.active())
+        return;
+    QueryRecord record;
+    record.kind = QueryRecord::ROUTE;
+    record.options = options;
+    record.start = start;
+    record.end = end;
+    record.result = result;
+    record.distance = distance;
+    record.outputSize = outputSize;
+    recording.finish(record);
+}
+
 DeliveryResult PointToPointRouter::generatePointToPointRoute(  // deliveryresult
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const
 {
-    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
+    QueryRecording recording;
+    DeliveryResult result = m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
+    recordRoute(recording, "route", start, end, result, totalDistanceTravelled, route.size());
+    return result;
+}
+
+DeliveryResult PointToPointRouter::generateRouteGeometry(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        vector<GeoPoint>& points,
+        double& totalDistanceTravelled) const
+{
+    QueryRecording recording;
+    DeliveryResult result = m_impl->generateRouteGeometry(start, end, points, totalDistanceTravelled);
+    recordRoute(recording, "route geometry", start, end, result, totalDistanceTravelled, points.size());
+    return result;
+}
+
+
+DeliveryResult PointToPointRouter::generateAlternativeRoutes(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        int maxRoutes,
+        vector<EdgeRoute>& routes,
+        const AlternativeRouteLimits& limits) const
+{
+    QueryRecording recording;
+    DeliveryResult result = m_impl->generateAlternativeRoutes(start, end, maxRoutes, routes, limits);
+    if (recording.active())
+    {
+        string options = "route alternatives " + to_string(maxRoutes) + " " + exactText(limits.maxStretch) +
+                         " " + exactText(limits.maxSharing) + " " + exactText(limits.minLocalOptimality);
+        recordRoute(recording, options, start, end, result, routes.empty() ? 0 : routes[0].distance, routes.size());
+    }
+    return result;
 }
 
+DeliveryResult PointToPointRouter::expandRoute(const GeoCoord& start, const EdgeRoute& route, list<StreetSegment>& segments) const
+{
+    return m_impl->expandRoute(start, route, segments);
+}
@@ -0,0 +1,127 @@
+#include "Polyline.h"
+#include "FlatEarth.h"
+#include <cmath>
+#include <utility>
+using namespace std;
+
+namespace
+{
+      // squared miles from p to the segment a-b, on a plane tangent near them
+    double squaredMilesToSegment(const GeoPoint& p, const GeoPoint& a, const GeoPoint& b, double lonScale)
+    {
+        double bx = (b.longitude - a.longitude) * lonScale, by = b.latitude - a.latitude;
+        double px = (p.longitude - a.longitude) * lonScale, py = p.latitude - a.latitude;
+        double lengthSquared = bx * bx + by * by;
+        double t = lengthSquared > 0 ? (px * bx + py * by) / lengthSquared : 0;
+        if (t < 0)
+            t = 0;
+        else if (t > 1)
+            t = 1;
+        double dx = px - t * bx, dy = py - t * by;
+        return (dx * dx + dy * dy) * FlatEarth::MILES_PER_DEGREE * FlatEarth::MILES_PER_DEGREE;
+    }
+
+    void putValue(long long value, string& out)
+    {
+        unsigned long long v = value < 0 ? ~(static_cast<unsigned long long>(value) << 1) : static_cast<unsigned long long>(value) << 1;
+        while (v >= 0x20)
+        {
+            out += static_cast<char>((0x20 | (v & 0x1f)) + 63);
+            v >>= 5;
+        }
+        out += static_cast<char>(v + 63);
+    }
+
+    bool getValue(const string& in, size_t& pos, long long& value)
+    {
+        unsigned long long v = 0;
+        for (int shift = 0; shift < 64; shift += 5)
+        {
+            if (pos >= in.size() || in[pos] < 63 || in[pos] > 126)
+                return false;
+            unsigned long long chunk = static_cast<unsigned long long>(in[pos++] - 63);
+            v |= (chunk & 0x1f) << shift;
+            if ((chunk & 0x20) == 0)
+            {
+                value = (v & 1) ? ~static_cast<long long>(v >> 1) : static_cast<long long>(v >> 1);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+  // Iterative, with an explicit stack of ranges still to split, so long routes
+  // cannot overflow the call stack.
+void simplifyPolyline(const vector<GeoPoint>& points, double toleranceMiles, vector<GeoPoint>& simplified)
+{
+    simplified.clear();
+    if (points.size() <= 2)
+    {
+        simplified = points;
+        return;
+    }
+    double lonScale = cos(deg2rad(points[0].latitude));
+    double toleranceSquared = toleranceMiles * toleranceMiles;
+    vector<bool> keep(points.size(), false);
+    keep.front() = keep.back() = true;
+    vector<pair<size_t, size_t> > ranges(1, make_pair(size_t(0), points.size() - 1));
+    while (!ranges.empty())
+    {
+        size_t first = ranges.back().first;
+        size_t last = ranges.back().second;
+        ranges.pop_back();
+        size_t farthest = first;
+        double farthestSquared = toleranceSquared;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            double d = squaredMilesToSegment(points[i], points[first], points[last], lonScale);
+            if (d > farthestSquared)
+            {
+                farthest = i;
+                farthestSquared = d;
+            }
+        }
+        if (farthest == first)                                              // all within tolerance
+            continue;
+        keep[farthest] = true;
+        ranges.push_back(make_pair(first, farthest));
+        ranges.push_back(make_pair(farthest, last));
+    }
+    for (size_t i = 0; i < points.size(); i++)
+        if (keep[i])
+            simplified.push_back(points[i]);
+}
+
+void encodePolyline(const vector<GeoPoint>& points, string& encoded, int precision)
+{
+    double scale = pow(10.0, precision);
+    long long lat = 0, lon = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        long long nextLat = llround(points[i].latitude * scale);
+        long long nextLon = llround(points[i].longitude * scale);
+        putValue(nextLat - lat, encoded);
+        putValue(nextLon - lon, encoded);
+        lat = nextLat;
+        lon = nextLon;
+    }
+}
+
+bool decodePolyline(const string& encoded, vector<GeoPoint>& points, int precision)
+{
+    double scale = pow(10.0, precision);
+    long long lat = 0, lon = 0;
+    size_t pos = 0;
+    points.clear();
+    while (pos < encoded.size())
+    {
+        long long dLat, dLon;
+        if (!getValue(encoded, pos, dLat) || !getValue(encoded, pos, dLon))
+            return false;
+        lat += dLat;
+        lon += dLon;
+        points.push_back(GeoPoint{ lat / scale, lon / scale });
+    }
+    return true;
+}
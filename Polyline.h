@@ -0,0 +1,26 @@
+// Polyline.h
+
+// Route geometry for clients, from PointToPointRouter::generateRouteGeometry:
+// Douglas-Peucker simplification and Google's encoded polyline format, in
+// which each coordinate is rounded to 10^-precision degrees and written as a
+// zigzag varint of its difference from the point before, five bits to a
+// printable character.  At the default precision of 5 (about a meter) a
+// vertex typically takes 4 to 8 characters.
+
+#ifndef POLYLINE_INCLUDED
+#define POLYLINE_INCLUDED
+
+#include "provided.h"
+#include <string>
+#include <vector>
+
+  // Douglas-Peucker: keeps the ends and every point farther than
+  // toleranceMiles from the line between the points kept on either side.
+void simplifyPolyline(const std::vector<GeoPoint>& points, double toleranceMiles, std::vector<GeoPoint>& simplified);
+
+  // appends the encoding of points to encoded
+void encodePolyline(const std::vector<GeoPoint>& points, std::string& encoded, int precision = 5);
+  // false if encoded is not a well-formed polyline
+bool decodePolyline(const std::string& encoded, std::vector<GeoPoint>& points, int precision = 5);
+
+#endif // POLYLINE_INCLUDED
@@ -0,0 +1,381 @@
+#include "provided.h"
+#include "QueryLog.h"
+#include "CompactGraph.h"
+#include "FlatEarth.h"
+#include "HubLabels.h"
+#include "RouteCosts.h"
+#include "RouteQueues.h"
+#include "TurnGraph.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// File layout: the magic "DQLOG2\n", then one record after another.
+//   u8 kind, string options, string settings, string startLat, string startLon,
+//   ROUTE: string endLat, string endLon
+//   PLAN:  varint count, then count x (string lat, string lon, string item)
+//   u8 result, f64 distance, varint outputSize, f64 latencyMs
+// Strings are a varint length and the bytes; f64s are little-endian.
+// Coordinates keep their text, since that is what map lookups compare.
+// "DQLOG1\n" logs are the same without settings, and read as recorded with
+// every switch at its default.
+
+static const char LOG_MAGIC[] = "DQLOG2\n";
+static const char LOG_MAGIC_V1[] = "DQLOG1\n";
+
+static void putVarint(string& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+static void putString(string& out, const string& s)
+{
+    putVarint(out, s.size());
+    out += s;
+}
+
+static void putDouble(string& out, double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+        out += static_cast<char>((bits >> (8 * i)) & 0xff);
+}
+
+namespace
+{
+    class Reader
+    {
+    public:
+        Reader(const string& data) : m_data(data), m_pos(0), m_ok(true) {}
+        bool ok() const { return m_ok; }
+        bool atEnd() const { return m_pos >= m_data.size(); }
+        uint8_t byte()
+        {
+            if (m_pos >= m_data.size())
+            {
+                m_ok = false;
+                return 0;
+            }
+            return static_cast<uint8_t>(m_data[m_pos++]);
+        }
+        uint64_t varint()
+        {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64 && m_ok; shift += 7)
+            {
+                uint8_t b = byte();
+                v |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if ((b & 0x80) == 0)
+                    break;
+            }
+            return v;
+        }
+        string str()
+        {
+            uint64_t n = varint();
+            if (!m_ok || n > m_data.size() - m_pos)
+            {
+                m_ok = false;
+                return string();
+            }
+            string s = m_data.substr(m_pos, n);
+            m_pos += n;
+            return s;
+        }
+        double f64()
+        {
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++)
+                bits |= static_cast<uint64_t>(byte()) << (8 * i);
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            return d;
+        }
+        GeoCoord coord()
+        {
+            string lat = str();
+            string lon = str();
+            if (!m_ok)
+                return GeoCoord();
+            try
+            {
+                return GeoCoord(lat, lon);
+            }
+            catch (const exception&)
+            {
+                m_ok = false;
+                return GeoCoord();
+            }
+        }
+    private:
+        const string& m_data;
+        size_t m_pos;
+        bool m_ok;
+    };
+}
+
+class QueryLogImpl
+{
+public:
+    bool open(const string& logFile);
+    void append(const QueryRecord& record);
+    void flush();
+private:
+    ofstream m_out;
+    mutex m_mutex;
+    string m_buffer;
+};
+
+bool QueryLogImpl::open(const string& logFile)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_out.open(logFile, ios::binary | ios::trunc);
+    if (!m_out)
+        return false;
+    m_out.write(LOG_MAGIC, sizeof(LOG_MAGIC) - 1);
+    return true;
+}
+
+void QueryLogImpl::append(const QueryRecord& record)
+{
+    string bytes;
+    bytes += static_cast<char>(record.kind);
+    putString(bytes, record.options);
+    putString(bytes, record.settings);
+    putString(bytes, record.start.latitudeText);
+    putString(bytes, record.start.longitudeText);
+    if (record.kind == QueryRecord::ROUTE)
+    {
+        putString(bytes, record.end.latitudeText);
+        putString(bytes, record.end.longitudeText);
+    }
+    else
+    {
+        putVarint(bytes, record.deliveries.size());
+        for (size_t i = 0; i < record.deliveries.size(); i++)
+        {
+            putString(bytes, record.deliveries[i].location.latitudeText);
+            putString(bytes, record.deliveries[i].location.longitudeText);
+            putString(bytes, record.deliveries[i].item);
+        }
+    }
+    bytes += static_cast<char>(record.result);
+    putDouble(bytes, record.distance);
+    putVarint(bytes, record.outputSize);
+    putDouble(bytes, record.latencyMs);
+
+    lock_guard<mutex> lock(m_mutex);
+    m_buffer += bytes;
+    if (m_buffer.size() >= (1 << 16))
+    {
+        m_out.write(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
+}
+
+void QueryLogImpl::flush()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_out.write(m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+    m_out.flush();
+}
+
+//******************** QueryLog functions *************************************
+
+QueryLog::QueryLog()
+{
+    m_impl = new QueryLogImpl;
+}
+
+QueryLog::~QueryLog()
+{
+    m_impl->flush();
+    delete m_impl;
+}
+
+bool QueryLog::open(const string& logFile)
+{
+    return m_impl->open(logFile);
+}
+
+void QueryLog::append(const QueryRecord& record)
+{
+    m_impl->append(record);
+}
+
+void QueryLog::flush()
+{
+    m_impl->flush();
+}
+
+bool QueryLog::read(const string& logFile, vector<QueryRecord>& records)
+{
+    ifstream in(logFile, ios::binary);
+    if (!in)
+        return false;
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    size_t magicSize = sizeof(LOG_MAGIC) - 1;
+    bool hasSettings = data.compare(0, magicSize, LOG_MAGIC) == 0;
+    if (!hasSettings && data.compare(0, magicSize, LOG_MAGIC_V1) != 0)
+        return false;
+    data.erase(0, magicSize);
+    Reader r(data);
+    while (!r.atEnd())
+    {
+        QueryRecord record;
+        uint8_t kind = r.byte();
+        if (kind > QueryRecord::PLAN)
+            return false;
+        record.kind = static_cast<QueryRecord::Kind>(kind);
+        record.options = r.str();
+        if (hasSettings)
+            record.settings = r.str();
+        record.start = r.coord();
+        if (record.kind == QueryRecord::ROUTE)
+            record.end = r.coord();
+        else
+        {
+            uint64_t n = r.varint();
+            for (uint64_t i = 0; i < n && r.ok(); i++)
+            {
+                GeoCoord location = r.coord();
+                string item = r.str();
+                record.deliveries.push_back(DeliveryRequest(item, location));
+            }
+        }
+        uint8_t result = r.byte();
+        if (result > BAD_COORD)
+            return false;
+        record.result = static_cast<DeliveryResult>(result);
+        record.distance = r.f64();
+        record.outputSize = r.varint();
+        record.latencyMs = r.f64();
+        if (!r.ok())
+            return false;
+        records.push_back(record);
+    }
+    return true;
+}
+
+//******************** settings ***********************************************
+
+string routingSettings()
+{
+    string settings;
+    auto add = [&settings](const string& flag)
+    {
+        if (!settings.empty())
+            settings += ' ';
+        settings += flag;
+    };
+    if (compactMaps())
+        add("--compact");
+    if (hubLabelMaps())
+        add("--hub-labels");
+    if (turnCostMaps())
+        add("--turn-costs");
+    if (fastDistance())
+        add("--fast-distance");
+    if (routeQueue() != FIFO_QUEUE)
+        add(string("--route-queue=") + routeQueueName(routeQueue()));
+    if (routeCost() != DISTANCE_COST)
+        add(string("--route-cost=") + routeCostName(routeCost()));
+    if (routeCost() == TRAVEL_TIME_COST && roadSpeedsText(roadSpeeds()) != roadSpeedsText(RoadSpeeds()))
+        add("--road-speeds=" + roadSpeedsText(roadSpeeds()));
+    if (routeCost() == CUSTOM_COST && roadWeightsText(customRoadWeights()) != roadWeightsText(RoadWeights()))
+        add("--road-weights=" + roadWeightsText(customRoadWeights()));
+    return settings;
+}
+
+bool applyRoutingSetting(const string& flag)
+{
+    if (flag == "--compact")
+        setCompactMaps(true);
+    else if (flag == "--hub-labels")
+        setHubLabelMaps(true);
+    else if (flag == "--turn-costs")
+        setTurnCostMaps(true);
+    else if (flag == "--fast-distance")
+        setFastDistance(true);
+    else if (flag.compare(0, 14, "--route-queue=") == 0)
+    {
+        RouteQueue queue;
+        if (!parseRouteQueue(flag.substr(14), queue))
+            return false;
+        setRouteQueue(queue);
+    }
+    else if (flag.compare(0, 13, "--route-cost=") == 0)
+    {
+        RouteCost cost;
+        if (!parseRouteCost(flag.substr(13), cost))
+            return false;
+        setRouteCost(cost);
+    }
+    else if (flag.compare(0, 14, "--road-speeds=") == 0)
+    {
+        RoadSpeeds speeds;
+        if (!parseRoadSpeeds(flag.substr(14), speeds))
+            return false;
+        setRoadSpeeds(speeds);
+    }
+    else if (flag.compare(0, 15, "--road-weights=") == 0)
+    {
+        RoadWeights weights;
+        if (!parseRoadWeights(flag.substr(15), weights))
+            return false;
+        setCustomRoadWeights(weights);
+    }
+    else
+        return false;
+    return true;
+}
+
+//******************** recording **********************************************
+
+static atomic<QueryLog*> s_log(nullptr);
+static thread_local bool t_recording = false;      // an enclosing request is being recorded
+
+void setQueryLog(QueryLog* log)
+{
+    s_log = log;
+}
+
+QueryRecording::QueryRecording()
+ : m_log(nullptr)
+{
+    if (t_recording)
+        return;
+    m_log = s_log.load();
+    if (m_log != nullptr)
+    {
+        t_recording = true;
+        m_begin = chrono::steady_clock::now();
+    }
+}
+
+QueryRecording::~QueryRecording()
+{
+    if (m_log != nullptr)
+        t_recording = false;
+}
+
+void QueryRecording::finish(QueryRecord& record)
+{
+    if (m_log == nullptr)
+        return;
+    record.latencyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - m_begin).count();
+    record.settings = routingSettings();
+    m_log->append(record);
+}
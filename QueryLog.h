@@ -0,0 +1,83 @@
+// QueryLog.h
+
+// Recording of routing and planning requests to a compact binary log, so that
+// real traffic can be replayed offline against another build (tools/replay.cpp).
+//
+// While a log is installed with setQueryLog, every outermost call to
+// PointToPointRouter::generatePointToPointRoute, generateRouteGeometry (and
+// so the query server's route requests) or generateAlternativeRoutes, and
+// DeliveryPlanner::generateDeliveryPlan appends one record with its inputs,
+// result and latency.  Routes the planner runs for its own legs are not
+// recorded separately.
+//
+// Each record also carries the global switches that decide what a route or
+// plan comes out as, written as the command-line flags that set them, so a
+// replay can run under the same settings and say so when it does not.
+
+#ifndef QUERYLOG_INCLUDED
+#define QUERYLOG_INCLUDED
+
+#include "provided.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct QueryRecord
+{
+    enum Kind { ROUTE, PLAN };
+
+    Kind                         kind;
+    std::string                  options;       // which API served the request
+    std::string                  settings;      // routingSettings() at the time
+    GeoCoord                     start;         // route start, or plan depot
+    GeoCoord                     end;           // route only
+    std::vector<DeliveryRequest> deliveries;    // plan only
+    DeliveryResult               result;
+    double                       distance;      // miles (of the best route, for alternatives)
+    unsigned long                outputSize;    // segments or points in the route, routes found, or commands in the plan
+    double                       latencyMs;
+};
+
+  // The switches in effect that change routes or plans, as the flags that set
+  // them ("--compact --route-queue=radix"); "" when all are at their defaults.
+std::string routingSettings();
+  // applies one such flag; false if flag is not one of them
+bool applyRoutingSetting(const std::string& flag);
+
+class QueryLogImpl;
+
+class QueryLog
+{
+public:
+    QueryLog();
+    ~QueryLog();
+    bool open(const std::string& logFile);      // truncates
+    void append(const QueryRecord& record);     // safe to call from several threads
+    void flush();
+    static bool read(const std::string& logFile, std::vector<QueryRecord>& records);
+    QueryLog(const QueryLog&) = delete;
+    QueryLog& operator=(const QueryLog&) = delete;
+private:
+    QueryLogImpl* m_impl;
+};
+
+  // install log as the destination for recorded requests; nullptr stops recording
+void setQueryLog(QueryLog* log);
+
+  // Times one request and records it, if a log is installed and no enclosing
+  // request on this thread is already being recorded.
+class QueryRecording
+{
+public:
+    QueryRecording();
+    ~QueryRecording();
+    bool active() const { return m_log != nullptr; }
+    void finish(QueryRecord& record);           // fills in settings and latencyMs and appends
+    QueryRecording(const QueryRecording&) = delete;
+    QueryRecording& operator=(const QueryRecording&) = delete;
+private:
+    QueryLog* m_log;
+    std::chrono::steady_clock::time_point m_begin;
+};
+
+#endif // QUERYLOG_INCLUDED
@@ -0,0 +1,811 @@
+#include "provided.h"
+#include "CommandWriter.h"
+#include "Polyline.h"
+#include "QueryServer.h"
+#include "StreetMapVersions.h"
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+//******************** minimal JSON reader ************************************
+
+// Just enough JSON for request lines.  Numbers keep their source text so that
+// coordinates survive exactly.
+
+struct JsonValue
+{
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    string text;                            // string contents, or number/boolean source text
+    vector<pair<string, JsonValue> > members;
+    vector<JsonValue> elements;
+
+    const JsonValue* member(const string& key) const
+    {
+        for (size_t i = 0; i < members.size(); i++)
+            if (members[i].first == key)
+                return &members[i].second;
+        return nullptr;
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const string& s) : m_s(s), m_pos(0), m_depth(0) {}
+    bool parse(JsonValue& v)
+    {
+        if (!parseValue(v))
+            return false;
+        skipSpace();
+        return m_pos == m_s.size();
+    }
+private:
+    static const int MAX_DEPTH = 32;        // requests nest four deep; far more would only exhaust the stack
+
+    const string& m_s;
+    size_t m_pos;
+    int m_depth;
+
+    void skipSpace()
+    {
+        while (m_pos < m_s.size() && isspace(static_cast<unsigned char>(m_s[m_pos])))
+            m_pos++;
+    }
+    bool consume(char c)
+    {
+        skipSpace();
+        if (m_pos < m_s.size() && m_s[m_pos] == c)
+        {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+    bool parseValue(JsonValue& v)
+    {
+        skipSpace();
+        if (m_pos >= m_s.size())
+            return false;
+        char c = m_s[m_pos];
+        if ((c == '{' || c == '[') && m_depth == MAX_DEPTH)
+            return false;
+        if (c == '{')
+        {
+            v.type = JsonValue::OBJECT;
+            m_pos++;
+            if (consume('}'))
+                return true;
+            m_depth++;
+            do
+            {
+                string key;
+                skipSpace();
+                if (!parseString(key) || !consume(':'))
+                    return false;
+                v.members.push_back(make_pair(key, JsonValue()));
+                if (!parseValue(v.members.back().second))
+                    return false;
+            } while (consume(','));
+            m_depth--;
+            return consume('}');
+        }
+        if (c == '[')
+        {
+            v.type = JsonValue::ARRAY;
+            m_pos++;
+            if (consume(']'))
+                return true;
+            m_depth++;
+            do
+            {
+                v.elements.push_back(JsonValue());
+                if (!parseValue(v.elements.back()))
+                    return false;
+            } while (consume(','));
+            m_depth--;
+            return consume(']');
+        }
+        if (c == '"')
+        {
+            v.type = JsonValue::STRING;
+            return parseString(v.text);
+        }
+        size_t begin = m_pos;
+        while (m_pos < m_s.size() && (isalnum(static_cast<unsigned char>(m_s[m_pos])) || strchr("+-.", m_s[m_pos]) != nullptr))
+            m_pos++;
+        v.text = m_s.substr(begin, m_pos - begin);
+        if (v.text == "null")
+            v.type = JsonValue::NUL;
+        else if (v.text == "true" || v.text == "false")
+            v.type = JsonValue::BOOLEAN;
+        else if (isNumber(v.text))
+            v.type = JsonValue::NUMBER;
+        else
+            return false;
+        return true;
+    }
+      // -?digits[.digits][(e|E)[+|-]digits], so the text can be echoed as is
+    static bool isNumber(const string& t)
+    {
+        size_t i = 0;
+        auto digits = [&t, &i]
+        {
+            size_t begin = i;
+            while (i < t.size() && isdigit(static_cast<unsigned char>(t[i])))
+                i++;
+            return i > begin;
+        };
+        if (i < t.size() && t[i] == '-')
+            i++;
+        if (!digits())
+            return false;
+        if (i < t.size() && t[i] == '.')
+        {
+            i++;
+            if (!digits())
+                return false;
+        }
+        if (i < t.size() && (t[i] == 'e' || t[i] == 'E'))
+        {
+            i++;
+            if (i < t.size() && (t[i] == '+' || t[i] == '-'))
+                i++;
+            if (!digits())
+                return false;
+        }
+        return i == t.size();
+    }
+    bool parseString(string& out)
+    {
+        if (m_pos >= m_s.size() || m_s[m_pos] != '"')
+            return false;
+        m_pos++;
+        while (m_pos < m_s.size())
+        {
+            char c = m_s[m_pos++];
+            if (c == '"')
+                return true;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_s.size())
+                return false;
+            char e = m_s[m_pos++];
+            switch (e)
+            {
+              case 'n': out += '\n'; break;
+              case 't': out += '\t'; break;
+              case 'r': out += '\r'; break;
+              case 'b': out += '\b'; break;
+              case 'f': out += '\f'; break;
+              case 'u':
+                {
+                    if (m_pos + 4 > m_s.size())
+                        return false;
+                    unsigned int code = 0;
+                    for (int i = 0; i < 4; i++)
+                    {
+                        char h = m_s[m_pos++];
+                        if (!isxdigit(static_cast<unsigned char>(h)))
+                            return false;
+                        code = code * 16 + (isdigit(static_cast<unsigned char>(h)) ? h - '0' : (tolower(h) - 'a' + 10));
+                    }
+                    if (code < 0x80)
+                        out += static_cast<char>(code);
+                    else if (code < 0x800)
+                    {
+                        out += static_cast<char>(0xc0 | (code >> 6));
+                        out += static_cast<char>(0x80 | (code & 0x3f));
+                    }
+                    else
+                    {
+                        out += static_cast<char>(0xe0 | (code >> 12));
+                        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                        out += static_cast<char>(0x80 | (code & 0x3f));
+                    }
+                }
+                break;
+              default: out += e; break;
+            }
+        }
+        return false;
+    }
+};
+
+static bool jsonCoord(const JsonValue* v, GeoCoord& gc)
+{
+    if (v == nullptr || v->type != JsonValue::OBJECT)
+        return false;
+    const JsonValue* lat = v->member("lat");
+    const JsonValue* lon = v->member("lon");
+    if (lat == nullptr || lon == nullptr ||
+        (lat->type != JsonValue::STRING && lat->type != JsonValue::NUMBER) ||
+        (lon->type != JsonValue::STRING && lon->type != JsonValue::NUMBER))
+        return false;
+    try
+    {
+        gc = GeoCoord(lat->text, lon->text);
+    }
+    catch (const exception&)                // stod rejects non-numeric text
+    {
+        return false;
+    }
+    return true;
+}
+
+  // {"from":{...},"to":{...},"factor":1.5,"closed":true,"both_ways":false},
+  // everything after to optional
+static bool jsonEdgeUpdate(const JsonValue& v, EdgeUpdate& update)
+{
+    if (!jsonCoord(v.member("from"), update.from) || !jsonCoord(v.member("to"), update.to))
+        return false;
+    const JsonValue* factor = v.member("factor");
+    const JsonValue* closed = v.member("closed");
+    const JsonValue* bothWays = v.member("both_ways");
+    if ((factor != nullptr && factor->type != JsonValue::NUMBER) ||
+        (closed != nullptr && closed->type != JsonValue::BOOLEAN) ||
+        (bothWays != nullptr && bothWays->type != JsonValue::BOOLEAN))
+        return false;
+    if (factor != nullptr)
+        update.factor = atof(factor->text.c_str());
+    if (closed != nullptr)
+        update.closed = closed->text == "true";
+    if (bothWays != nullptr)
+        update.bothWays = bothWays->text == "true";
+    return true;
+}
+
+//******************** QueryServerImpl ****************************************
+
+class QueryServerImpl
+{
+public:
+    QueryServerImpl(VersionedStreetMap* maps, int numThreads);
+    ~QueryServerImpl();
+    void serve(istream& in, ostream& out);
+    bool serveSocket(const string& socketPath);
+      // the reply to one request line; never throws
+    string handleRequest(const string& line, double waitMs) const;
+private:
+    struct Job
+    {
+        string line;
+        chrono::steady_clock::time_point queued;
+        function<void(const string&)> reply;
+    };
+
+    VersionedStreetMap* m_maps;
+    vector<thread> m_workers;
+    deque<Job> m_jobs;
+    mutex m_jobsMutex;
+    condition_variable m_jobReady;
+    condition_variable m_jobsDone;
+    int m_busy;
+    bool m_stopping;
+    atomic<int> m_connections;              // socket clients being read from
+
+    void enqueue(const string& line, function<void(const string&)> reply);
+    void waitUntilIdle();
+    void workerLoop();
+    string answer(const string& line, double waitMs) const;
+};
+
+QueryServerImpl::QueryServerImpl(VersionedStreetMap* maps, int numThreads)
+ : m_maps(maps), m_busy(0), m_stopping(false), m_connections(0)
+{
+    if (numThreads < 1)
+        numThreads = 1;
+    for (int i = 0; i < numThreads; i++)
+        m_workers.push_back(thread(&QueryServerImpl::workerLoop, this));
+}
+
+QueryServerImpl::~QueryServerImpl()
+{
+    {
+        lock_guard<mutex> lock(m_jobsMutex);
+        m_stopping = true;
+    }
+    m_jobReady.notify_all();
+    for (size_t i = 0; i < m_workers.size(); i++)
+        m_workers[i].join();
+}
+
+void QueryServerImpl::enqueue(const string& line, function<void(const string&)> reply)
+{
+    Job job;
+    job.line = line;
+    job.queued = chrono::steady_clock::now();
+    job.reply = reply;
+    {
+        lock_guard<mutex> lock(m_jobsMutex);
+        m_jobs.push_back(job);
+    }
+    m_jobReady.notify_one();
+}
+
+void QueryServerImpl::waitUntilIdle()
+{
+    unique_lock<mutex> lock(m_jobsMutex);
+    m_jobsDone.wait(lock, [this] { return m_jobs.empty() && m_busy == 0; });
+}
+
+void QueryServerImpl::workerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            unique_lock<mutex> lock(m_jobsMutex);
+            m_jobReady.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())
+                return;                     // stopping and nothing left to do
+            job = m_jobs.front();
+            m_jobs.pop_front();
+            m_busy++;
+        }
+        double waitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - job.queued).count();
+        try
+        {
+            job.reply(handleRequest(job.line, waitMs));
+        }
+        catch (const exception& e)          // out of memory copying the reply, say
+        {
+            cerr << "Reply failed: " << e.what() << endl;
+        }
+        {
+            lock_guard<mutex> lock(m_jobsMutex);
+            m_busy--;
+        }
+        m_jobsDone.notify_all();
+    }
+}
+
+  // ,"result":...[,"miles":M,"points":N,"polyline":"..."]
+static void writeRouteGeometry(const StreetMap& map, const GeoCoord& from, const GeoCoord& to,
+                               double simplifyMiles, CommandWriter& writer)
+{
+    PointToPointRouter router(&map);
+    vector<GeoPoint> points;
+    double miles = 0;
+    DeliveryResult result = router.generateRouteGeometry(from, to, points, miles);
+    if (result != DELIVERY_SUCCESS)
+    {
+        writer.put(result == NO_ROUTE ? ",\"result\":\"no_route\"" : ",\"result\":\"bad_coord\"");
+        return;
+    }
+    if (simplifyMiles > 0)
+    {
+        vector<GeoPoint> simplified;
+        simplifyPolyline(points, simplifyMiles, simplified);
+        points.swap(simplified);
+    }
+    string polyline;
+    encodePolyline(points, polyline);
+    writer.put(",\"result\":\"success\",\"miles\":");
+    writer.putMiles(miles);
+    writer.put(",\"points\":");
+    writer.put(to_string(points.size()));
+    writer.put(",\"polyline\":");
+    writer.putJsonString(polyline);                                         // backslashes are legal polyline characters
+}
+
+  // Anything that escapes a request (a bad_alloc on a huge delivery list, a
+  // bug) is answered as an error rather than taking the worker down with it.
+string QueryServerImpl::handleRequest(const string& line, double waitMs) const
+{
+    try
+    {
+        return answer(line, waitMs);
+    }
+    catch (const exception& e)
+    {
+        ostringstream response;
+        CommandWriter writer(response, CommandWriter::JSON_LINES, 256);
+        writer.put("{\"id\":null,\"error\":");
+        writer.putJsonString(string("internal error: ") + e.what());
+        writer.put("}");
+        writer.flush();
+        return response.str();
+    }
+}
+
+string QueryServerImpl::answer(const string& line, double waitMs) const
+{
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    ostringstream response;
+    CommandWriter writer(response, CommandWriter::JSON_LINES, 4096);
+    JsonValue request;
+    JsonParser parser(line);
+    string id = "null";
+    string error;
+    GeoCoord depot;
+    vector<DeliveryRequest> deliveries;
+    GeoCoord routeStart;
+    GeoCoord routeEnd;
+    double simplifyMiles = 0;
+    vector<EdgeUpdate> updates;
+    const JsonValue* op = nullptr;
+    if (!parser.parse(request) || request.type != JsonValue::OBJECT)
+        error = "malformed JSON";
+    else
+    {
+        op = request.member("op");
+        const JsonValue* idValue = request.member("id");
+        if (idValue != nullptr && idValue->type == JsonValue::STRING)
+        {
+            ostringstream quoted;
+            CommandWriter quoter(quoted, CommandWriter::JSON_LINES, 256);
+            quoter.putJsonString(idValue->text);
+            quoter.flush();
+            id = quoted.str();
+        }
+        else if (idValue != nullptr && idValue->type != JsonValue::ARRAY && idValue->type != JsonValue::OBJECT)
+            id = idValue->text;                 // a number, true, false or null, as sent
+        const JsonValue* list = request.member("deliveries");
+        if (op != nullptr && op->text == "route")
+        {
+            const JsonValue* simplify = request.member("simplify_miles");
+            if (!jsonCoord(request.member("from"), routeStart) || !jsonCoord(request.member("to"), routeEnd))
+                error = "route needs from and to";
+            else if (simplify != nullptr && simplify->type != JsonValue::NUMBER)
+                error = "bad simplify_miles";
+            else if (simplify != nullptr)
+                simplifyMiles = atof(simplify->text.c_str());
+        }
+        else if (op != nullptr && op->text == "update")
+        {
+            const JsonValue* edges = request.member("edges");
+            if (edges == nullptr || edges->type != JsonValue::ARRAY)
+                error = "update needs edges";
+            for (size_t i = 0; error.empty() && i < edges->elements.size(); i++)
+            {
+                updates.push_back(EdgeUpdate());
+                if (!jsonEdgeUpdate(edges->elements[i], updates.back()))
+                    error = "bad edge " + to_string(i);
+            }
+        }
+        else if (op != nullptr)
+        {
+            const JsonValue* mapFile = request.member("map");
+            if (op->text != "reload")
+                error = "unknown op " + op->text;
+            else if (mapFile == nullptr || mapFile->type != JsonValue::STRING)
+                error = "reload needs a map file";
+        }
+        else if (!jsonCoord(request.member("depot"), depot))
+            error = "missing or bad depot";
+        else if (list == nullptr || list->type != JsonValue::ARRAY)
+            error = "missing deliveries";
+        else
+        {
+            for (size_t i = 0; i < list->elements.size() && error.empty(); i++)
+            {
+                GeoCoord location;
+                const JsonValue* item = list->elements[i].member("item");
+                if (!jsonCoord(&list->elements[i], location) || item == nullptr || item->type != JsonValue::STRING)
+                    error = "bad delivery " + to_string(i);
+                else
+                    deliveries.push_back(DeliveryRequest(item->text, location));
+            }
+        }
+    }
+
+    StreetMapSnapshot snapshot = m_maps->current();       // pinned for the whole request
+    writer.put("{\"id\":");
+    writer.put(id);
+    if (snapshot != nullptr)
+    {
+        writer.put(",\"map_version\":");
+        writer.put(to_string(snapshot->version));
+    }
+    if (!error.empty())
+    {
+        writer.put(",\"error\":");
+        writer.putJsonString(error);
+    }
+    else if (op != nullptr && op->text == "route")
+    {
+        if (snapshot == nullptr)
+            writer.put(",\"error\":\"no map loaded\"");
+        else
+            writeRouteGeometry(snapshot->map, routeStart, routeEnd, simplifyMiles, writer);
+    }
+    else if (op != nullptr && op->text == "update")
+    {
+        unsigned long version = m_maps->updateEdges(updates);
+        if (version == 0)
+            writer.put(snapshot == nullptr ? ",\"error\":\"no map loaded\"" : ",\"error\":\"edges not on the map\"");
+        else
+        {
+            writer.put(",\"result\":\"updated\",\"new_version\":");
+            writer.put(to_string(version));
+        }
+    }
+    else if (op != nullptr)
+    {
+        const string& mapFile = request.member("map")->text;
+        bool started = m_maps->reloadInBackground(mapFile, [mapFile](bool loaded)
+        {
+            if (!loaded)
+                cerr << "Reload of " << mapFile << " failed; keeping the current map" << endl;
+        });
+        writer.put(started ? ",\"result\":\"reloading\"" : ",\"error\":\"a reload is already in progress\"");
+    }
+    else if (snapshot == nullptr)
+        writer.put(",\"error\":\"no map loaded\"");
+    else
+    {
+        DeliveryPlanner planner(&snapshot->map);
+        CompactCommandList commands;
+        double totalMiles = 0;
+        DeliveryResult result = planner.generateDeliveryPlan(depot, deliveries, commands, totalMiles);
+        switch (result)
+        {
+          case DELIVERY_SUCCESS:
+            writer.put(",\"result\":\"success\",\"miles\":");
+            writer.putMiles(totalMiles);
+            writer.put(",\"commands\":");
+            writer.writeJsonArray(commands);
+            break;
+          case NO_ROUTE:
+            writer.put(",\"result\":\"no_route\"");
+            break;
+          case BAD_COORD:
+            writer.put(",\"result\":\"bad_coord\"");
+            break;
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    char timing[64];
+    snprintf(timing, sizeof(timing), ",\"wait_ms\":%.3f,\"ms\":%.3f}", waitMs, ms);
+    writer.put(timing);
+    writer.flush();
+    return response.str();
+}
+
+void QueryServerImpl::serve(istream& in, ostream& out)
+{
+    mutex outMutex;
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty())
+            continue;
+        enqueue(line, [&out, &outMutex](const string& response)
+        {
+            lock_guard<mutex> lock(outMutex);
+            out << response << '\n';
+            out.flush();
+        });
+    }
+    waitUntilIdle();
+}
+
+// Writes all of s to the socket fd, riding out partial writes; false if the
+// peer has gone (EPIPE comes back as an error instead of killing the process).
+static bool writeAll(int fd, const string& s)
+{
+    size_t sent = 0;
+    while (sent < s.size())
+    {
+        ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+namespace
+{
+    const size_t MAX_LINE_BYTES = 1 << 22;      // a request line longer than this closes the connection
+    const int MAX_CONNECTIONS = 256;            // clients read from at once; more are turned away
+
+      // A client connection; the socket closes once the reader and every
+      // outstanding reply have let go of it.
+    struct Connection
+    {
+        Connection(int f) : fd(f), gone(false) {}
+        ~Connection() { close(fd); }
+        int fd;
+        mutex writeMutex;
+        bool gone;                              // the client stopped listening; drop its replies
+
+          // writes one reply line unless the client is gone; on a failed
+          // write, marks it gone and stops the reader too
+        void reply(const string& response)
+        {
+            lock_guard<mutex> lock(writeMutex);
+            if (gone)
+                return;
+            if (!writeAll(fd, response + '\n'))
+            {
+                gone = true;
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+          // a last reply, after which the connection is dropped
+        void refuse(const string& response)
+        {
+            reply(response);
+            lock_guard<mutex> lock(writeMutex);
+            gone = true;
+            shutdown(fd, SHUT_RDWR);
+        }
+    };
+}
+
+bool QueryServerImpl::serveSocket(const string& socketPath)
+{
+    sockaddr_un addr;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+    {
+        cerr << "Socket path too long: " << socketPath << endl;
+        return false;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        cerr << "Cannot create socket: " << strerror(errno) << endl;
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath.c_str());
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))                                        // never delete a file given by mistake
+        {
+            cerr << "Cannot listen on " << socketPath << ": it exists and is not a socket" << endl;
+            close(listener);
+            return false;
+        }
+        unlink(socketPath.c_str());                                             // left over from an earlier server
+    }
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 64) < 0)
+    {
+        cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+        close(listener);
+        return false;
+    }
+    for (;;)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        shared_ptr<Connection> conn = make_shared<Connection>(fd);
+        if (m_connections.fetch_add(1) >= MAX_CONNECTIONS)
+        {
+            m_connections--;
+            conn->refuse("{\"id\":null,\"error\":\"too many connections\"}");
+            continue;
+        }
+        thread([this, conn]
+        {
+            string pending;
+            char buf[65536];
+            ssize_t n;
+            while ((n = read(conn->fd, buf, sizeof(buf))) > 0)
+            {
+                pending.append(buf, n);
+                size_t start = 0;
+                size_t newline;
+                while ((newline = pending.find('\n', start)) != string::npos)
+                {
+                    string line = pending.substr(start, newline - start);
+                    start = newline + 1;
+                    if (line.empty())
+                        continue;
+                    enqueue(line, [conn](const string& response)
+                    {
+                        conn->reply(response);
+                    });
+                }
+                pending.erase(0, start);
+                if (pending.size() > MAX_LINE_BYTES)
+                {
+                    conn->refuse("{\"id\":null,\"error\":\"request line too long\"}");
+                    break;
+                }
+            }
+            m_connections--;
+        }).detach();
+    }
+    close(listener);
+    return false;
+}
+
+//******************** runQueryClient *****************************************
+
+int runQueryClient(const string& socketPath)
+{
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || socketPath.size() >= sizeof(addr.sun_path))
+    {
+        cerr << "Cannot create socket for " << socketPath << endl;
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath.c_str());
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        cerr << "Cannot connect to " << socketPath << ": " << strerror(errno) << endl;
+        close(fd);
+        return 1;
+    }
+    thread sender([fd]
+    {
+        string line;
+        while (getline(cin, line))
+            if (!writeAll(fd, line + '\n'))
+                break;
+        shutdown(fd, SHUT_WR);              // tells the server no more requests are coming
+    });
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        cout.write(buf, n);
+    cout.flush();
+    sender.join();
+    close(fd);
+    return 0;
+}
+
+//******************** QueryServer functions **********************************
+
+// These functions simply delegate to QueryServerImpl's functions.
+
+QueryServer::QueryServer(VersionedStreetMap* maps, int numThreads)
+{
+    m_impl = new QueryServerImpl(maps, numThreads);
+}
+
+QueryServer::~QueryServer()
+{
+    delete m_impl;
+}
+
+void QueryServer::serve(istream& in, ostream& out)
+{
+    m_impl->serve(in, out);
+}
+
+bool QueryServer::serveSocket(const string& socketPath)
+{
+    return m_impl->serveSocket(socketPath);
+}
+
+string QueryServer::handleRequest(const string& line) const
+{
+    return m_impl->handleRequest(line, 0);
+}
@@ -0,0 +1,66 @@
+// QueryServer.h
+
+// Long-running server mode: the map is loaded once, then delivery-plan requests
+// arrive as JSON lines and are answered with one JSON line each.
+//
+// Request:  {"id":7,"depot":{"lat":"34.0625329","lon":"-118.4470263"},
+//            "deliveries":[{"lat":"34.0712323","lon":"-118.4505969","item":"Chicken tenders"}]}
+// Response: {"id":7,"map_version":1,"result":"success","miles":2.28,"commands":[...],"wait_ms":0.01,"ms":1.93}
+//
+// {"id":8,"op":"reload","map":"mapdata.txt"} loads a new map in the background;
+// requests keep using the version they started with until it is published.
+// While one reload is loading, another is answered with
+// "error":"a reload is already in progress".
+//
+// {"id":9,"op":"route","from":{...},"to":{...},"simplify_miles":0.002} answers
+// {"id":9,"map_version":1,"result":"success","miles":1.07,"points":23,"polyline":"..."}
+// with the route's geometry as an encoded polyline (Polyline.h), simplified to
+// within simplify_miles if that is given.
+//
+// {"id":10,"op":"update","edges":[{"from":{...},"to":{...},"closed":true}]}
+// closes or reweights streets ("factor":1.8 for traffic, "factor":1 to undo,
+// "both_ways":false for one direction) and answers
+// {"id":10,"map_version":1,"result":"updated","new_version":2}; requests
+// already running finish on the version they started with.
+//
+// Coordinates may be JSON strings or numbers; either way the text is kept exactly,
+// since map lookups compare coordinate text.
+//
+// On the socket, up to 256 clients are read from at once; the next ones get
+// {"id":null,"error":"too many connections"} and are closed.  A line longer
+// than 4 MB gets {"id":null,"error":"request line too long"} and closes its
+// connection.  A client that disconnects early just loses its remaining
+// replies; the server carries on.
+
+#ifndef QUERYSERVER_INCLUDED
+#define QUERYSERVER_INCLUDED
+
+#include "provided.h"
+#include "StreetMapVersions.h"
+#include <iostream>
+#include <string>
+
+class QueryServerImpl;
+
+class QueryServer
+{
+public:
+    QueryServer(VersionedStreetMap* maps, int numThreads);
+    ~QueryServer();
+      // answer every request line read from in until end of file
+    void serve(std::istream& in, std::ostream& out);
+      // accept connections on a Unix domain socket forever; false if it can't listen
+    bool serveSocket(const std::string& socketPath);
+      // one request line in, one response line (without the newline) out
+    std::string handleRequest(const std::string& line) const;
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+private:
+    QueryServerImpl* m_impl;
+};
+
+  // Stand-in client: sends stdin's lines to the server at socketPath and copies
+  // the responses to stdout.  Returns a process exit status.
+int runQueryClient(const std::string& socketPath);
+
+#endif // QUERYSERVER_INCLUDED
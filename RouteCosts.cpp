@@ -0,0 +1,179 @@
+#include "RouteCosts.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+using namespace std;
+
+namespace
+{
+    const char* const COST_NAMES[] = { "distance", "time", "custom" };
+
+    struct RoadWord
+    {
+        const char* word;               // lower case
+        RoadClass roadClass;
+    };
+
+    const RoadWord ROAD_WORDS[] =
+    {
+        { "freeway", FREEWAY }, { "fwy", FREEWAY }, { "interstate", FREEWAY }, { "expressway", FREEWAY },
+        { "highway", HIGHWAY }, { "hwy", HIGHWAY }, { "parkway", HIGHWAY }, { "pkwy", HIGHWAY },
+        { "boulevard", ARTERIAL }, { "blvd", ARTERIAL }, { "avenue", ARTERIAL }, { "ave", ARTERIAL }, { "av", ARTERIAL },
+        { "street", COLLECTOR }, { "st", COLLECTOR }, { "road", COLLECTOR }, { "rd", COLLECTOR }, { "way", COLLECTOR },
+        { "drive", LOCAL_ROAD }, { "dr", LOCAL_ROAD }, { "lane", LOCAL_ROAD }, { "place", LOCAL_ROAD },
+        { "court", LOCAL_ROAD }, { "circle", LOCAL_ROAD }, { "terrace", LOCAL_ROAD },
+    };
+
+    bool parseRates(const string& text, double rates[NUM_ROAD_CLASSES])
+    {
+        const char* p = text.c_str();
+        for (int c = 0; c < NUM_ROAD_CLASSES; c++)
+        {
+            if (c > 0 && *p++ != ',')
+                return false;
+            char* end;
+            rates[c] = strtod(p, &end);
+            if (end == p || !(rates[c] > 0 && isfinite(rates[c])))
+                return false;
+            p = end;
+        }
+        return *p == '\0';
+    }
+
+      // each rate in as few digits as read back exactly
+    string ratesText(const double rates[NUM_ROAD_CLASSES])
+    {
+        string text;
+        for (int c = 0; c < NUM_ROAD_CLASSES; c++)
+        {
+            char rate[32];
+            for (int digits = 6; digits <= 17; digits++)
+            {
+                snprintf(rate, sizeof(rate), "%.*g", digits, rates[c]);
+                if (strtod(rate, nullptr) == rates[c])
+                    break;
+            }
+            if (c > 0)
+                text += ',';
+            text += rate;
+        }
+        return text;
+    }
+}
+
+  // Words are read from the end, so a trailing "North" or "of the Stars" is
+  // passed over until a word that names a kind of road turns up.
+RoadClass roadClassOf(const string& streetName)
+{
+    size_t end = streetName.size();
+    while (end > 0)
+    {
+        size_t begin = end;
+        while (begin > 0 && isalpha(static_cast<unsigned char>(streetName[begin - 1])))
+            begin--;
+        if (begin < end)
+        {
+            string word = streetName.substr(begin, end - begin);
+            for (size_t i = 0; i < word.size(); i++)
+                word[i] = static_cast<char>(tolower(static_cast<unsigned char>(word[i])));
+            for (const RoadWord& w : ROAD_WORDS)
+                if (word == w.word)
+                    return w.roadClass;
+        }
+        end = begin;
+        while (end > 0 && !isalpha(static_cast<unsigned char>(streetName[end - 1])))
+            end--;
+    }
+    return LOCAL_ROAD;
+}
+
+bool parseRouteCost(const string& name, RouteCost& cost)
+{
+    for (int c = DISTANCE_COST; c <= CUSTOM_COST; c++)
+    {
+        if (name == COST_NAMES[c])
+        {
+            cost = static_cast<RouteCost>(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* routeCostName(RouteCost cost)
+{
+    return COST_NAMES[cost];
+}
+
+bool parseRoadSpeeds(const string& text, RoadSpeeds& speeds)
+{
+    RoadSpeeds parsed;
+    if (!parseRates(text, parsed.mph))
+        return false;
+    speeds = parsed;
+    return true;
+}
+
+bool parseRoadWeights(const string& text, RoadWeights& weights)
+{
+    RoadWeights parsed;
+    if (!parseRates(text, parsed.perMile))
+        return false;
+    weights = parsed;
+    return true;
+}
+
+string roadSpeedsText(const RoadSpeeds& speeds)
+{
+    return ratesText(speeds.mph);
+}
+
+string roadWeightsText(const RoadWeights& weights)
+{
+    return ratesText(weights.perMile);
+}
+
+RoadClassCost::RoadClassCost(RouteCost cost, const uint8_t* roadClasses)
+ : m_roadClasses(roadClasses)
+{
+    for (int c = 0; c < NUM_ROAD_CLASSES; c++)
+        m_rate[c] = cost == TRAVEL_TIME_COST ? 60 / roadSpeeds().mph[c] : customRoadWeights().perMile[c];
+}
+
+//******************** cost selection *****************************************
+
+static RouteCost s_routeCost = DISTANCE_COST;
+static RoadSpeeds s_roadSpeeds;
+static RoadWeights s_customRoadWeights;
+
+void setRouteCost(RouteCost cost)
+{
+    s_routeCost = cost;
+}
+
+RouteCost routeCost()
+{
+    return s_routeCost;
+}
+
+void setRoadSpeeds(const RoadSpeeds& speeds)
+{
+    s_roadSpeeds = speeds;
+}
+
+const RoadSpeeds& roadSpeeds()
+{
+    return s_roadSpeeds;
+}
+
+void setCustomRoadWeights(const RoadWeights& weights)
+{
+    s_customRoadWeights = weights;
+}
+
+const RoadWeights& customRoadWeights()
+{
+    return s_customRoadWeights;
+}
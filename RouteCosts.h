@@ -0,0 +1,96 @@
+// RouteCosts.h
+
+// What the router minimizes: road miles (the default), travel time in
+// minutes at a speed for each class of road, or custom per-mile weights by
+// class of road.  Road classes are inferred from street names, by the last
+// word of the name that says what kind of road it is ("San Diego Freeway",
+// "Avenue of the Stars"); a name with no such word is a local road.
+//
+// Costs are policies the searches and the hub-label build are compiled for,
+// so the relaxation loop calls cost(network, edge) inline, with no virtual
+// call and no test of which metric is in use.  DistanceCost is the edge's
+// length.  Travel time and custom weights are one policy, RoadClassCost, with
+// different rates: the edge's length times the rate for its street's class,
+// looked up through a table of classes by street name id that StreetMap
+// builds when it loads (StreetMap::roadClasses).  Costs other than distance
+// are keyed for the shortest-path queues exactly as miles are (RouteQueues.h).
+//
+// Routes, plans and hub labels are built for routeCost() as it is when they
+// are made, so it is set at startup, before the map is loaded.  Distances
+// reported are always road miles.
+
+#ifndef ROUTECOSTS_INCLUDED
+#define ROUTECOSTS_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+enum RoadClass : uint8_t { FREEWAY, HIGHWAY, ARTERIAL, COLLECTOR, LOCAL_ROAD, NUM_ROAD_CLASSES };
+
+RoadClass roadClassOf(const std::string& streetName);
+
+enum RouteCost { DISTANCE_COST, TRAVEL_TIME_COST, CUSTOM_COST };
+
+  // "distance", "time" or "custom"; returns false for anything else
+bool parseRouteCost(const std::string& name, RouteCost& cost);
+const char* routeCostName(RouteCost cost);
+  // the cost routes minimize from now on (DISTANCE_COST by default)
+void setRouteCost(RouteCost cost);
+RouteCost routeCost();
+
+  // by RoadClass
+struct RoadSpeeds
+{
+    double mph[NUM_ROAD_CLASSES] = { 60, 45, 35, 30, 25 };
+};
+
+struct RoadWeights
+{
+    double perMile[NUM_ROAD_CLASSES] = { 1, 1, 1, 1, 1 };
+};
+
+void setRoadSpeeds(const RoadSpeeds& speeds);
+const RoadSpeeds& roadSpeeds();
+void setCustomRoadWeights(const RoadWeights& weights);
+const RoadWeights& customRoadWeights();
+
+  // one positive number per class, freeway first, separated by commas
+  // ("60,45,35,30,25"); the parsers return false for anything else
+bool parseRoadSpeeds(const std::string& text, RoadSpeeds& speeds);
+bool parseRoadWeights(const std::string& text, RoadWeights& weights);
+std::string roadSpeedsText(const RoadSpeeds& speeds);
+std::string roadWeightsText(const RoadWeights& weights);
+
+  // miles
+struct DistanceCost
+{
+    template<typename Network>
+    double operator()(const Network& network, int edge) const { return network.length(edge); }
+      // the cost of driving miles more along edge's street (turn penalties)
+    template<typename Network>
+    double extra(const Network&, int, double miles) const { return miles; }
+};
+
+  // minutes for TRAVEL_TIME_COST, weighted miles for CUSTOM_COST
+class RoadClassCost
+{
+public:
+      // roadClasses is the class of each of the network's street name ids
+    RoadClassCost(RouteCost cost, const uint8_t* roadClasses);
+
+    template<typename Network>
+    double operator()(const Network& network, int edge) const
+    {
+        return network.length(edge) * m_rate[m_roadClasses[network.nameId(edge)]];
+    }
+    template<typename Network>
+    double extra(const Network& network, int edge, double miles) const
+    {
+        return miles * m_rate[m_roadClasses[network.nameId(edge)]];
+    }
+private:
+    const uint8_t* m_roadClasses;
+    double m_rate[NUM_ROAD_CLASSES];            // cost per mile
+};
+
+#endif // ROUTECOSTS_INCLUDED
@@ -0,0 +1,39 @@
+#include "RouteQueues.h"
+using namespace std;
+
+namespace
+{
+    const char* const QUEUE_NAMES[] = { "fifo", "heap", "radix", "buckets" };
+}
+
+bool parseRouteQueue(const string& name, RouteQueue& queue)
+{
+    for (int q = FIFO_QUEUE; q <= BUCKET_QUEUE; q++)
+    {
+        if (name == QUEUE_NAMES[q])
+        {
+            queue = static_cast<RouteQueue>(q);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* routeQueueName(RouteQueue queue)
+{
+    return QUEUE_NAMES[queue];
+}
+
+//******************** queue selection ****************************************
+
+static RouteQueue s_routeQueue = FIFO_QUEUE;
+
+void setRouteQueue(RouteQueue queue)
+{
+    s_routeQueue = queue;
+}
+
+RouteQueue routeQueue()
+{
+    return s_routeQueue;
+}
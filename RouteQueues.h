@@ -0,0 +1,264 @@
+// RouteQueues.h
+
+// Frontier queues for the router.  The default FIFO queue gives the router's
+// breadth-first search; the others order a shortest-path (Dijkstra) search by
+// road distance, kept as integer keys of KEYS_PER_MILE units so every queue
+// sees exactly the same priorities.  The search is a template over the queue,
+// so each one is compiled into its own inner loop; setRouteQueue picks which
+// one routes use at run time.
+//
+// Each queue offers
+//     void clear(int numNodes);
+//     bool empty() const;
+//     void push(int node, long long key);
+//     int pop(long long& key);            // a node with the least key
+// Keys pushed must never be less than the last key popped.  The heap lowers
+// the key of a node already queued; the radix heap and the bucket queue keep
+// every push, and the search skips the stale entries as they come out.
+
+#ifndef ROUTEQUEUES_INCLUDED
+#define ROUTEQUEUES_INCLUDED
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+enum RouteQueue { FIFO_QUEUE, HEAP_QUEUE, RADIX_QUEUE, BUCKET_QUEUE };
+
+  // "fifo", "heap", "radix" or "buckets"; returns false for anything else
+bool parseRouteQueue(const std::string& name, RouteQueue& queue);
+const char* routeQueueName(RouteQueue queue);
+  // the queue routes use from now on (FIFO_QUEUE by default)
+void setRouteQueue(RouteQueue queue);
+RouteQueue routeQueue();
+
+const double KEYS_PER_MILE = 100000;            // about 1.6 cm per unit
+
+inline long long milesToKey(double miles)
+{
+    return std::llround(miles * KEYS_PER_MILE);
+}
+
+  // A heap's index in m_heap of each node queued, or -1: an array over every
+  // node id.  Any type with the same clear, find and set will do.
+class NodePositions
+{
+public:
+    void clear(int numNodes)
+    {
+        if (static_cast<int>(m_at.size()) < numNodes)
+            m_at.resize(numNodes, -1);
+    }
+    int find(int node) const { return m_at[node]; }
+    void set(int node, int at) { m_at[node] = at; }
+private:
+    std::vector<int> m_at;
+};
+
+  // 4-ary min-heap with decrease-key through a position index by node; a
+  // constructor argument goes to the index
+template<typename Positions>
+class BasicQuaternaryHeap
+{
+public:
+    BasicQuaternaryHeap() {}
+    template<typename Arg>
+    explicit BasicQuaternaryHeap(Arg arg) : m_position(arg) {}
+    void clear(int numNodes)
+    {
+        for (size_t i = 0; i < m_heap.size(); i++)
+            m_position.set(m_heap[i].node, -1);
+        m_heap.clear();
+        m_position.clear(numNodes);
+    }
+    bool empty() const { return m_heap.empty(); }
+    void push(int node, long long key)
+    {
+        int at = m_position.find(node);
+        if (at < 0)
+        {
+            at = static_cast<int>(m_heap.size());
+            m_heap.push_back(Entry());
+        }
+        else if (key >= m_heap[at].key)
+            return;
+        siftUp(at, Entry{ key, node });
+    }
+    int pop(long long& key)
+    {
+        Entry top = m_heap[0];
+        m_position.set(top.node, -1);
+        Entry last = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty())
+            siftDown(0, last);
+        key = top.key;
+        return top.node;
+    }
+private:
+    struct Entry
+    {
+        long long key;
+        int node;
+    };
+    std::vector<Entry> m_heap;
+    Positions m_position;
+
+    void place(int at, const Entry& e)
+    {
+        m_heap[at] = e;
+        m_position.set(e.node, at);
+    }
+    void siftUp(int at, const Entry& e)
+    {
+        while (at > 0)
+        {
+            int parent = (at - 1) / 4;
+            if (m_heap[parent].key <= e.key)
+                break;
+            place(at, m_heap[parent]);
+            at = parent;
+        }
+        place(at, e);
+    }
+    void siftDown(int at, const Entry& e)
+    {
+        int size = static_cast<int>(m_heap.size());
+        for (;;)
+        {
+            int child = 4 * at + 1;
+            if (child >= size)
+                break;
+            int best = child;
+            for (int c = child + 1; c < child + 4 && c < size; c++)
+                if (m_heap[c].key < m_heap[best].key)
+                    best = c;
+            if (m_heap[best].key >= e.key)
+                break;
+            place(at, m_heap[best]);
+            at = best;
+        }
+        place(at, e);
+    }
+};
+
+typedef BasicQuaternaryHeap<NodePositions> QuaternaryHeap;
+
+  // Monotone radix heap: an entry lives in the bucket of the highest bit in
+  // which its key differs from the last key popped, so each entry moves down
+  // at most 64 times.
+class RadixHeap
+{
+public:
+    RadixHeap() : m_buckets(65), m_last(0), m_size(0) {}
+    void clear(int)
+    {
+        for (size_t b = 0; b < m_buckets.size(); b++)
+            m_buckets[b].clear();
+        m_last = 0;
+        m_size = 0;
+    }
+    bool empty() const { return m_size == 0; }
+    void push(int node, long long key)
+    {
+        m_buckets[bucketOf(key)].push_back(Entry{ key, node });
+        m_size++;
+    }
+    int pop(long long& key)
+    {
+        if (m_buckets[0].empty())
+        {
+            size_t b = 1;
+            while (m_buckets[b].empty())
+                b++;
+            std::vector<Entry>& from = m_buckets[b];
+            m_last = from[0].key;
+            for (size_t i = 1; i < from.size(); i++)
+                if (from[i].key < m_last)
+                    m_last = from[i].key;
+            for (size_t i = 0; i < from.size(); i++)                        // all land in lower buckets
+                m_buckets[bucketOf(from[i].key)].push_back(from[i]);
+            from.clear();
+        }
+        Entry e = m_buckets[0].back();
+        m_buckets[0].pop_back();
+        m_size--;
+        key = e.key;
+        return e.node;
+    }
+private:
+    struct Entry
+    {
+        long long key;
+        int node;
+    };
+    std::vector<std::vector<Entry> > m_buckets;
+    long long m_last;
+    size_t m_size;
+
+    int bucketOf(long long key) const
+    {
+        unsigned long long diff = static_cast<unsigned long long>(key ^ m_last);
+        return diff == 0 ? 0 : 64 - __builtin_clzll(diff);
+    }
+};
+
+  // Dial's bucket queue: one bucket per key in a circular array that covers
+  // every key between the last one popped and the largest one pushed, and
+  // doubles when a push falls outside it.
+class BucketQueue
+{
+public:
+    BucketQueue() : m_buckets(1024), m_current(0), m_size(0) {}
+    void clear(int)
+    {
+        if (m_size > 0)
+            for (size_t b = 0; b < m_buckets.size(); b++)
+                m_buckets[b].clear();
+        m_current = 0;
+        m_size = 0;
+    }
+    bool empty() const { return m_size == 0; }
+    void push(int node, long long key)
+    {
+        if (key - m_current >= static_cast<long long>(m_buckets.size()))
+            grow(key - m_current + 1);
+        m_buckets[key & (m_buckets.size() - 1)].push_back(Entry{ key, node });
+        m_size++;
+    }
+    int pop(long long& key)
+    {
+        size_t mask = m_buckets.size() - 1;
+        while (m_buckets[m_current & mask].empty())
+            m_current++;
+        std::vector<Entry>& bucket = m_buckets[m_current & mask];
+        Entry e = bucket.back();
+        bucket.pop_back();
+        m_size--;
+        key = e.key;
+        return e.node;
+    }
+private:
+    struct Entry
+    {
+        long long key;
+        int node;
+    };
+    std::vector<std::vector<Entry> > m_buckets;   // a power of two of them
+    long long m_current;
+    size_t m_size;
+
+    void grow(long long span)
+    {
+        size_t size = m_buckets.size();
+        while (static_cast<long long>(size) < span)
+            size *= 2;
+        std::vector<std::vector<Entry> > buckets(size);
+        for (size_t b = 0; b < m_buckets.size(); b++)
+            for (size_t i = 0; i < m_buckets[b].size(); i++)
+                buckets[m_buckets[b][i].key & (size - 1)].push_back(m_buckets[b][i]);
+        m_buckets.swap(buckets);
+    }
+};
+
+#endif // ROUTEQUEUES_INCLUDED
@@ -0,0 +1,201 @@
+#include "ServiceArea.h"
+#include "CompactGraph.h"
+#include "EdgeWeights.h"
+#include "RouteQueues.h"
+#include "Stats.h"
+#include "StreetGraph.h"
+#include "TiledMap.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+using namespace std;
+
+namespace
+{
+      // Per-thread sweep state over every node id, valid for the current
+      // sweep only where the stamp matches, as in the router.
+    struct SweepMarks
+    {
+        vector<unsigned int> stamp;
+        vector<double> miles;
+        vector<unsigned char> settled;
+        unsigned int current = 0;
+
+        void begin(int numNodes)
+        {
+            if (static_cast<int>(stamp.size()) < numNodes)
+            {
+                stamp.resize(numNodes, 0);
+                miles.resize(numNodes);
+                settled.resize(numNodes);
+            }
+            if (++current == 0)
+            {
+                fill(stamp.begin(), stamp.end(), 0);
+                current = 1;
+            }
+        }
+        bool reached(int node) const { return stamp[node] == current; }
+        void reach(int node, double m)
+        {
+            stamp[node] = current;
+            miles[node] = m;
+            settled[node] = 0;
+        }
+    };
+
+    thread_local SweepMarks t_sweep;
+    thread_local QuaternaryHeap t_sweepHeap;
+}
+
+ServiceArea::ServiceArea()
+ : m_budget(0)
+{
+}
+
+  // Dijkstra's search from the depot that settles nodes until the nearest
+  // one left is over budget.  The frontier is every edge from a settled node
+  // to one that is not.
+template<typename Network>
+void ServiceArea::sweep(const Network& network, int depotNode)
+{
+    SweepMarks& marks = t_sweep;
+    QuaternaryHeap& frontier = t_sweepHeap;
+    marks.begin(network.numNodes());
+    frontier.clear(network.numNodes());
+    marks.reach(depotNode, 0);
+    frontier.push(depotNode, 0);
+    long long budgetKey = milesToKey(m_budget);
+    while (!frontier.empty())
+    {
+        long long key;
+        int node = frontier.pop(key);
+        if (key > budgetKey)
+            break;
+        marks.settled[node] = 1;
+        m_nodes.push_back(node);
+        m_miles.push_back(marks.miles[node]);
+        STATS_ADD(nodesSettled, 1);
+        int last = network.endEdge(node);
+        STATS_ADD(edgesRelaxed, last - network.firstEdge(node));
+        for (int e = network.firstEdge(node); e < last; e++)
+        {
+            if (!network.open(e))
+                continue;
+            int next = network.target(e);
+            double nextMiles = marks.miles[node] + network.length(e);
+            if (marks.reached(next) && (marks.settled[next] || nextMiles >= marks.miles[next]))
+                continue;
+            marks.reach(next, nextMiles);
+            frontier.push(next, milesToKey(nextMiles));
+        }
+    }
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        int node = m_nodes[i];
+        for (int e = network.firstEdge(node), last = network.endEdge(node); e < last; e++)
+        {
+            int next = network.target(e);
+            if (network.open(e) && (!marks.reached(next) || !marks.settled[next]))
+                m_frontier.push_back(FrontierEdge{ node, next, m_budget - m_miles[i] });
+        }
+    }
+    m_byNode.reserve(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); i++)
+        m_byNode.push_back(make_pair(m_nodes[i], m_miles[i]));
+    sort(m_byNode.begin(), m_byNode.end());
+}
+
+DeliveryResult ServiceArea::compute(const StreetMap& map, const GeoCoord& depot, double budgetMiles)
+{
+    m_budget = budgetMiles;
+    m_nodes.clear();
+    m_miles.clear();
+    m_byNode.clear();
+    m_frontier.clear();
+    int depotNode = map.intersectionId(depot);
+    if (depotNode == -1)
+        return BAD_COORD;
+    const EdgeWeights* weights = map.edgeWeights();
+    if (map.tiles() != nullptr)
+        sweep(TiledMap::Cursor(*map.tiles()), depotNode);
+    else if (map.compactGraph() != nullptr)
+    {
+        CompactGraph::Cursor cursor(*map.compactGraph());
+        if (weights != nullptr)
+            sweep(WeightedNetwork<CompactGraph::Cursor>(cursor, *weights), depotNode);
+        else
+            sweep(cursor, depotNode);
+    }
+    else if (weights != nullptr)
+        sweep(WeightedNetwork<StreetGraph>(map.graph(), *weights), depotNode);
+    else
+        sweep(map.graph(), depotNode);
+    return DELIVERY_SUCCESS;
+}
+
+double ServiceArea::milesTo(int node) const
+{
+    vector<pair<int, double> >::const_iterator it = lower_bound(m_byNode.begin(), m_byNode.end(), make_pair(node, -1.0));
+    if (it == m_byNode.end() || it->first != node)
+        return -1;
+    return it->second;
+}
+
+  // Threads take depots from a shared counter; the first exception is
+  // rethrown once every thread has finished.
+DeliveryResult computeServiceAreas(const StreetMap& map, const vector<GeoCoord>& depots, double budgetMiles,
+                                   vector<ServiceArea>& areas, int numThreads)
+{
+    areas.assign(depots.size(), ServiceArea());
+    if (numThreads <= 0)
+        numThreads = max(1u, thread::hardware_concurrency());
+    numThreads = min(numThreads, static_cast<int>(depots.size()));
+    atomic<size_t> nextDepot(0);
+    atomic<bool> badCoord(false);
+    exception_ptr failure;
+    atomic_flag failed = ATOMIC_FLAG_INIT;
+    auto run = [&]()
+    {
+        try
+        {
+            for (size_t i = nextDepot++; i < depots.size(); i = nextDepot++)
+                if (areas[i].compute(map, depots[i], budgetMiles) != DELIVERY_SUCCESS)
+                    badCoord = true;
+        }
+        catch (...)
+        {
+            if (!failed.test_and_set())
+                failure = current_exception();
+        }
+    };
+    vector<thread> threads;
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back(thread(run));
+    run();                                                                  // this thread takes a share too
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    if (failure)
+        rethrow_exception(failure);
+    return badCoord ? BAD_COORD : DELIVERY_SUCCESS;
+}
+
+int nearestDepot(const StreetMap& map, const vector<ServiceArea>& areas, const GeoCoord& gc, double& miles)
+{
+    int node = map.intersectionId(gc);
+    int best = -1;
+    miles = -1;
+    if (node == -1)
+        return -1;
+    for (size_t i = 0; i < areas.size(); i++)
+    {
+        double m = areas[i].milesTo(node);
+        if (m >= 0 && (best == -1 || m < miles))
+        {
+            best = static_cast<int>(i);
+            miles = m;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,64 @@
+// ServiceArea.h
+
+// Service areas (isochrones): every intersection within a road-distance
+// budget of a depot, found by one Dijkstra sweep that stops at the budget,
+// instead of one point-to-point query per intersection.  The sweep runs over
+// whichever form the map is in, with its edge updates (EdgeWeights.h), so
+// closed streets are not crossed and miles are costs while any are in effect.
+//
+// computeServiceAreas sweeps from many depots at once, one depot per thread
+// at a time, and nearestDepot then answers which depot reaches a delivery
+// soonest from the areas alone, so stops can be split among depots before
+// each depot's order is optimized.
+
+#ifndef SERVICEAREA_INCLUDED
+#define SERVICEAREA_INCLUDED
+
+#include "provided.h"
+#include <utility>
+#include <vector>
+
+class ServiceArea
+{
+public:
+      // a street leaving the area: from is inside, to is beyond the budget,
+      // and the budget runs out milesLeft along it
+    struct FrontierEdge
+    {
+        int from;
+        int to;
+        double milesLeft;
+    };
+
+    ServiceArea();
+      // the intersections within budgetMiles of depot by road; BAD_COORD if
+      // depot is not an intersection
+    DeliveryResult compute(const StreetMap& map, const GeoCoord& depot, double budgetMiles);
+
+    double budget() const { return m_budget; }
+      // reached intersections (StreetMap ids), nearest first, and their miles
+    int size() const { return static_cast<int>(m_nodes.size()); }
+    int node(int i) const { return m_nodes[i]; }
+    double miles(int i) const { return m_miles[i]; }
+      // road miles from the depot to an intersection, or -1 if it is outside
+    double milesTo(int node) const;
+    const std::vector<FrontierEdge>& frontier() const { return m_frontier; }
+private:
+    double m_budget;
+    std::vector<int> m_nodes;
+    std::vector<double> m_miles;
+    std::vector<std::pair<int, double> > m_byNode;      // (node, miles), sorted by node
+    std::vector<FrontierEdge> m_frontier;
+
+    template<typename Network>
+    void sweep(const Network& network, int depotNode);
+};
+
+  // areas[i] is depots[i]'s area; the sweeps run on up to numThreads threads
+  // (0: one per core).  BAD_COORD if any depot is not an intersection.
+DeliveryResult computeServiceAreas(const StreetMap& map, const std::vector<GeoCoord>& depots, double budgetMiles,
+                                   std::vector<ServiceArea>& areas, int numThreads = 0);
+  // index of the area that reaches gc in the fewest miles, or -1 if none does
+int nearestDepot(const StreetMap& map, const std::vector<ServiceArea>& areas, const GeoCoord& gc, double& miles);
+
+#endif // SERVICEAREA_INCLUDED
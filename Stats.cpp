@@ -0,0 +1,97 @@
+#include "Stats.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+using namespace std;
+
+static thread_local PlanStats t_stats;      // zero-initialized per thread
+
+PlanStats& threadStats()
+{
+    return t_stats;
+}
+
+void resetThreadStats()
+{
+    t_stats = PlanStats();
+}
+
+bool statsEnabled()
+{
+#ifdef DELIVERY_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PlanStats::print(ostream& out) const
+{
+    char line[160];
+    out << "Stats:\n";
+    snprintf(line, sizeof(line), "  load            %10.3f ms   map %.2f MB (coordinate index %.2f MB)\n",
+             loadMs, mapBytes / 1048576.0, mapIndexBytes / 1048576.0);
+    out << line;
+    snprintf(line, sizeof(line), "  plan            %10.3f ms\n", planMs);
+    out << line;
+    snprintf(line, sizeof(line), "    optimize      %10.3f ms\n", optimizeMs);
+    out << line;
+    snprintf(line, sizeof(line), "    route         %10.3f ms   %ld queries, %ld nodes settled, %ld edges relaxed\n",
+             routeMs, routeQueries, nodesSettled, edgesRelaxed);
+    out << line;
+    if (tilesLoaded > 0)
+    {
+        snprintf(line, sizeof(line), "      tiles                      %ld decoded\n", tilesLoaded);
+        out << line;
+    }
+    snprintf(line, sizeof(line), "    commands      %10.3f ms\n", commandsMs);
+    out << line;
+    snprintf(line, sizeof(line), "  hash map        %ld finds, %.2f probes/find (longest %ld), %ld inserts, %ld resizes\n",
+             hashFinds, hashFinds > 0 ? static_cast<double>(hashProbes) / hashFinds : 0.0, hashMaxProbe, hashInserts, hashResizes);
+    out << line;
+    snprintf(line, sizeof(line), "  heap            %ld allocations, %.2f MB; arena %.2f MB\n",
+             allocations, allocatedBytes / 1048576.0, arenaBytes / 1048576.0);
+    out << line;
+}
+
+#ifdef DELIVERY_STATS
+
+// Counting replacements for the global allocation functions.
+
+void* operator new(size_t size)
+{
+    t_stats.allocations++;
+    t_stats.allocatedBytes += size;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+#endif // DELIVERY_STATS
@@ -0,0 +1,89 @@
+// Stats.h
+
+// Opt-in hot-path instrumentation.  Counters and phase timers are kept per
+// thread in a PlanStats.  The STATS_* macros that feed them compile to nothing
+// unless the build defines DELIVERY_STATS (e.g. g++ -DDELIVERY_STATS ...), so
+// the normal build pays nothing for them.
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+#include <chrono>
+#include <iostream>
+
+struct PlanStats
+{
+      // wall time per phase, in milliseconds
+    double loadMs;
+    double planMs;
+    double optimizeMs;
+    double routeMs;
+    double commandsMs;
+
+      // point-to-point searches
+    long routeQueries;
+    long nodesSettled;
+    long edgesRelaxed;
+    long tilesLoaded;           // tiles decoded from a tile file, reloads included
+
+      // ExpandableHashMap
+    long hashFinds;
+    long hashProbes;            // chain nodes compared, over all finds
+    long hashMaxProbe;          // longest single find
+    long hashInserts;
+    long hashResizes;
+
+      // heap, counted by the replacement operator new
+    long allocations;
+    long allocatedBytes;
+    long arenaBytes;            // largest block memory held by the thread's arena
+
+      // memory footprint of the structures built by the last load
+    long mapBytes;
+    long mapIndexBytes;         // the coordinate hash table within mapBytes
+
+    void print(std::ostream& out) const;
+};
+
+  // true when this build was compiled with DELIVERY_STATS
+bool statsEnabled();
+
+  // the calling thread's counters
+PlanStats& threadStats();
+void resetThreadStats();
+
+#ifdef DELIVERY_STATS
+
+  // adds the time from construction to destruction to a PlanStats field
+class StatsTimer
+{
+public:
+    StatsTimer(double PlanStats::* field)
+     : m_field(field), m_begin(std::chrono::steady_clock::now())
+    {}
+    ~StatsTimer()
+    {
+        threadStats().*m_field += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_begin).count();
+    }
+private:
+    double PlanStats::* m_field;
+    std::chrono::steady_clock::time_point m_begin;
+};
+
+#define STATS_CONCAT2(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT2(a, b)
+#define STATS_ADD(field, n)   (threadStats().field += (n))
+#define STATS_MAX(field, n)   do { long v_ = (n); if (v_ > threadStats().field) threadStats().field = v_; } while (0)
+#define STATS_SET(field, n)   (threadStats().field = (n))
+#define STATS_TIMER(field)    StatsTimer STATS_CONCAT(statsTimer_, __LINE__)(&PlanStats::field)
+
+#else
+
+#define STATS_ADD(field, n)   ((void)0)
+#define STATS_MAX(field, n)   ((void)0)
+#define STATS_SET(field, n)   ((void)0)
+#define STATS_TIMER(field)    ((void)0)
+
+#endif // DELIVERY_STATS
+
+#endif // STATS_INCLUDED
@@ -0,0 +1,43 @@
+#include "StreetGraph.h"
+using namespace std;
+
+StreetGraph::StreetGraph()
+ : m_firstEdge(1, 0)
+{
+}
+
+int StreetGraph::nodeAt(const GeoCoord& gc) const
+{
+    const int* node = m_index.findWhenQuiet(gc);
+    return node == nullptr ? -1 : *node;
+}
+
+StreetSegment StreetGraph::segment(int node, int edge) const
+{
+    return StreetSegment(m_coords[node], m_coords[m_target[edge]], name(edge), m_nameId[edge]);
+}
+
+long StreetGraph::memoryUsage() const
+{
+    long bytes = m_index.memoryUsage();
+    bytes += m_coords.capacity() * sizeof(GeoCoord);
+    bytes += (m_component.capacity() + m_firstEdge.capacity() + m_target.capacity() + m_nameId.capacity()) * sizeof(int);
+    bytes += m_length.capacity() * sizeof(double);
+    bytes += m_names.capacity() * sizeof(string);
+    for (size_t i = 0; i < m_names.size(); i++)
+        if (m_names[i].capacity() >= sizeof(string))                // spilled out of the small-string buffer
+            bytes += m_names[i].capacity() + 1;
+    return bytes;
+}
+
+void StreetGraph::clear()
+{
+    m_index.reset();
+    vector<GeoCoord>().swap(m_coords);
+    vector<int>().swap(m_component);
+    vector<int>(1, 0).swap(m_firstEdge);
+    vector<int>().swap(m_target);
+    vector<double>().swap(m_length);
+    vector<int>().swap(m_nameId);
+    vector<string>().swap(m_names);
+}
@@ -0,0 +1,68 @@
+// StreetGraph.h
+
+// The street network as a compact graph over integer node ids, built by
+// StreetMap::load and shared read-only by every search.
+//
+// Nodes are intersections, numbered along a Hilbert curve over the map's
+// bounding box so that intersections close on the ground are close in memory.
+// Edges are stored in compressed sparse row form: the edges leaving node n are
+// firstEdge(n) .. endEdge(n)-1, in the order the map file lists them, and each
+// street segment appears once in each direction.
+
+#ifndef STREETGRAPH_INCLUDED
+#define STREETGRAPH_INCLUDED
+
+#include "provided.h"
+#include "ConcurrentHashMap.h"
+#include "FlatEarth.h"
+#include <string>
+#include <vector>
+
+class StreetGraph
+{
+public:
+    StreetGraph();
+    int numNodes() const { return static_cast<int>(m_coords.size()); }
+    int numEdges() const { return static_cast<int>(m_target.size()); }
+
+      // node at the intersection gc, or -1 if gc is not an intersection
+    int nodeAt(const GeoCoord& gc) const;
+    const GeoCoord& coord(int node) const { return m_coords[node]; }
+    GeoPoint point(int node) const { return GeoPoint{ m_coords[node].latitude, m_coords[node].longitude }; }
+    double milesTo(int node, const GeoCoord& gc) const { return distanceEarthMiles(m_coords[node], gc); }
+    double milesTo(int node, const GeoCoord& gc, const FlatEarth& flat) const { return flat.miles(m_coords[node], gc); }
+    int component(int node) const { return m_component[node]; }
+
+    int firstEdge(int node) const { return m_firstEdge[node]; }
+    int endEdge(int node) const { return m_firstEdge[node + 1]; }
+    int target(int edge) const { return m_target[edge]; }
+    double length(int edge) const { return m_length[edge]; }           // miles
+    bool open(int) const { return true; }                               // closures are EdgeWeights'
+    const std::string& name(int edge) const { return m_names[m_nameId[edge]]; }
+    int nameId(int edge) const { return m_nameId[edge]; }
+    int numNames() const { return static_cast<int>(m_names.size()); }
+    const std::string& nameOf(int nameId) const { return m_names[nameId]; }
+
+      // the StreetSegment for an edge leaving node
+    StreetSegment segment(int node, int edge) const;
+
+    long memoryUsage() const;
+      // back to an empty graph, giving the memory back
+    void clear();
+
+    StreetGraph(const StreetGraph&) = delete;
+    StreetGraph& operator=(const StreetGraph&) = delete;
+private:
+    friend class StreetMapImpl;
+
+    ConcurrentHashMap<GeoCoord, int> m_index;   // node of each intersection
+    std::vector<GeoCoord> m_coords;             // location of each node
+    std::vector<int> m_component;               // connected component of each node
+    std::vector<int> m_firstEdge;               // numNodes()+1 offsets into the edge arrays
+    std::vector<int> m_target;
+    std::vector<double> m_length;
+    std::vector<int> m_nameId;                  // index into m_names
+    std::vector<std::string> m_names;           // each distinct street name once
+};
+
+#endif // STREETGRAPH_INCLUDED
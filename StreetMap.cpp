@@ -1,15 +1,39 @@
 #include "provided.h"
-#include "ExpandableHashMap.h"
+#include "CompactGraph.h"
+#include "EdgeWeights.h"
+#include "HubLabels.h"
+#include "RouteCosts.h"
+#include "StreetGraph.h"
+#include "TiledMap.h"
+#include "TurnGraph.h"
+#include "Stats.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <functional>
 using namespace std;
 
 unsigned int hasher(const GeoCoord& g)
 {
-    return std::hash<string>()(g.latitudeText + g.longitudeText);
+    size_t h = std::hash<string>()(g.latitudeText);                            // combined without building a joined string
+    h ^= std::hash<string>()(g.longitudeText) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return static_cast<unsigned int>(h);
+}
+
+unsigned int hasher(int i)
+{
+    unsigned int h = static_cast<unsigned int>(i);                          // integer finalizer, so sequential ids spread out
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    return h;
 }
 
 unsigned int hasher(const string &testString)
@@ -25,11 +49,132 @@ public:
     ~StreetMapImpl();
     bool load(string mapFile);
     bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+    int componentOf(const GeoCoord& gc) const;
+    int numIntersections() const;
+    GeoCoord intersection(int id) const;
+    int intersectionId(const GeoCoord& gc) const;
+    const StreetGraph& graph() const { return m_graph; }
+    const TiledMap* tiles() const { return m_tiles.get(); }
+    const CompactGraph* compactGraph() const { return m_compact.get(); }
+    const HubLabels* hubLabels() const { return m_labels.get(); }
+    const TurnGraph* turnGraph() const { return m_turns.get(); }
+    const uint8_t* roadClasses() const { return m_roadClasses.data(); }
 private:
-    StreetSegment reverse(StreetSegment oldSegment);
-    ExpandableHashMap<GeoCoord, vector<StreetSegment> > streetMap;
+    struct Street
+    {
+        size_t nameLine;            // index into the file's lines; the segments follow the count line
+        int numSegments;
+    };
+    struct Chunk                    // a run of streets parsed by one thread
+    {
+        int firstStreet;
+        int endStreet;
+        vector<int> endpoints;                  // nodes of each segment's start and end
+        vector<pair<int, GeoCoord> > newCoords; // coordinates this chunk interned, by provisional node
+    };
+    void parseChunk(const string& text, const vector<size_t>& lineStarts, const vector<Street>& streets, Chunk& chunk, atomic<int>& numIds);
+    int findRoot(int id);
+    StreetGraph m_graph;
+    unique_ptr<TiledMap> m_tiles;   // instead of m_graph when the file is a tile file
+    unique_ptr<CompactGraph> m_compact; // instead of m_graph when compactMaps() is on
+    unique_ptr<HubLabels> m_labels;     // when hubLabelMaps() is on
+    unique_ptr<TurnGraph> m_turns;      // when turnCostMaps() is on
+    vector<uint8_t> m_roadClasses;      // by street name id of whichever form is kept
+    vector<int> m_parent;           // union-find over nodes while loading
 };
 
+  // Runs work(0) .. work(numThreads-1) on that many threads and rethrows the
+  // first exception any of them raised.
+static void runInParallel(int numThreads, const function<void(int)>& work)
+{
+    vector<thread> threads;
+    vector<exception_ptr> errors(numThreads);
+    for (int t = 0; t < numThreads; t++)
+    {
+        auto run = [&work, &errors, t]()
+        {
+            try
+            {
+                work(t);
+            }
+            catch (...)
+            {
+                errors[t] = current_exception();
+            }
+        };
+        if (t + 1 < numThreads)
+            threads.push_back(thread(run));
+        else
+            run();                                                              // the last share runs on this thread
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    for (int t = 0; t < numThreads; t++)
+        if (errors[t])
+            rethrow_exception(errors[t]);
+}
+
+  // the class of every street name a network's edges use
+template<typename Names>
+static void classifyRoads(const Names& names, vector<uint8_t>& roadClasses)
+{
+    roadClasses.resize(names.numNames());
+    for (int id = 0; id < names.numNames(); id++)
+        roadClasses[id] = roadClassOf(names.nameOf(id));
+}
+
+  // distance of (x, y) along the Hilbert curve filling a 2^16 x 2^16 grid
+static unsigned long long hilbertIndex(unsigned int x, unsigned int y)
+{
+    const unsigned int n = 1u << 16;
+    unsigned long long d = 0;
+    for (unsigned int s = n / 2; s > 0; s /= 2)
+    {
+        unsigned int rx = (x & s) ? 1 : 0;
+        unsigned int ry = (y & s) ? 1 : 0;
+        d += static_cast<unsigned long long>(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0)                                                            // rotate the quadrant
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return d;
+}
+
+  // Order in which to number intersections: by position along a Hilbert curve
+  // over the bounding box, ties kept in the given order.
+static vector<int> hilbertOrder(const vector<const GeoCoord*>& coords)
+{
+    double minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+    for (size_t i = 0; i < coords.size(); i++)
+    {
+        if (i == 0 || coords[i]->latitude < minLat)
+            minLat = coords[i]->latitude;
+        if (i == 0 || coords[i]->latitude > maxLat)
+            maxLat = coords[i]->latitude;
+        if (i == 0 || coords[i]->longitude < minLon)
+            minLon = coords[i]->longitude;
+        if (i == 0 || coords[i]->longitude > maxLon)
+            maxLon = coords[i]->longitude;
+    }
+    double latScale = maxLat > minLat ? 65535 / (maxLat - minLat) : 0;
+    double lonScale = maxLon > minLon ? 65535 / (maxLon - minLon) : 0;
+    vector<unsigned long long> keys(coords.size());
+    for (size_t i = 0; i < coords.size(); i++)
+        keys[i] = hilbertIndex(static_cast<unsigned int>((coords[i]->longitude - minLon) * lonScale),
+                               static_cast<unsigned int>((coords[i]->latitude - minLat) * latScale));
+    vector<int> order(coords.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<int>(i);
+    stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
 StreetMapImpl::StreetMapImpl()
 {
 }
@@ -38,70 +183,339 @@ StreetMapImpl::~StreetMapImpl()
 {
 }
 
+  // Loading runs in passes.  Streets are located serially (just line scanning),
+  // then parsed on several threads, which intern coordinates in the concurrent
+  // index under provisional node numbers.  Serial passes over the numbers alone
+  // give every intersection its node id along the Hilbert curve and join the
+  // components, and finally each thread fills in the edges of the nodes it
+  // owns, in file order.
 bool StreetMapImpl::load(string mapFile)
 {
-    ifstream infile(mapFile);
+    STATS_TIMER(loadMs);
+    m_graph.clear();                                                            // nothing of a previous load survives
+    m_tiles.reset();
+    m_compact.reset();
+    m_labels.reset();
+    m_turns.reset();
+    m_roadClasses.clear();
+    if (TiledMap::isTileFile(mapFile))                                          // tiles are read as searches reach them
+    {
+        m_tiles.reset(new TiledMap);
+        if (!m_tiles->open(mapFile, defaultTileCache()))
+        {
+            m_tiles.reset();
+            cerr << "Error: Cannot read tile file " << mapFile << endl;
+            return false;
+        }
+        classifyRoads(*m_tiles, m_roadClasses);
+        return true;
+    }
+    ifstream infile(mapFile, ios::binary);
     
-    string s;
     if ( ! infile )                // Did opening the file fail?
     {
         cerr << "Error: Cannot open data.txt!" << endl;
         return false;
     }
-    while (getline(infile, s))
+    string text((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+    vector<size_t> lineStarts;
+    for (size_t pos = 0; pos < text.size(); )
+    {
+        lineStarts.push_back(pos);
+        size_t newline = text.find('\n', pos);
+        pos = (newline == string::npos) ? text.size() : newline + 1;
+    }
+    size_t numLines = lineStarts.size();
+    lineStarts.push_back(text.size());                                          // so line i ends at lineStarts[i+1]
+    auto lineEnd = [&](size_t i) { return (i + 1 < numLines || text.back() == '\n') ? lineStarts[i + 1] - 1 : text.size(); };
+
+    vector<Street> streets;
+    long numSegments = 0;
+    for (size_t i = 0; i < numLines; )
+    {
+        size_t end = lineEnd(i);
+        if (end > lineStarts[i] && isalpha(text[end - 1]) && i + 1 < numLines)
+        {
+            Street street;
+            street.nameLine = i;
+            street.numSegments = stoi(text.substr(lineStarts[i + 1], lineEnd(i + 1) - lineStarts[i + 1]));
+            street.numSegments = static_cast<int>(min<size_t>(street.numSegments, numLines - i - 2));
+            streets.push_back(street);
+            numSegments += street.numSegments;
+            i += 2 + street.numSegments;
+        }
+        else
+            i++;
+    }
+
+    int numThreads = static_cast<int>(min<long>(max(1u, thread::hardware_concurrency()), numSegments / 20000 + 1));
+    vector<Chunk> chunks(numThreads);
+    long perChunk = numSegments / numThreads + 1;
+    int street = 0;
+    for (int c = 0; c < numThreads; c++)                                        // about the same number of segments each
     {
-        if (isalpha(s[s.size()-1]))
+        chunks[c].firstStreet = street;
+        long taken = 0;
+        while (street < static_cast<int>(streets.size()) && (taken < perChunk || c + 1 == numThreads))
+            taken += streets[street++].numSegments;
+        chunks[c].endStreet = street;
+    }
+    m_graph.m_names.resize(streets.size());
+    atomic<int> numIds(0);
+    runInParallel(numThreads, [&](int c) { parseChunk(text, lineStarts, streets, chunks[c], numIds); });
+    text.clear();
+    text.shrink_to_fit();
+
+    vector<int> streetName(streets.size());                                     // streets of the same name share one string
+    {
+        ExpandableHashMap<string, int> nameIds;
+        vector<string> names;
+        for (size_t s = 0; s < streets.size(); s++)
         {
-            string streetName = s;
-            string numSegments;
-            getline(infile, numSegments);
-            for (int i = stoi(numSegments); i > 0; i--)
+            const int* id = nameIds.find(m_graph.m_names[s]);
+            if (id == nullptr)
             {
-                getline(infile, s);
-                string startLat = s.substr(0, 10);                              // get individual coords
-                string startLon = s.substr(11, 12);
-                string endLat = s.substr(24, 10);
-                string endLon = s.substr(35, 12);
-                
-                GeoCoord tempStart(startLat, startLon);
-                GeoCoord tempEnd(endLat, endLon);
-                StreetSegment tempSegment(tempStart, tempEnd, streetName);
-                StreetSegment reversedSegment = reverse(tempSegment);
-                
-                vector<StreetSegment> firstVector;
-                if (streetMap.find(tempStart) == nullptr)                       // only associate if vector is not found in map
-                {
-                    streetMap.associate(tempStart, firstVector);
-                }
-                streetMap.find(tempStart)->push_back(tempSegment);              // push the streetsegment into the map
-                
-                vector<StreetSegment> nextVector;
-                if (streetMap.find(tempEnd) == nullptr)                         // only associate if vector is not found in map
+                streetName[s] = static_cast<int>(names.size());
+                nameIds.associate(m_graph.m_names[s], streetName[s]);
+                names.push_back(move(m_graph.m_names[s]));
+            }
+            else
+                streetName[s] = *id;
+        }
+        names.shrink_to_fit();
+        m_graph.m_names.swap(names);
+    }
+
+    vector<GeoCoord> provisional(numIds.load());
+    for (int c = 0; c < numThreads; c++)
+        for (size_t k = 0; k < chunks[c].newCoords.size(); k++)
+            provisional[chunks[c].newCoords[k].first] = move(chunks[c].newCoords[k].second);
+    vector<int> firstSeen;                                                      // provisional numbers in order of first appearance
+    vector<bool> seen(provisional.size(), false);
+    for (int c = 0; c < numThreads; c++)
+        for (size_t k = 0; k < chunks[c].endpoints.size(); k++)
+            if (!seen[chunks[c].endpoints[k]])
+            {
+                seen[chunks[c].endpoints[k]] = true;
+                firstSeen.push_back(chunks[c].endpoints[k]);
+            }
+    vector<const GeoCoord*> firstSeenCoords(firstSeen.size());
+    for (size_t i = 0; i < firstSeen.size(); i++)
+        firstSeenCoords[i] = &provisional[firstSeen[i]];
+    vector<int> curve = hilbertOrder(firstSeenCoords);
+    int numNodes = static_cast<int>(curve.size());
+    vector<int> nodeOf(provisional.size(), -1);
+    m_graph.m_coords.resize(numNodes);
+    for (int node = 0; node < numNodes; node++)
+    {
+        int p = firstSeen[curve[node]];
+        nodeOf[p] = node;
+        m_graph.m_coords[node] = move(provisional[p]);
+    }
+    provisional.clear();
+    provisional.shrink_to_fit();
+    for (int c = 0; c < numThreads; c++)
+        for (size_t k = 0; k < chunks[c].endpoints.size(); k++)
+            chunks[c].endpoints[k] = nodeOf[chunks[c].endpoints[k]];
+    m_graph.m_index.forEach([&nodeOf](const GeoCoord&, int& node) { node = nodeOf[node]; });
+
+    m_parent.resize(numNodes);
+    for (int i = 0; i < numNodes; i++)
+        m_parent[i] = i;
+    vector<int>& firstEdge = m_graph.m_firstEdge;
+    firstEdge.assign(numNodes + 1, 0);
+    for (int c = 0; c < numThreads; c++)
+    {
+        const vector<int>& ends = chunks[c].endpoints;
+        for (size_t k = 0; k < ends.size(); k += 2)
+        {
+            firstEdge[ends[k] + 1]++;                                           // degrees for now
+            firstEdge[ends[k + 1] + 1]++;
+            int startRoot = findRoot(ends[k]);                                  // both ends are in one component
+            int endRoot = findRoot(ends[k + 1]);
+            if (startRoot != endRoot)
+                m_parent[startRoot] = endRoot;
+        }
+    }
+    for (int i = 0; i < numNodes; i++)
+        firstEdge[i + 1] += firstEdge[i];
+
+    int numEdges = firstEdge[numNodes];
+    m_graph.m_target.resize(numEdges);
+    m_graph.m_length.resize(numEdges);
+    m_graph.m_nameId.resize(numEdges);
+    vector<int> nextEdge(firstEdge.begin(), firstEdge.end() - 1);
+    runInParallel(numThreads, [&](int t)
+    {
+        for (int c = 0; c < numThreads; c++)
+        {
+            const Chunk& chunk = chunks[c];
+            size_t k = 0;
+            for (int s = chunk.firstStreet; s < chunk.endStreet; s++)
+            {
+                for (int i = 0; i < streets[s].numSegments; i++, k += 2)
                 {
-                    streetMap.associate(tempEnd, nextVector);
+                    int from = chunk.endpoints[k];
+                    int to = chunk.endpoints[k + 1];
+                    if (from % numThreads != t && to % numThreads != t)
+                        continue;
+                    double length = distanceEarthMiles(m_graph.m_coords[from], m_graph.m_coords[to]);
+                    if (from % numThreads == t)
+                    {
+                        int e = nextEdge[from]++;
+                        m_graph.m_target[e] = to;
+                        m_graph.m_length[e] = length;
+                        m_graph.m_nameId[e] = streetName[s];
+                    }
+                    if (to % numThreads == t)                                   // the same segment travelled backwards
+                    {
+                        int e = nextEdge[to]++;
+                        m_graph.m_target[e] = from;
+                        m_graph.m_length[e] = length;
+                        m_graph.m_nameId[e] = streetName[s];
+                    }
                 }
-                streetMap.find(tempEnd)->push_back(reversedSegment);
             }
         }
+    });
+    
+    vector<int>& component = m_graph.m_component;
+    component.assign(numNodes, -1);                                             // number the components 0, 1, 2, ...
+    int numComponents = 0;
+    for (int i = 0; i < numNodes; i++)
+    {
+        int root = findRoot(i);
+        if (component[root] == -1)
+            component[root] = numComponents++;
+        component[i] = component[root];
+    }
+    m_parent.clear();
+    m_parent.shrink_to_fit();
+    classifyRoads(m_graph, m_roadClasses);
+    if (hubLabelMaps())                                                         // by node id, so good for the compact form too
+    {
+        m_labels.reset(new HubLabels);
+        m_labels->build(m_graph, routeCost(), m_roadClasses.data());
+    }
+    if (turnCostMaps())                                                         // by edge id, likewise
+    {
+        m_turns.reset(new TurnGraph);
+        m_turns->build(m_graph);
     }
+    if (compactMaps())                                                          // keep only the compressed form
+    {
+        m_compact.reset(new CompactGraph);
+        m_compact->build(m_graph);
+        m_graph.clear();
+        classifyRoads(*m_compact, m_roadClasses);                              // the compact form numbers names anew
+        STATS_SET(mapIndexBytes, m_compact->indexMemoryUsage());
+        STATS_SET(mapBytes, m_compact->memoryUsage());
+        return true;
+    }
+    STATS_SET(mapIndexBytes, m_graph.m_index.memoryUsage());
+    STATS_SET(mapBytes, m_graph.memoryUsage());
     return true;
 }
 
-bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+void StreetMapImpl::parseChunk(const string& text, const vector<size_t>& lineStarts, const vector<Street>& streets, Chunk& chunk, atomic<int>& numIds)
+{
+    for (int s = chunk.firstStreet; s < chunk.endStreet; s++)
+    {
+        size_t nameLine = streets[s].nameLine;
+        string& streetName = m_graph.m_names[s];
+        streetName = text.substr(lineStarts[nameLine], lineStarts[nameLine + 1] - lineStarts[nameLine]);
+        if (!streetName.empty() && streetName.back() == '\n')
+            streetName.pop_back();
+        for (int i = 0; i < streets[s].numSegments; i++)
+        {
+            size_t line = lineStarts[nameLine + 2 + i];
+            GeoCoord ends[2] = { GeoCoord(text.substr(line, 10), text.substr(line + 11, 12)),     // get individual coords
+                                 GeoCoord(text.substr(line + 24, 10), text.substr(line + 35, 12)) };
+            for (int j = 0; j < 2; j++)
+            {
+                chunk.endpoints.push_back(m_graph.m_index.associateIfAbsent(ends[j], [&]()
+                {
+                    int p = numIds++;
+                    chunk.newCoords.push_back(make_pair(p, ends[j]));
+                    return p;
+                }));
+            }
+        }
+    }
+}
+
+  // segments leaving gc, from either kind of network
+template<typename Network>
+static bool segmentsFrom(const Network& network, const GeoCoord& gc, vector<StreetSegment>& segs)
 {
-    if (streetMap.find(gc) == nullptr)
+    int node = network.nodeAt(gc);
+    if (node == -1)
         return false;
-    else
-        segs = *streetMap.find(gc);                                              // return the vector of streetsegments if found
+    segs.clear();                                                               // return the segments leaving gc
+    for (int e = network.firstEdge(node); e < network.endEdge(node); e++)
+        segs.push_back(network.segment(node, e));
     return true;
 }
 
-StreetSegment StreetMapImpl::reverse(StreetSegment oldSegment)
+bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+{
+    if (m_tiles != nullptr)
+        return segmentsFrom(TiledMap::Cursor(*m_tiles), gc, segs);
+    if (m_compact != nullptr)
+        return segmentsFrom(CompactGraph::Cursor(*m_compact), gc, segs);
+    return segmentsFrom(m_graph, gc, segs);
+}
+
+int StreetMapImpl::componentOf(const GeoCoord& gc) const
+{
+    if (m_tiles != nullptr)
+    {
+        TiledMap::Cursor cursor(*m_tiles);
+        int node = cursor.nodeAt(gc);
+        return node == -1 ? -1 : cursor.component(node);
+    }
+    if (m_compact != nullptr)
+    {
+        int node = m_compact->nodeAt(gc);
+        return node == -1 ? -1 : m_compact->component(node);
+    }
+    int node = m_graph.nodeAt(gc);
+    return node == -1 ? -1 : m_graph.component(node);
+}
+
+int StreetMapImpl::numIntersections() const
+{
+    if (m_tiles != nullptr)
+        return m_tiles->numNodes();
+    return m_compact != nullptr ? m_compact->numNodes() : m_graph.numNodes();
+}
+
+GeoCoord StreetMapImpl::intersection(int id) const
 {
-    GeoCoord newStart = oldSegment.end;
-    GeoCoord newEnd = oldSegment.start;
-    StreetSegment reversedSegment(newStart, newEnd, oldSegment.name);
-    return reversedSegment;
+    if (m_tiles != nullptr)
+        return TiledMap::Cursor(*m_tiles).coord(id);
+    if (m_compact != nullptr)
+        return CompactGraph::Cursor(*m_compact).coord(id);
+    return m_graph.coord(id);
+}
+
+int StreetMapImpl::intersectionId(const GeoCoord& gc) const
+{
+    if (m_tiles != nullptr)
+        return TiledMap::Cursor(*m_tiles).nodeAt(gc);
+    if (m_compact != nullptr)
+        return m_compact->nodeAt(gc);
+    return m_graph.nodeAt(gc);
+}
+
+int StreetMapImpl::findRoot(int id)
+{
+    while (m_parent[id] != id)
+    {
+        m_parent[id] = m_parent[m_parent[id]];                                  // path halving
+        id = m_parent[id];
+    }
+    return id;
 }
 
 //******************** StreetMap functions ************************************
@@ -111,16 +525,18 @@ StreetSegment StreetMapImpl::reverse(StreetSegment oldSegment)
 
 StreetMap::StreetMap()
 {
-    m_impl = new StreetMapImpl;
+    m_impl = make_shared<StreetMapImpl>();
 }
 
 StreetMap::~StreetMap()
 {
-    delete m_impl;
 }
 
 bool StreetMap::load(string mapFile)
 {
+    if (m_impl.use_count() > 1)                                                 // other maps still use these streets
+        m_impl = make_shared<StreetMapImpl>();
+    m_weights.reset();
     return m_impl->load(mapFile);
 }
 
@@ -128,3 +544,81 @@ bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegmen
 {
    return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+int StreetMap::componentOf(const GeoCoord& gc) const
+{
+    if (m_weights != nullptr)
+    {
+        int node = m_impl->intersectionId(gc);
+        return node == -1 ? -1 : m_weights->component(node);
+    }
+    return m_impl->componentOf(gc);
+}
+
+int StreetMap::numIntersections() const
+{
+    return m_impl->numIntersections();
+}
+
+GeoCoord StreetMap::intersection(int id) const
+{
+    return m_impl->intersection(id);
+}
+
+int StreetMap::intersectionId(const GeoCoord& gc) const
+{
+    return m_impl->intersectionId(gc);
+}
+
+const StreetGraph& StreetMap::graph() const
+{
+    return m_impl->graph();
+}
+
+const TiledMap* StreetMap::tiles() const
+{
+    return m_impl->tiles();
+}
+
+const CompactGraph* StreetMap::compactGraph() const
+{
+    return m_impl->compactGraph();
+}
+
+const HubLabels* StreetMap::hubLabels() const
+{
+    return m_weights != nullptr ? nullptr : m_impl->hubLabels();               // labels hold the loaded lengths
+}
+
+const TurnGraph* StreetMap::turnGraph() const
+{
+    return m_impl->turnGraph();
+}
+
+bool StreetMap::updateEdges(const vector<EdgeUpdate>& updates)
+{
+    return loadUpdated(*this, updates);
+}
+
+bool StreetMap::loadUpdated(const StreetMap& base, const vector<EdgeUpdate>& updates)
+{
+    shared_ptr<EdgeWeights> weights = make_shared<EdgeWeights>();
+    if (!weights->build(base, base.m_weights.get(), updates))
+        return false;
+    m_impl = base.m_impl;
+    if (weights->numChanged() == 0)                                             // every change undone
+        m_weights.reset();
+    else
+        m_weights = weights;
+    return true;
+}
+
+const uint8_t* StreetMap::roadClasses() const
+{
+    return m_impl->roadClasses();
+}
+
+const EdgeWeights* StreetMap::edgeWeights() const
+{
+    return m_weights.get();
+}
@@ -0,0 +1,140 @@
+#include "provided.h"
+#include "StreetMapVersions.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+class VersionedStreetMapImpl
+{
+public:
+    VersionedStreetMapImpl();
+    ~VersionedStreetMapImpl();
+    bool load(const string& mapFile);
+    bool reloadInBackground(const string& mapFile, function<void(bool)> done);
+    unsigned long updateEdges(const vector<EdgeUpdate>& updates);
+    StreetMapSnapshot current() const;
+private:
+    StreetMapSnapshot m_current;            // only touched through atomic_load/atomic_store
+    unsigned long m_nextVersion;            // under m_publishMutex
+    mutex m_publishMutex;                   // so an update never builds on a version a reload replaced
+    mutex m_reloadMutex;                    // guards the two below
+    bool m_reloading;                       // m_reloader has not finished its load and callback
+    thread m_reloader;
+
+    void publish(const shared_ptr<StreetMapVersion>& next);
+};
+
+VersionedStreetMapImpl::VersionedStreetMapImpl()
+ : m_nextVersion(1), m_reloading(false)
+{
+}
+
+VersionedStreetMapImpl::~VersionedStreetMapImpl()
+{
+    thread reloader;
+    {
+        lock_guard<mutex> lock(m_reloadMutex);  // not held while joining: the reloader takes it last thing
+        reloader = move(m_reloader);
+    }
+    if (reloader.joinable())
+        reloader.join();
+}
+
+bool VersionedStreetMapImpl::load(const string& mapFile)
+{
+    shared_ptr<StreetMapVersion> next = make_shared<StreetMapVersion>(0, mapFile);
+    if (!next->map.load(mapFile))
+        return false;
+    lock_guard<mutex> lock(m_publishMutex);
+    publish(next);
+    return true;
+}
+
+  // Numbers the version as it goes out, so numbers follow publication order
+  // even when an update lands while a reload is loading.
+void VersionedStreetMapImpl::publish(const shared_ptr<StreetMapVersion>& next)
+{
+    next->version = m_nextVersion++;
+    StreetMapSnapshot published = next;
+    atomic_store(&m_current, published);    // readers pinned to the old version keep it alive
+}
+
+unsigned long VersionedStreetMapImpl::updateEdges(const vector<EdgeUpdate>& updates)
+{
+    lock_guard<mutex> lock(m_publishMutex);
+    StreetMapSnapshot base = current();
+    if (base == nullptr)
+        return 0;
+    shared_ptr<StreetMapVersion> next = make_shared<StreetMapVersion>(0, base->mapFile);
+    if (!next->map.loadUpdated(base->map, updates))
+        return 0;
+    publish(next);
+    return next->version;
+}
+
+  // One reload at a time, so versions publish in the order reloads were
+  // accepted; a request that overlaps one is refused rather than waiting for
+  // it, since the caller is usually a query worker.
+bool VersionedStreetMapImpl::reloadInBackground(const string& mapFile, function<void(bool)> done)
+{
+    lock_guard<mutex> lock(m_reloadMutex);
+    if (m_reloading)
+        return false;
+    if (m_reloader.joinable())              // done with its work; this only reaps the thread
+        m_reloader.join();
+    m_reloading = true;
+    m_reloader = thread([this, mapFile, done]
+    {
+        bool loaded = load(mapFile);
+        if (done)
+            done(loaded);
+        lock_guard<mutex> lock(m_reloadMutex);
+        m_reloading = false;
+    });
+    return true;
+}
+
+StreetMapSnapshot VersionedStreetMapImpl::current() const
+{
+    return atomic_load(&m_current);
+}
+
+//******************** VersionedStreetMap functions ***************************
+
+// These functions simply delegate to VersionedStreetMapImpl's functions.
+
+VersionedStreetMap::VersionedStreetMap()
+{
+    m_impl = new VersionedStreetMapImpl;
+}
+
+VersionedStreetMap::~VersionedStreetMap()
+{
+    delete m_impl;
+}
+
+bool VersionedStreetMap::load(const string& mapFile)
+{
+    return m_impl->load(mapFile);
+}
+
+bool VersionedStreetMap::reloadInBackground(const string& mapFile, function<void(bool)> done)
+{
+    return m_impl->reloadInBackground(mapFile, done);
+}
+
+unsigned long VersionedStreetMap::updateEdges(const vector<EdgeUpdate>& updates)
+{
+    return m_impl->updateEdges(updates);
+}
+
+StreetMapSnapshot VersionedStreetMap::current() const
+{
+    return m_impl->current();
+}
@@ -0,0 +1,62 @@
+// StreetMapVersions.h
+
+// Versioned, reference-counted StreetMap snapshots for hot map reloads.
+//
+// A reader pins the current version by holding the StreetMapSnapshot that
+// current() returns, and uses that one map for the whole query.  A reload
+// builds the new map off to the side and publishes it with a single atomic
+// pointer swap, so readers never wait on a load and never see a half-built
+// graph.  An old version is destroyed when the last snapshot of it goes away.
+//
+// Edge updates (closures, traffic) publish a new version the same way, but
+// instead of loading the file again it shares the current version's streets
+// and carries only a new EdgeWeights, so it is ready in milliseconds.  A
+// reload starts over from the file, without the updates.
+
+#ifndef STREETMAPVERSIONS_INCLUDED
+#define STREETMAPVERSIONS_INCLUDED
+
+#include "provided.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct StreetMapVersion
+{
+    StreetMapVersion(unsigned long v, const std::string& file)
+     : version(v), mapFile(file)
+    {}
+    StreetMap     map;
+    unsigned long version;
+    std::string   mapFile;
+};
+
+typedef std::shared_ptr<const StreetMapVersion> StreetMapSnapshot;
+
+class VersionedStreetMapImpl;
+
+class VersionedStreetMap
+{
+public:
+    VersionedStreetMap();
+    ~VersionedStreetMap();
+      // load mapFile now and publish it; on failure the current version stays
+    bool load(const std::string& mapFile);
+      // load mapFile on a background thread and publish it when it is ready;
+      // done (if given) is called on that thread with the outcome.  Returns
+      // at once; false, starting nothing, if a reload is already under way.
+    bool reloadInBackground(const std::string& mapFile, std::function<void(bool)> done = nullptr);
+      // publish a version of the current map with updates applied on top of
+      // its own; its version number, or 0 (nothing published) if there is no
+      // map yet or the updates are rejected (StreetMap::updateEdges)
+    unsigned long updateEdges(const std::vector<EdgeUpdate>& updates);
+      // the newest published version, or an empty snapshot before the first load
+    StreetMapSnapshot current() const;
+    VersionedStreetMap(const VersionedStreetMap&) = delete;
+    VersionedStreetMap& operator=(const VersionedStreetMap&) = delete;
+private:
+    VersionedStreetMapImpl* m_impl;
+};
+
+#endif // STREETMAPVERSIONS_INCLUDED
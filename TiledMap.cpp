@@ -0,0 +1,610 @@
+#include "TiledMap.h"
+#include "ExpandableHashMap.h"
+#include "Stats.h"
+#include "StreetGraph.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// File layout:
+//   FileHeader
+//   DirectoryEntry x numTiles, sorted by tile key
+//   one blob per tile:
+//     uint32 edgeBegin[numNodes+1], int32 component[numNodes],
+//     per node: uint8 length + latitude text, uint8 length + longitude text,
+//     uint32 target[numEdges], uint32 nameId[numEdges], double length[numEdges]
+//   names: uint32 length + text, numNames times
+// Within a tile, nodes keep the map's Hilbert order and each node's edges keep
+// map-file order, so searches over the tiles find the same routes.
+
+namespace
+{
+    const char TILE_MAGIC[8] = { 'D', 'T', 'I', 'L', 'E', 'S', '1', '\n' };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t numNodes;
+        uint32_t numEdges;
+        uint32_t numTiles;
+        uint32_t numNames;
+        double originLat;
+        double originLon;
+        double tileLat;
+        double tileLon;
+        uint32_t columns;
+        uint32_t rows;
+        uint64_t namesOffset;
+    };
+
+    template<typename T>
+    void putRaw(string& out, const T& v)
+    {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    template<typename T>
+    T getRaw(const char*& p)
+    {
+        T v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+
+    uint32_t tileKey(double lat, double lon, double originLat, double originLon, double tileLat, double tileLon, uint32_t columns, uint32_t rows)
+    {
+        long row = static_cast<long>(floor((lat - originLat) / tileLat));
+        long column = static_cast<long>(floor((lon - originLon) / tileLon));
+        row = max(0L, min(row, static_cast<long>(rows) - 1));
+        column = max(0L, min(column, static_cast<long>(columns) - 1));
+        return static_cast<uint32_t>(row * columns + column);
+    }
+
+      // bytes of a tile blob that don't depend on its coordinate text
+    uint64_t fixedTileBytes(uint64_t numNodes, uint64_t numEdges)
+    {
+        return (numNodes + 1) * sizeof(uint32_t) + numNodes * (sizeof(int32_t) + 2) +
+               numEdges * (2 * sizeof(uint32_t) + sizeof(double));
+    }
+
+    [[noreturn]] void corruptTile(int index)
+    {
+        throw runtime_error("tile " + to_string(index) + " of the map file is corrupt");
+    }
+}
+
+bool TiledMap::isTileFile(const string& file)
+{
+    ifstream in(file, ios::binary);
+    char magic[sizeof(TILE_MAGIC)];
+    return in.read(magic, sizeof(magic)) && memcmp(magic, TILE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool TiledMap::write(const StreetGraph& graph, const string& tileFile, double tileMiles)
+{
+    int numNodes = graph.numNodes();
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC));
+    double minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+    for (int n = 0; n < numNodes; n++)
+    {
+        const GeoCoord& gc = graph.coord(n);
+        minLat = (n == 0) ? gc.latitude : min(minLat, gc.latitude);
+        maxLat = (n == 0) ? gc.latitude : max(maxLat, gc.latitude);
+        minLon = (n == 0) ? gc.longitude : min(minLon, gc.longitude);
+        maxLon = (n == 0) ? gc.longitude : max(maxLon, gc.longitude);
+    }
+    const double milesPerDegree = 69.05;
+    header.originLat = minLat;
+    header.originLon = minLon;
+    header.tileLat = tileMiles / milesPerDegree;
+    header.tileLon = tileMiles / (milesPerDegree * max(0.01, cos((minLat + maxLat) / 2 * M_PI / 180)));
+    header.rows = static_cast<uint32_t>((maxLat - minLat) / header.tileLat) + 1;
+    header.columns = static_cast<uint32_t>((maxLon - minLon) / header.tileLon) + 1;
+    if (static_cast<double>(header.rows) * header.columns > 4e9)
+        return false;
+
+      // nodes ordered by tile, Hilbert order within a tile
+    vector<uint32_t> keys(numNodes);
+    vector<int> order(numNodes);
+    for (int n = 0; n < numNodes; n++)
+    {
+        keys[n] = tileKey(graph.coord(n).latitude, graph.coord(n).longitude, header.originLat, header.originLon,
+                          header.tileLat, header.tileLon, header.columns, header.rows);
+        order[n] = n;
+    }
+    stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+    vector<int> newId(numNodes);
+    for (int i = 0; i < numNodes; i++)
+        newId[order[i]] = i;
+
+    ExpandableHashMap<string, uint32_t> nameIds;
+    vector<const string*> names;
+    vector<string> blobs;
+    vector<DirectoryEntry> directory;
+    uint32_t numEdges = 0;
+    for (int i = 0; i < numNodes; )
+    {
+        int first = i;
+        while (i < numNodes && keys[order[i]] == keys[order[first]])
+            i++;
+        string blob;
+        uint32_t edgeBegin = 0;
+        for (int j = first; j <= i; j++)
+        {
+            putRaw(blob, edgeBegin);
+            if (j < i)
+                edgeBegin += graph.endEdge(order[j]) - graph.firstEdge(order[j]);
+        }
+        for (int j = first; j < i; j++)
+            putRaw(blob, static_cast<int32_t>(graph.component(order[j])));
+        for (int j = first; j < i; j++)
+        {
+            const GeoCoord& gc = graph.coord(order[j]);
+            blob += static_cast<char>(min<size_t>(gc.latitudeText.size(), 255));
+            blob.append(gc.latitudeText, 0, 255);
+            blob += static_cast<char>(min<size_t>(gc.longitudeText.size(), 255));
+            blob.append(gc.longitudeText, 0, 255);
+        }
+        for (int j = first; j < i; j++)
+            for (int e = graph.firstEdge(order[j]); e < graph.endEdge(order[j]); e++)
+                putRaw(blob, static_cast<uint32_t>(newId[graph.target(e)]));
+        for (int j = first; j < i; j++)
+            for (int e = graph.firstEdge(order[j]); e < graph.endEdge(order[j]); e++)
+            {
+                const uint32_t* id = nameIds.find(graph.name(e));
+                if (id == nullptr)
+                {
+                    nameIds.associate(graph.name(e), static_cast<uint32_t>(names.size()));
+                    names.push_back(&graph.name(e));
+                    id = nameIds.find(graph.name(e));
+                }
+                putRaw(blob, *id);
+            }
+        for (int j = first; j < i; j++)
+            for (int e = graph.firstEdge(order[j]); e < graph.endEdge(order[j]); e++)
+                putRaw(blob, graph.length(e));
+
+        DirectoryEntry entry;
+        entry.key = keys[order[first]];
+        entry.firstNode = first;
+        entry.numNodes = i - first;
+        entry.firstEdge = numEdges;
+        entry.numEdges = edgeBegin;
+        entry.padding = 0;
+        entry.offset = 0;                           // filled in below
+        entry.bytes = blob.size();
+        directory.push_back(entry);
+        numEdges += edgeBegin;
+        blobs.push_back(move(blob));
+    }
+    header.numNodes = numNodes;
+    header.numEdges = numEdges;
+    header.numTiles = static_cast<uint32_t>(blobs.size());
+    header.numNames = static_cast<uint32_t>(names.size());
+
+    uint64_t offset = sizeof(FileHeader) + directory.size() * sizeof(DirectoryEntry);
+    for (size_t t = 0; t < blobs.size(); t++)
+    {
+        directory[t].offset = offset;
+        offset += blobs[t].size();
+    }
+    header.namesOffset = offset;
+
+    ofstream out(tileFile, ios::binary | ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DirectoryEntry));
+    for (size_t t = 0; t < blobs.size(); t++)
+        out.write(blobs[t].data(), blobs[t].size());
+    for (size_t n = 0; n < names.size(); n++)
+    {
+        uint32_t length = static_cast<uint32_t>(names[n]->size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(names[n]->data(), length);
+    }
+    return static_cast<bool>(out);
+}
+
+//******************** TiledMap functions *************************************
+
+static int s_defaultCacheTiles = TiledMap::DEFAULT_CACHE_TILES;
+
+TiledMap::TiledMap()
+ : m_data(nullptr), m_size(0), m_numNodes(0), m_cacheTiles(DEFAULT_CACHE_TILES), m_tilesLoaded(0)
+{
+}
+
+TiledMap::~TiledMap()
+{
+    close();
+}
+
+void TiledMap::close()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool TiledMap::open(const string& tileFile, int cacheTiles)
+{
+    close();
+    int fd = ::open(tileFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    m_data = static_cast<const char*>(data);
+    m_size = st.st_size;
+
+    FileHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    if (memcmp(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC)) != 0 ||
+        sizeof(FileHeader) + static_cast<uint64_t>(header.numTiles) * sizeof(DirectoryEntry) > m_size ||
+        header.namesOffset > m_size)
+    {
+        close();
+        return false;
+    }
+    m_numNodes = header.numNodes;
+    m_originLat = header.originLat;
+    m_originLon = header.originLon;
+    m_tileLat = header.tileLat;
+    m_tileLon = header.tileLon;
+    m_columns = header.columns;
+    m_rows = header.rows;
+    m_directory.resize(header.numTiles);
+    if (header.numTiles > 0)
+        memcpy(&m_directory[0], m_data + sizeof(FileHeader), header.numTiles * sizeof(DirectoryEntry));
+      // tiles in key order, each a nonempty run of the nodes and edges after the
+      // last, with room in the file for everything but its coordinate text
+    uint64_t nodes = 0, edges = 0;
+    for (size_t t = 0; t < m_directory.size(); t++)
+    {
+        const DirectoryEntry& entry = m_directory[t];
+        if (entry.offset > m_size || entry.bytes > m_size - entry.offset ||
+            entry.bytes < fixedTileBytes(entry.numNodes, entry.numEdges) ||
+            entry.numNodes == 0 || entry.firstNode != nodes || entry.firstEdge != edges ||
+            entry.key >= static_cast<uint64_t>(m_rows) * m_columns || (t > 0 && entry.key <= m_directory[t - 1].key))
+        {
+            close();
+            return false;
+        }
+        nodes += entry.numNodes;
+        edges += entry.numEdges;
+    }
+    if (nodes != header.numNodes || edges != header.numEdges || nodes > INT_MAX || edges > INT_MAX)
+    {
+        close();
+        return false;
+    }
+    const char* p = m_data + header.namesOffset;
+    m_names.resize(header.numNames);
+    for (uint32_t n = 0; n < header.numNames; n++)
+    {
+        if (p + sizeof(uint32_t) > m_data + m_size)
+        {
+            close();
+            return false;
+        }
+        uint32_t length = getRaw<uint32_t>(p);
+        if (length > static_cast<size_t>(m_data + m_size - p))
+        {
+            close();
+            return false;
+        }
+        m_names[n].assign(p, length);
+        p += length;
+    }
+
+    m_cacheTiles = max(1, cacheTiles);
+    m_resident.assign(m_directory.size(), shared_ptr<const Tile>());
+    m_lru.clear();
+    m_lruPos.assign(m_directory.size(), m_lru.end());
+    m_tilesLoaded = 0;
+    return true;
+}
+
+int TiledMap::residentTiles() const
+{
+    lock_guard<mutex> lock(m_cacheLock);
+    return static_cast<int>(m_lru.size());
+}
+
+long TiledMap::tilesLoaded() const
+{
+    lock_guard<mutex> lock(m_cacheLock);
+    return m_tilesLoaded;
+}
+
+shared_ptr<const TiledMap::Tile> TiledMap::load(int index) const
+{
+    {
+        lock_guard<mutex> lock(m_cacheLock);
+        if (m_resident[index] != nullptr)
+        {
+            m_lru.splice(m_lru.begin(), m_lru, m_lruPos[index]);
+            return m_resident[index];
+        }
+    }
+    shared_ptr<const Tile> tile = decode(index);                           // without the lock; other threads keep going
+    STATS_ADD(tilesLoaded, 1);
+    lock_guard<mutex> lock(m_cacheLock);
+    if (m_resident[index] != nullptr)                                       // another thread got there first
+        return m_resident[index];
+    m_resident[index] = tile;
+    m_lru.push_front(index);
+    m_lruPos[index] = m_lru.begin();
+    m_tilesLoaded++;
+    while (static_cast<int>(m_lru.size()) > m_cacheTiles)
+    {
+        int victim = m_lru.back();
+        m_lru.pop_back();
+        m_lruPos[victim] = m_lru.end();
+        m_resident[victim].reset();                                         // searches holding it keep their copy
+        long page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = reinterpret_cast<uintptr_t>(m_data + m_directory[victim].offset);
+        uintptr_t end = begin + m_directory[victim].bytes;
+        begin = (begin + page - 1) / page * page;                          // only pages wholly inside the tile
+        end = end / page * page;
+        if (end > begin)
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+    return tile;
+}
+
+  // open() checked the directory; this checks what only the tile's bytes can
+  // get wrong and throws if they don't make sense, so a corrupt tile fails the
+  // search that reached it instead of sending it out of bounds.
+shared_ptr<const TiledMap::Tile> TiledMap::decode(int index) const
+{
+    const DirectoryEntry& entry = m_directory[index];
+    shared_ptr<Tile> tile = make_shared<Tile>();
+    tile->firstNode = entry.firstNode;
+    tile->firstEdge = entry.firstEdge;
+    int numNodes = entry.numNodes;
+    int numEdges = entry.numEdges;
+    const char* p = m_data + entry.offset;
+    const char* end = p + entry.bytes;
+    tile->edgeBegin.resize(numNodes + 1);
+    uint32_t previous = 0;
+    for (int n = 0; n <= numNodes; n++)
+    {
+        uint32_t begin = getRaw<uint32_t>(p);
+        if (begin < previous || begin > entry.numEdges || (n == 0 && begin != 0) || (n == numNodes && begin != entry.numEdges))
+            corruptTile(index);
+        tile->edgeBegin[n] = begin;
+        previous = begin;
+    }
+    tile->component.resize(numNodes);
+    for (int n = 0; n < numNodes; n++)
+        tile->component[n] = getRaw<int32_t>(p);
+    tile->coords.reserve(numNodes);
+    for (int n = 0; n < numNodes; n++)
+    {
+        string text[2];
+        for (int i = 0; i < 2; i++)
+        {
+            if (p == end || static_cast<unsigned char>(*p) >= end - p)
+                corruptTile(index);
+            size_t length = static_cast<unsigned char>(*p++);
+            text[i].assign(p, length);
+            p += length;
+        }
+        try
+        {
+            tile->coords.push_back(GeoCoord(text[0], text[1]));
+        }
+        catch (const logic_error&)                                          // stod rejects the text
+        {
+            corruptTile(index);
+        }
+    }
+    if (static_cast<uint64_t>(end - p) < static_cast<uint64_t>(numEdges) * (2 * sizeof(uint32_t) + sizeof(double)))
+        corruptTile(index);
+    tile->target.resize(numEdges);
+    for (int e = 0; e < numEdges; e++)
+    {
+        uint32_t to = getRaw<uint32_t>(p);
+        if (to >= static_cast<uint32_t>(m_numNodes))
+            corruptTile(index);
+        tile->target[e] = to;
+    }
+    tile->nameId.resize(numEdges);
+    for (int e = 0; e < numEdges; e++)
+    {
+        uint32_t nameId = getRaw<uint32_t>(p);
+        if (nameId >= m_names.size())
+            corruptTile(index);
+        tile->nameId[e] = nameId;
+    }
+    tile->length.resize(numEdges);
+    for (int e = 0; e < numEdges; e++)
+        tile->length[e] = getRaw<double>(p);
+    return tile;
+}
+
+int TiledMap::tileIndexOf(const GeoCoord& gc) const
+{
+    if (m_directory.empty())
+        return -1;
+    uint32_t key = tileKey(gc.latitude, gc.longitude, m_originLat, m_originLon, m_tileLat, m_tileLon, m_columns, m_rows);
+    auto it = lower_bound(m_directory.begin(), m_directory.end(), key,
+                          [](const DirectoryEntry& entry, uint32_t k) { return entry.key < k; });
+    if (it == m_directory.end() || it->key != key)
+        return -1;
+    return static_cast<int>(it - m_directory.begin());
+}
+
+int TiledMap::tileIndexOfNode(int node) const
+{
+    auto it = upper_bound(m_directory.begin(), m_directory.end(), static_cast<uint32_t>(node),
+                          [](uint32_t n, const DirectoryEntry& entry) { return n < entry.firstNode; });
+    return static_cast<int>(it - m_directory.begin()) - 1;
+}
+
+int TiledMap::tileIndexOfEdge(int edge) const
+{
+    auto it = upper_bound(m_directory.begin(), m_directory.end(), static_cast<uint32_t>(edge),
+                          [](uint32_t e, const DirectoryEntry& entry) { return e < entry.firstEdge; });
+    return static_cast<int>(it - m_directory.begin()) - 1;                 // the last of any tiles sharing a firstEdge has the edges
+}
+
+//******************** TiledMap::Cursor functions *****************************
+
+TiledMap::Cursor::Cursor(const TiledMap& map)
+ : m_map(map), m_pinned(map.numTiles()), m_used(map.numTiles(), 0), m_clock(0), m_last(-1),
+   m_maxPinned(max(2, map.cacheTiles()))
+{
+}
+
+const TiledMap::Tile& TiledMap::Cursor::tile(int index) const
+{
+    if (m_pinned[index] == nullptr)
+    {
+        if (static_cast<int>(m_pinnedTiles.size()) >= m_maxPinned)
+            unpinLeastRecent();
+        m_pinned[index] = m_map.load(index);
+        m_pinnedTiles.push_back(index);
+    }
+    m_used[index] = ++m_clock;
+    m_last = index;
+    return *m_pinned[index];
+}
+
+  // The last lookup's tile was used most recently, so it stays pinned.  The
+  // unpinned tile stays decoded while the map's cache keeps it.
+void TiledMap::Cursor::unpinLeastRecent() const
+{
+    size_t oldest = 0;
+    for (size_t i = 1; i < m_pinnedTiles.size(); i++)
+        if (m_used[m_pinnedTiles[i]] < m_used[m_pinnedTiles[oldest]])
+            oldest = i;
+    m_pinned[m_pinnedTiles[oldest]].reset();
+    m_pinnedTiles[oldest] = m_pinnedTiles.back();
+    m_pinnedTiles.pop_back();
+}
+
+const TiledMap::Tile& TiledMap::Cursor::tileOfNode(int node) const
+{
+    if (m_last >= 0)
+    {
+        const DirectoryEntry& entry = m_map.m_directory[m_last];
+        if (static_cast<uint32_t>(node) - entry.firstNode < entry.numNodes)
+            return *m_pinned[m_last];
+    }
+    return tile(m_map.tileIndexOfNode(node));
+}
+
+const TiledMap::Tile& TiledMap::Cursor::tileOfEdge(int edge) const
+{
+    if (m_last >= 0)
+    {
+        const DirectoryEntry& entry = m_map.m_directory[m_last];
+        if (static_cast<uint32_t>(edge) - entry.firstEdge < entry.numEdges)
+            return *m_pinned[m_last];
+    }
+    return tile(m_map.tileIndexOfEdge(edge));
+}
+
+int TiledMap::Cursor::nodeAt(const GeoCoord& gc) const
+{
+    int index = m_map.tileIndexOf(gc);
+    if (index < 0)
+        return -1;
+    const Tile& t = tile(index);
+    for (size_t n = 0; n < t.coords.size(); n++)
+        if (t.coords[n] == gc)
+            return t.firstNode + static_cast<int>(n);
+    return -1;
+}
+
+const GeoCoord& TiledMap::Cursor::coord(int node) const
+{
+    const Tile& t = tileOfNode(node);
+    return t.coords[node - t.firstNode];
+}
+
+int TiledMap::Cursor::component(int node) const
+{
+    const Tile& t = tileOfNode(node);
+    return t.component[node - t.firstNode];
+}
+
+int TiledMap::Cursor::firstEdge(int node) const
+{
+    const Tile& t = tileOfNode(node);
+    return t.firstEdge + t.edgeBegin[node - t.firstNode];
+}
+
+int TiledMap::Cursor::endEdge(int node) const
+{
+    const Tile& t = tileOfNode(node);
+    return t.firstEdge + t.edgeBegin[node - t.firstNode + 1];
+}
+
+int TiledMap::Cursor::target(int edge) const
+{
+    const Tile& t = tileOfEdge(edge);
+    return t.target[edge - t.firstEdge];
+}
+
+double TiledMap::Cursor::length(int edge) const
+{
+    const Tile& t = tileOfEdge(edge);
+    return t.length[edge - t.firstEdge];
+}
+
+const string& TiledMap::Cursor::name(int edge) const
+{
+    const Tile& t = tileOfEdge(edge);
+    return m_map.m_names[t.nameId[edge - t.firstEdge]];
+}
+
+int TiledMap::Cursor::nameId(int edge) const
+{
+    const Tile& t = tileOfEdge(edge);
+    return t.nameId[edge - t.firstEdge];
+}
+
+StreetSegment TiledMap::Cursor::segment(int node, int edge) const
+{
+    const Tile& t = tileOfEdge(edge);
+    int to = t.target[edge - t.firstEdge];
+    int streetNameId = t.nameId[edge - t.firstEdge];
+    GeoCoord from = coord(node);
+    return StreetSegment(from, coord(to), m_map.m_names[streetNameId], streetNameId);
+}
+
+//******************** cache size *********************************************
+
+void setDefaultTileCache(int tiles)
+{
+    s_defaultCacheTiles = max(1, tiles);
+}
+
+int defaultTileCache()
+{
+    return s_defaultCacheTiles;
+}
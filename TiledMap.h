@@ -0,0 +1,157 @@
+// TiledMap.h
+
+// A map file cut into square tiles that are read only when a search needs
+// them, so a worker can serve a large map without holding all of it.
+//
+// TiledMap::write turns a loaded map into a tile file (tools/tilemap.cpp).  A
+// TiledMap memory-maps that file and decodes tiles on first use; at most
+// cacheTiles() decoded tiles stay cached, least recently used ones are evicted
+// and their pages handed back to the kernel.  StreetMap::load opens tile files
+// this way automatically.
+//
+// Nodes and edges have global ids, ordered by tile, so a Cursor presents the
+// same interface as StreetGraph and the router searches either one.  A Cursor
+// belongs to one search on one thread: it keeps the cacheTiles() tiles (at
+// least 2) the search used most recently pinned, so eviction never pulls a
+// tile out from under a lookup, and unpins the least recently used when it
+// needs another; a long search holds no more than that beyond the cache.  A
+// reference a Cursor returns lasts until the next lookup in another tile.
+//
+// open() rejects a file whose header or tile directory doesn't hold together;
+// a tile whose own bytes are corrupt throws runtime_error when a search first
+// reaches it, failing that search.
+//
+// The file is written in the host's byte order.
+
+#ifndef TILEDMAP_INCLUDED
+#define TILEDMAP_INCLUDED
+
+#include "provided.h"
+#include "FlatEarth.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class StreetGraph;
+
+  // number of tiles a TiledMap opened by StreetMap::load may keep decoded
+void setDefaultTileCache(int tiles);
+int defaultTileCache();
+
+class TiledMap
+{
+public:
+    static const int DEFAULT_CACHE_TILES = 256;
+
+    TiledMap();
+    ~TiledMap();
+      // tileMiles is the side of a tile
+    static bool write(const StreetGraph& graph, const std::string& tileFile, double tileMiles = 1.0);
+      // true if the file starts like a tile file
+    static bool isTileFile(const std::string& file);
+
+    bool open(const std::string& tileFile, int cacheTiles = DEFAULT_CACHE_TILES);
+    int numNodes() const { return m_numNodes; }
+    int numTiles() const { return static_cast<int>(m_directory.size()); }
+    int numNames() const { return static_cast<int>(m_names.size()); }
+    const std::string& nameOf(int nameId) const { return m_names[nameId]; }
+    int cacheTiles() const { return m_cacheTiles; }
+    int residentTiles() const;
+    long tilesLoaded() const;                   // decodes since open, including reloads after eviction
+
+    struct Tile
+    {
+        int firstNode;
+        int firstEdge;
+        std::vector<GeoCoord> coords;
+        std::vector<int> component;
+        std::vector<int> edgeBegin;             // coords.size()+1 offsets, relative to firstEdge
+        std::vector<int> target;                // global node ids
+        std::vector<double> length;
+        std::vector<int> nameId;
+    };
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const TiledMap& map);
+        int numNodes() const { return m_map.numNodes(); }
+        int nodeAt(const GeoCoord& gc) const;
+        const GeoCoord& coord(int node) const;
+        GeoPoint point(int node) const
+        {
+            const GeoCoord& gc = coord(node);
+            return GeoPoint{ gc.latitude, gc.longitude };
+        }
+        double milesTo(int node, const GeoCoord& gc) const { return distanceEarthMiles(coord(node), gc); }
+        double milesTo(int node, const GeoCoord& gc, const FlatEarth& flat) const { return flat.miles(coord(node), gc); }
+        int component(int node) const;
+        int firstEdge(int node) const;
+        int endEdge(int node) const;
+        int target(int edge) const;
+        double length(int edge) const;
+        bool open(int) const { return true; }
+        const std::string& name(int edge) const;
+        int nameId(int edge) const;
+        StreetSegment segment(int node, int edge) const;
+    private:
+        const TiledMap& m_map;
+        mutable std::vector<std::shared_ptr<const Tile> > m_pinned;     // by tile index
+        mutable std::vector<unsigned long> m_used;                      // by tile index: m_clock at its last lookup
+        mutable std::vector<int> m_pinnedTiles;
+        mutable unsigned long m_clock;
+        mutable int m_last;                                             // tile of the last lookup
+        int m_maxPinned;
+
+        const Tile& tileOfNode(int node) const;
+        const Tile& tileOfEdge(int edge) const;
+        const Tile& tile(int index) const;
+        void unpinLeastRecent() const;
+    };
+
+    TiledMap(const TiledMap&) = delete;
+    TiledMap& operator=(const TiledMap&) = delete;
+private:
+    struct DirectoryEntry
+    {
+        uint32_t key;                           // row * columns + column
+        uint32_t firstNode;
+        uint32_t numNodes;
+        uint32_t firstEdge;
+        uint32_t numEdges;
+        uint32_t padding;
+        uint64_t offset;
+        uint64_t bytes;
+    };
+
+    const char* m_data;
+    size_t m_size;
+    int m_numNodes;
+    double m_originLat;
+    double m_originLon;
+    double m_tileLat;
+    double m_tileLon;
+    uint32_t m_columns;
+    uint32_t m_rows;
+    std::vector<DirectoryEntry> m_directory;
+    std::vector<std::string> m_names;
+
+    int m_cacheTiles;
+    mutable std::mutex m_cacheLock;
+    mutable std::vector<std::shared_ptr<const Tile> > m_resident;   // by tile index
+    mutable std::list<int> m_lru;                                   // most recently used first
+    mutable std::vector<std::list<int>::iterator> m_lruPos;
+    mutable long m_tilesLoaded;
+
+    std::shared_ptr<const Tile> load(int index) const;
+    std::shared_ptr<const Tile> decode(int index) const;
+    int tileIndexOf(const GeoCoord& gc) const;
+    int tileIndexOfNode(int node) const;
+    int tileIndexOfEdge(int edge) const;
+    void close();
+};
+
+#endif // TILEDMAP_INCLUDED
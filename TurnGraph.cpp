@@ -0,0 +1,65 @@
+#include "TurnGraph.h"
+#include "StreetGraph.h"
+#include <cmath>
+using namespace std;
+
+TurnGraph::TurnGraph()
+{
+}
+
+void TurnGraph::build(const StreetGraph& graph)
+{
+    int numEdges = graph.numEdges();
+    m_heading.assign(numEdges, 0);
+    m_reverse.assign(numEdges, -1);
+    m_nameId.assign(numEdges, -1);
+    for (int node = 0; node < graph.numNodes(); node++)
+    {
+        const GeoCoord& from = graph.coord(node);
+        for (int e = graph.firstEdge(node); e < graph.endEdge(node); e++)
+        {
+            int next = graph.target(e);
+            const GeoCoord& to = graph.coord(next);
+            m_heading[e] = static_cast<float>(rad2deg(atan2(to.latitude - from.latitude, to.longitude - from.longitude)));
+            m_nameId[e] = graph.nameId(e);
+            for (int back = graph.firstEdge(next); back < graph.endEdge(next); back++)
+            {
+                if (graph.target(back) == node)
+                {
+                    m_reverse[e] = back;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+long TurnGraph::memoryUsage() const
+{
+    return static_cast<long>(m_heading.capacity() * sizeof(float) + m_reverse.capacity() * sizeof(int) + m_nameId.capacity() * sizeof(int));
+}
+
+//******************** build switch *******************************************
+
+static bool s_turnCostMaps = false;
+static TurnPenalties s_turnPenalties;
+
+void setTurnCostMaps(bool build)
+{
+    s_turnCostMaps = build;
+}
+
+bool turnCostMaps()
+{
+    return s_turnCostMaps;
+}
+
+void setTurnPenalties(const TurnPenalties& penalties)
+{
+    s_turnPenalties = penalties;
+}
+
+const TurnPenalties& turnPenalties()
+{
+    return s_turnPenalties;
+}
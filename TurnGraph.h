@@ -0,0 +1,77 @@
+// TurnGraph.h
+
+// Turn costs for the router, on the edge-based graph of a StreetGraph: the
+// search's states are the graph's directed edges, and moving from one edge
+// onto the next costs the next edge's length plus a penalty for the turn
+// between them.  The expansion is implicit (the turns from an edge are the
+// edges out of its target), so the only storage is per edge: its heading,
+// precomputed as angleOfLine computes it, the edge back the way it came, and
+// its street name id.  Edge ids are the StreetGraph's, which the compact form
+// keeps, so one TurnGraph serves either form.
+//
+// Turns are classified the way DeliveryPlanner words its instructions: onto
+// another street, a turn within a degree of straight ahead is straight, up to
+// 180 degrees (as angleBetween2Lines measures it) is left, and beyond that is
+// right.  Bends along one street cost nothing, since the driver is not told to
+// turn there; taking the edge straight back is a U-turn on any street.
+
+#ifndef TURNGRAPH_INCLUDED
+#define TURNGRAPH_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+class StreetGraph;
+
+  // miles, charged as that much more of the street turned onto, so under a
+  // travel-time or custom route cost (RouteCosts.h) a penalty costs what
+  // that distance costs on that street
+struct TurnPenalties
+{
+    double straight = 0;
+    double right = 0.02;
+    double left = 0.05;
+    double uTurn = 0.25;
+};
+
+  // whether StreetMap::load builds a TurnGraph for its map, so that routes
+  // are chosen with turn costs (off by default)
+void setTurnCostMaps(bool build);
+bool turnCostMaps();
+void setTurnPenalties(const TurnPenalties& penalties);
+const TurnPenalties& turnPenalties();
+
+class TurnGraph
+{
+public:
+    enum Turn : uint8_t { STRAIGHT, RIGHT, LEFT, U_TURN };
+
+    TurnGraph();
+    void build(const StreetGraph& graph);
+
+    int numEdges() const { return static_cast<int>(m_heading.size()); }
+      // the turn from edge from onto edge to, which leaves from's target
+    Turn turn(int from, int to) const
+    {
+        if (to == m_reverse[from])
+            return U_TURN;
+        if (m_nameId[to] == m_nameId[from])
+            return STRAIGHT;
+        float angle = m_heading[to] - m_heading[from];
+        if (angle < 0)
+            angle += 360;
+        if (angle < 1 || angle > 359)
+            return STRAIGHT;
+        return angle < 180 ? LEFT : RIGHT;
+    }
+    long memoryUsage() const;
+
+    TurnGraph(const TurnGraph&) = delete;
+    TurnGraph& operator=(const TurnGraph&) = delete;
+private:
+    std::vector<float> m_heading;               // degrees counterclockwise from east
+    std::vector<int> m_reverse;                 // the edge from target back to source, or -1
+    std::vector<int> m_nameId;
+};
+
+#endif // TURNGRAPH_INCLUDED
@@ -1,11 +1,26 @@
 #include "provided.h"
 #include "ExpandableHashMap.h"
+#include "CommandWriter.h"
+#include "CompactGraph.h"
+#include "FlatEarth.h"
+#include "HubLabels.h"
+#include "QueryLog.h"
+#include "QueryServer.h"
+#include "RouteCosts.h"
+#include "RouteQueues.h"
+#include "StreetMapVersions.h"
+#include "Stats.h"
+#include "TiledMap.h"
+#include "TurnGraph.h"
+#include <cstdlib>
+#include <exception>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <list>
+#include <thread>
 using namespace std;
 
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
@@ -13,35 +28,176 @@ bool parseDelivery(string line, string& lat, string& lon, string& item);
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    vector<string> files;
+    CommandWriter::Format format = CommandWriter::TEXT;
+    bool serve = false;
+    bool showStats = false;
+    bool stream = false;
+    string socketPath;
+    string recordPath;
+    int numThreads = thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++)
     {
-        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--format=") == 0)
+        {
+            if (!CommandWriter::parseFormat(arg.substr(9), format))
+            {
+                cout << "Unknown output format " << arg.substr(9) << " (use text, json or binary)" << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--stats")
+            showStats = true;
+        else if (arg == "--serve")
+            serve = true;
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg.compare(0, 9, "--socket=") == 0)
+            socketPath = arg.substr(9);
+        else if (arg.compare(0, 10, "--threads=") == 0)
+            numThreads = atoi(arg.substr(10).c_str());
+        else if (arg.compare(0, 9, "--record=") == 0)
+            recordPath = arg.substr(9);
+        else if (arg == "--compact")
+            setCompactMaps(true);
+        else if (arg == "--hub-labels")
+            setHubLabelMaps(true);
+        else if (arg == "--fast-distance")
+            setFastDistance(true);
+        else if (arg == "--turn-costs")
+            setTurnCostMaps(true);
+        else if (arg.compare(0, 13, "--tile-cache=") == 0)
+            setDefaultTileCache(atoi(arg.substr(13).c_str()));
+        else if (arg.compare(0, 14, "--route-queue=") == 0)
+        {
+            RouteQueue queue;
+            if (!parseRouteQueue(arg.substr(14), queue))
+            {
+                cout << "Unknown route queue " << arg.substr(14) << " (use fifo, heap, radix or buckets)" << endl;
+                return 1;
+            }
+            setRouteQueue(queue);
+        }
+        else if (arg.compare(0, 13, "--route-cost=") == 0)
+        {
+            RouteCost cost;
+            if (!parseRouteCost(arg.substr(13), cost))
+            {
+                cout << "Unknown route cost " << arg.substr(13) << " (use distance, time or custom)" << endl;
+                return 1;
+            }
+            setRouteCost(cost);
+        }
+        else if (arg.compare(0, 14, "--road-speeds=") == 0)
+        {
+            RoadSpeeds speeds;
+            if (!parseRoadSpeeds(arg.substr(14), speeds))
+            {
+                cout << "Bad road speeds " << arg.substr(14) << " (use five mph, freeway first: 60,45,35,30,25)" << endl;
+                return 1;
+            }
+            setRoadSpeeds(speeds);
+        }
+        else if (arg.compare(0, 15, "--road-weights=") == 0)
+        {
+            RoadWeights weights;
+            if (!parseRoadWeights(arg.substr(15), weights))
+            {
+                cout << "Bad road weights " << arg.substr(15) << " (use five per-mile weights, freeway first: 1,1,1.2,1.5,2)" << endl;
+                return 1;
+            }
+            setCustomRoadWeights(weights);
+        }
+        else if (arg.compare(0, 9, "--client=") == 0)
+            return runQueryClient(arg.substr(9));
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != (serve ? 1 : 2))
+    {
+        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt [--format=text|json|binary] [--stream] [--stats] [--record=log] [--compact] [--hub-labels] [--turn-costs] [--fast-distance] [--tile-cache=N] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W]" << endl;
+        cout << "       " << argv[0] << " mapdata.txt --serve [--socket=path] [--threads=N] [--record=log] [--compact] [--hub-labels] [--turn-costs] [--fast-distance] [--tile-cache=N] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W]" << endl;
+        cout << "       " << argv[0] << " --client=path" << endl;
         return 1;
     }
 
+    QueryLog queryLog;
+    if (!recordPath.empty())
+    {
+        if (!queryLog.open(recordPath))
+        {
+            cout << "Unable to create query log " << recordPath << endl;
+            return 1;
+        }
+        setQueryLog(&queryLog);
+    }
+
+    if (serve)
+    {
+        VersionedStreetMap maps;
+        if (!maps.load(files[0]))
+        {
+            cout << "Unable to load map data file " << files[0] << endl;
+            return 1;
+        }
+        QueryServer server(&maps, numThreads);
+        if (socketPath.empty())
+            server.serve(cin, cout);
+        else if (!server.serveSocket(socketPath))
+            return 1;
+        return 0;
+    }
+
     StreetMap sm;
         
-    if (!sm.load(argv[1]))
+    if (!sm.load(files[0]))
     {
-        cout << "Unable to load map data file " << argv[1] << endl;
+        cout << "Unable to load map data file " << files[0] << endl;
         return 1;
     }
 
     GeoCoord depot;
     vector<DeliveryRequest> deliveries;
-    if (!loadDeliveryRequests(argv[2], depot, deliveries))
+    if (!loadDeliveryRequests(files[1], depot, deliveries))
     {
-        cout << "Unable to load delivery request file " << argv[2] << endl;
+        cout << "Unable to load delivery request file " << files[1] << endl;
         return 1;
     }
 
-    cout << "Generating route...\n\n";
+    if (format == CommandWriter::TEXT)
+        cout << "Generating route...\n\n";
     
     
     DeliveryPlanner dp(&sm);
-    vector<DeliveryCommand> dcs;
+    CompactCommandList dcs;
     double totalMiles;
-    DeliveryResult result = dp.generateDeliveryPlan(depot, deliveries, dcs, totalMiles);
+    CommandWriter writer(cout, format);
+    DeliveryResult result;
+    bool begun = false;
+    try
+    {
+        if (stream)                                                         // write each leg as soon as it is planned
+        {
+            auto writeLeg = [&](int, double, int firstCommand, int endCommand)
+            {
+                if (!begun)
+                    writer.beginPlan();
+                begun = true;
+                for (int i = firstCommand; i < endCommand; i++)
+                    writer.write(dcs, i);
+                writer.flush();
+            };
+            result = dp.streamDeliveryPlan(depot, deliveries, dcs, writeLeg, totalMiles);
+        }
+        else
+            result = dp.generateDeliveryPlan(depot, deliveries, dcs, totalMiles);
+    }
+    catch (const exception& e)                                              // a corrupt tile in a tile file, say
+    {
+        cout << "Error: " << e.what() << endl;
+        return 1;
+    }
     if (result == BAD_COORD)
     {
         cout << "One or more depot or delivery coordinates are invalid." << endl;
@@ -52,13 +208,20 @@ int main(int argc, char *argv[])
         cout << "No route can be found to deliver all items." << endl;
         return 1;
     }
-    cout << "Starting at the depot...\n";
-    for (const auto& dc : dcs)
-        cout << dc.description() << endl;
-    cout << "You are back at the depot and your deliveries are done!\n";
-    cout.setf(ios::fixed);
-    cout.precision(2);
-    cout << totalMiles << " miles travelled for all deliveries." << endl;
+    if (!begun)
+    {
+        writer.beginPlan();
+        writer.write(dcs);
+    }
+    writer.endPlan(totalMiles);
+    writer.flush();
+    if (showStats)
+    {
+        if (statsEnabled())
+            threadStats().print(cerr);
+        else
+            cerr << "Stats are not compiled into this build; rebuild with -DDELIVERY_STATS" << endl;
+    }
 }
 
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
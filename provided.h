@@ -1,13 +1,14 @@
 #ifndef PROVIDED_INCLUDED
 #define PROVIDED_INCLUDED
 
-// YOU MUST MAKE NO CHANGES TO THIS FILE!
-
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <list>
+#include <memory>
 
 enum DeliveryResult
 {
@@ -30,6 +31,13 @@ struct GeoCoord
     double      longitude;
 };
 
+  // A position as numbers only, for geometry that never needs the text
+struct GeoPoint
+{
+    double latitude;
+    double longitude;
+};
+
 inline
 bool operator==(const GeoCoord& lhs, const GeoCoord& rhs)
 {
@@ -53,16 +61,18 @@ bool operator<(const GeoCoord& lhs, const GeoCoord& rhs)
 
 struct StreetSegment
 {
-    StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName)
-     : start(s), end(e), name(streetName)
+    StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName, int streetNameId = -1)
+     : start(s), end(e), name(streetName), nameId(streetNameId)
     {}
 
     StreetSegment()
+     : nameId(-1)
     {}
 
     GeoCoord start;
     GeoCoord end;
     std::string name;
+    int nameId;      // the map's id for name (equal names, equal ids), or -1 if unknown
 };
 
 inline
@@ -71,7 +81,25 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
     return lhs.start == rhs.start  &&  lhs.end == rhs.end;
 }
 
+  // A change to the street between two adjacent intersections, for
+  // StreetMap::updateEdges: its length for routing is multiplied by factor
+  // (congestion; 1 restores the map's length), or it is closed outright.
+struct EdgeUpdate
+{
+    GeoCoord from;
+    GeoCoord to;
+    double   factor = 1;
+    bool     closed = false;
+    bool     bothWays = true;       // to -> from changes too
+};
+
 class StreetMapImpl;
+class StreetGraph;
+class TiledMap;
+class CompactGraph;
+class HubLabels;
+class TurnGraph;
+class EdgeWeights;
 
 class StreetMap
 {
@@ -80,15 +108,69 @@ public:
     ~StreetMap();
     bool load(std::string mapFile);
     bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+      // connected component of the intersection at gc (-1 if gc is not on the map);
+      // a route between two intersections exists exactly when these match
+      // (with updates in effect, only if they match)
+    int componentOf(const GeoCoord& gc) const;
+      // intersections are numbered 0 .. numIntersections()-1 along a Hilbert
+      // curve; these are the node ids of graph()
+    int numIntersections() const;
+    GeoCoord intersection(int id) const;
+    int intersectionId(const GeoCoord& gc) const;       // -1 if gc is not an intersection
+      // the network by node id, for searches (StreetGraph.h); empty when
+      // the map was loaded from a tile file, whose tiles() are used instead,
+      // or kept compact (CompactGraph.h), when compactGraph() is used
+    const StreetGraph& graph() const;
+    const TiledMap* tiles() const;
+    const CompactGraph* compactGraph() const;
+      // road distances between intersections, if the map was loaded with
+      // hub labels switched on (HubLabels.h) and no updates are in effect
+    const HubLabels* hubLabels() const;
+      // per-edge turn data, if the map was loaded with turn costs switched on
+      // (TurnGraph.h); routes over the graph or compact form then include them
+    const TurnGraph* turnGraph() const;
+      // the road class (RouteCosts.h) of each street name id of the form the
+      // map is kept in: graph(), tiles() or compactGraph()
+    const uint8_t* roadClasses() const;
+      // reweights or closes streets for routing, on top of earlier updates,
+      // without reloading; false, changing nothing, if an update does not name
+      // a street or the map is tiled (EdgeWeights.h).  Not while this map is
+      // being queried; a map in service is updated through VersionedStreetMap.
+    bool updateEdges(const std::vector<EdgeUpdate>& updates);
+      // makes this map share base's loaded streets, with base's updates and
+      // then these in effect; base may go away first
+    bool loadUpdated(const StreetMap& base, const std::vector<EdgeUpdate>& updates);
+      // the updates in effect, or null when the streets are as loaded
+    const EdgeWeights* edgeWeights() const;
       // We prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
 private:
-    StreetMapImpl* m_impl;
+    std::shared_ptr<StreetMapImpl> m_impl;              // shared by maps made with loadUpdated
+    std::shared_ptr<const EdgeWeights> m_weights;
 };
 
 class PointToPointRouterImpl;
 
+  // A route as edge ids of the network the map is kept in (graph()'s, which
+  // the compact form keeps, or the tiles'), from its start, with its road miles
+struct EdgeRoute
+{
+    std::vector<int> edges;
+    double distance = 0;
+};
+
+  // What makes an alternative route worth offering, relative to the shortest
+  // route's cost: it costs at most maxStretch times as much, shares at most
+  // maxSharing of that cost with routes already chosen, and a stretch of it
+  // at least minLocalOptimality of that cost long is itself a shortest path.
+struct AlternativeRouteLimits
+{
+    double maxStretch = 1.25;
+    double maxSharing = 0.8;
+    double minLocalOptimality = 0.25;
+};
+
 class PointToPointRouter
 {
 public:
@@ -99,6 +181,24 @@ public:
         const GeoCoord& end,
         std::list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+      // The same route as its vertices, start to end, read straight off the
+      // search without building segments or coordinate text (see Polyline.h).
+    DeliveryResult generateRouteGeometry(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        std::vector<GeoPoint>& points,
+        double& totalDistanceTravelled) const;
+      // The shortest route and up to maxRoutes-1 alternatives to it, best
+      // first, from one forward and one backward search.
+    DeliveryResult generateAlternativeRoutes(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        int maxRoutes,
+        std::vector<EdgeRoute>& routes,
+        const AlternativeRouteLimits& limits = AlternativeRouteLimits()) const;
+      // the segments of a route from generateAlternativeRoutes; BAD_COORD if
+      // start is not an intersection
+    DeliveryResult expandRoute(const GeoCoord& start, const EdgeRoute& route, std::list<StreetSegment>& segments) const;
       // We prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -208,7 +308,35 @@ private:
     double       m_distance;    // 1.92 (in miles)
 };
 
+  // A routed plan that can be edited without replanning from scratch.
+  // legs[i] runs to deliveries[i] and ends with its DELIVER command; the
+  // last leg returns to the depot, so there is one more leg than delivery.
+struct DeliveryLeg
+{
+    std::list<StreetSegment>     route;
+    double                       distance;
+    std::vector<DeliveryCommand> commands;
+};
+
+struct DeliveryPlan
+{
+    GeoCoord                     depot;
+    GeoCoord                     start;         // current position; the depot until moved
+    std::vector<DeliveryRequest> deliveries;    // remaining stops, in visiting order
+    std::vector<DeliveryLeg>     legs;
+    double                       totalDistanceTravelled;
+
+      // every leg's commands, in order
+    void allCommands(std::vector<DeliveryCommand>& commands) const;
+};
+
 class DeliveryPlannerImpl;
+class CompactCommandList;
+
+  // Called with each leg of a streamed plan, in order: the leg's index, its
+  // miles, and the range [firstCommand, endCommand) of its commands in the
+  // list being filled.
+typedef std::function<void(int leg, double distance, int firstCommand, int endCommand)> LegReadyCallback;
 
 class DeliveryPlanner
 {
@@ -220,6 +348,33 @@ public:
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        CompactCommandList& commands,
+        double& totalDistanceTravelled) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        DeliveryPlan& plan) const;
+      // Plans like generateDeliveryPlan, but as a pipeline: the order is
+      // optimized, routeThreads threads route the legs (earliest first), and
+      // this thread turns each routed leg into commands and hands it to
+      // legReady as soon as every leg before it is done, so the first
+      // instructions are out long before the last leg is routed.  On failure
+      // the legs before the failing one have already been handed over.
+    DeliveryResult streamDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        CompactCommandList& commands,
+        const LegReadyCallback& legReady,
+        double& totalDistanceTravelled,
+        int routeThreads = 1) const;
+      // Edits to an existing plan.  Only the legs next to the edit are rerouted;
+      // if one of them fails the plan is left as it was.
+    DeliveryResult addDelivery(DeliveryPlan& plan, const DeliveryRequest& delivery) const;
+    DeliveryResult removeDelivery(DeliveryPlan& plan, int deliveryIndex) const;
+    DeliveryResult moveStart(DeliveryPlan& plan, const GeoCoord& position) const;
       // We prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;
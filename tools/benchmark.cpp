@@ -0,0 +1,361 @@
+// benchmark.cpp
+
+// Routing and planning benchmarks over a map file.  Every random choice comes
+// from one seeded generator, so two builds run on the same inputs.  Results
+// are written as a single JSON object for tracking regressions.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o benchmark tools/benchmark.cpp $(ls *.cpp | grep -v main.cpp)
+// Run:
+//   ./benchmark mapdata.txt [--seed=N] [--repeats=N] [--pairs=N] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W] [--out=results.json]
+
+#include "../provided.h"
+#include "../ExpandableHashMap.h"
+#include "../CommandWriter.h"
+#include "../RouteCosts.h"
+#include "../RouteQueues.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+using namespace std;
+
+namespace
+{
+    typedef chrono::steady_clock Clock;
+
+    double msSince(Clock::time_point begin)
+    {
+        return chrono::duration<double, milli>(Clock::now() - begin).count();
+    }
+
+    long peakRssKb()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;      // bytes on macOS
+#else
+        return usage.ru_maxrss;             // kilobytes on Linux
+#endif
+    }
+
+    double percentile(vector<double> v, double p)
+    {
+        if (v.empty())
+            return 0;
+        sort(v.begin(), v.end());
+        size_t i = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+        return v[i];
+    }
+
+    double mean(const vector<double>& v)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < v.size(); i++)
+            sum += v[i];
+        return v.empty() ? 0 : sum / v.size();
+    }
+
+      // crow-flies length of depot -> deliveries in order -> depot
+    double crowTour(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+    {
+        double total = 0;
+        GeoCoord at = depot;
+        for (size_t i = 0; i < deliveries.size(); i++)
+        {
+            total += distanceEarthMiles(at, deliveries[i].location);
+            at = deliveries[i].location;
+        }
+        return total + distanceEarthMiles(at, depot);
+    }
+
+    struct Options
+    {
+        string mapFile;
+        unsigned seed = 1;
+        int repeats = 3;
+        int pairsPerBand = 200;
+        string outFile;
+    };
+
+    void benchLoad(const Options& opt, ostream& out)
+    {
+        long rssBefore = peakRssKb();
+        vector<double> times;
+        for (int r = 0; r < opt.repeats; r++)
+        {
+            Clock::time_point begin = Clock::now();
+            StreetMap sm;
+            sm.load(opt.mapFile);
+            times.push_back(msSince(begin));
+        }
+        out << "\"load\":{\"runs\":" << times.size()
+            << ",\"min_ms\":" << *min_element(times.begin(), times.end())
+            << ",\"mean_ms\":" << mean(times)
+            << ",\"peak_rss_kb\":" << peakRssKb()
+            << ",\"peak_rss_growth_kb\":" << peakRssKb() - rssBefore << "}";
+    }
+
+    void benchPointToPoint(const Options& opt, const StreetMap& sm, mt19937& rng, ostream& out)
+    {
+        static const double bands[][2] = { { 0, 0.5 }, { 0.5, 1.5 }, { 1.5, 3 }, { 3, 1e9 } };
+        const int numBands = sizeof(bands) / sizeof(bands[0]);
+        vector<vector<pair<GeoCoord, GeoCoord> > > pairs(numBands);
+        uniform_int_distribution<int> pick(0, sm.numIntersections() - 1);
+        long attempts = static_cast<long>(opt.pairsPerBand) * numBands * 200;
+        for (long a = 0; a < attempts; a++)
+        {
+            GeoCoord from = sm.intersection(pick(rng));
+            GeoCoord to = sm.intersection(pick(rng));
+            double crow = distanceEarthMiles(from, to);
+            for (int b = 0; b < numBands; b++)
+                if (crow >= bands[b][0] && crow < bands[b][1] && static_cast<int>(pairs[b].size()) < opt.pairsPerBand)
+                    pairs[b].push_back(make_pair(from, to));
+        }
+
+        PointToPointRouter router(&sm);
+        out << "\"point_to_point\":[";
+        for (int b = 0; b < numBands; b++)
+        {
+            vector<double> latencies;
+            int noRoute = 0;
+            double routedMiles = 0;
+            for (size_t i = 0; i < pairs[b].size(); i++)
+            {
+                list<StreetSegment> route;
+                double miles = 0;
+                Clock::time_point begin = Clock::now();
+                DeliveryResult result = router.generatePointToPointRoute(pairs[b][i].first, pairs[b][i].second, route, miles);
+                latencies.push_back(msSince(begin));
+                if (result == NO_ROUTE)
+                    noRoute++;
+                routedMiles += miles;
+            }
+            out << (b > 0 ? "," : "") << "{\"min_crow_miles\":" << bands[b][0]
+                << ",\"max_crow_miles\":" << (bands[b][1] < 1e9 ? bands[b][1] : -1)
+                << ",\"queries\":" << latencies.size()
+                << ",\"no_route\":" << noRoute
+                << ",\"p50_ms\":" << percentile(latencies, 0.5)
+                << ",\"p99_ms\":" << percentile(latencies, 0.99)
+                << ",\"mean_ms\":" << mean(latencies)
+                << ",\"routed_miles\":" << routedMiles << "}";
+        }
+        out << "]";
+    }
+
+    void benchHashMap(const Options& opt, const StreetMap& sm, ostream& out)
+    {
+        vector<GeoCoord> keys;
+        vector<GeoCoord> missing;
+        for (int i = 0; i < sm.numIntersections(); i++)
+        {
+            keys.push_back(sm.intersection(i));
+            missing.push_back(GeoCoord(keys.back().longitudeText, keys.back().latitudeText));
+        }
+        vector<double> insertMs, hitMs, missMs;
+        long found = 0;
+        for (int r = 0; r < opt.repeats; r++)
+        {
+            ExpandableHashMap<GeoCoord, int> map;
+            Clock::time_point begin = Clock::now();
+            for (size_t i = 0; i < keys.size(); i++)
+                map.associate(keys[i], static_cast<int>(i));
+            insertMs.push_back(msSince(begin));
+            begin = Clock::now();
+            for (size_t i = 0; i < keys.size(); i++)
+                found += map.find(keys[i]) != nullptr;
+            hitMs.push_back(msSince(begin));
+            begin = Clock::now();
+            for (size_t i = 0; i < missing.size(); i++)
+                found += map.find(missing[i]) != nullptr;
+            missMs.push_back(msSince(begin));
+        }
+        double n = static_cast<double>(keys.size());
+        out << "\"hash_map\":{\"keys\":" << keys.size()
+            << ",\"insert_per_sec\":" << n / (*min_element(insertMs.begin(), insertMs.end()) / 1000)
+            << ",\"find_hit_per_sec\":" << n / (*min_element(hitMs.begin(), hitMs.end()) / 1000)
+            << ",\"find_miss_per_sec\":" << n / (*min_element(missMs.begin(), missMs.end()) / 1000)
+            << ",\"found\":" << found << "}";
+    }
+
+      // a depot and numStops deliveries drawn from the depot's component
+    void makeManifest(const StreetMap& sm, mt19937& rng, int numStops, GeoCoord& depot, vector<DeliveryRequest>& deliveries)
+    {
+        uniform_int_distribution<int> pick(0, sm.numIntersections() - 1);
+        vector<int> componentSize;
+        for (int i = 0; i < sm.numIntersections(); i++)
+        {
+            int c = sm.componentOf(sm.intersection(i));
+            if (c >= static_cast<int>(componentSize.size()))
+                componentSize.resize(c + 1, 0);
+            componentSize[c]++;
+        }
+        int biggest = static_cast<int>(max_element(componentSize.begin(), componentSize.end()) - componentSize.begin());
+        do
+            depot = sm.intersection(pick(rng));
+        while (sm.componentOf(depot) != biggest);
+        deliveries.clear();
+        while (static_cast<int>(deliveries.size()) < numStops)
+        {
+            GeoCoord gc = sm.intersection(pick(rng));
+            if (sm.componentOf(gc) == biggest)
+                deliveries.push_back(DeliveryRequest("item" + to_string(deliveries.size()), gc));
+        }
+    }
+
+    void benchPlans(const Options& opt, const StreetMap& sm, mt19937& rng, ostream& out)
+    {
+        static const int sizes[] = { 5, 50, 500 };
+        DeliveryOptimizer optimizer(&sm);
+        DeliveryPlanner planner(&sm);
+        ostringstream optimizerOut;
+        ostringstream plannerOut;
+        for (int s = 0; s < 3; s++)
+        {
+            GeoCoord depot;
+            vector<DeliveryRequest> deliveries;
+            makeManifest(sm, rng, sizes[s], depot, deliveries);
+
+            vector<double> optimizeMs;
+            double before = crowTour(depot, deliveries);
+            double after = before;
+            for (int r = 0; r < opt.repeats; r++)
+            {
+                vector<DeliveryRequest> order = deliveries;
+                double oldCrow, newCrow;
+                Clock::time_point begin = Clock::now();
+                optimizer.optimizeDeliveryOrder(depot, order, oldCrow, newCrow);
+                optimizeMs.push_back(msSince(begin));
+                after = crowTour(depot, order);
+            }
+            optimizerOut << (s > 0 ? "," : "") << "{\"stops\":" << sizes[s]
+                << ",\"min_ms\":" << *min_element(optimizeMs.begin(), optimizeMs.end())
+                << ",\"crow_before_miles\":" << before
+                << ",\"crow_after_miles\":" << after
+                << ",\"quality_ratio\":" << (before > 0 ? after / before : 1) << "}";
+
+            vector<double> planMs;
+            double miles = 0;
+            int commands = 0;
+            DeliveryResult result = DELIVERY_SUCCESS;
+            for (int r = 0; r < opt.repeats; r++)
+            {
+                CompactCommandList dcs;
+                Clock::time_point begin = Clock::now();
+                result = planner.generateDeliveryPlan(depot, deliveries, dcs, miles);
+                planMs.push_back(msSince(begin));
+                commands = dcs.size();
+            }
+            plannerOut << (s > 0 ? "," : "") << "{\"stops\":" << sizes[s]
+                << ",\"result\":\"" << (result == DELIVERY_SUCCESS ? "success" : result == NO_ROUTE ? "no_route" : "bad_coord") << "\""
+                << ",\"min_ms\":" << *min_element(planMs.begin(), planMs.end())
+                << ",\"mean_ms\":" << mean(planMs)
+                << ",\"miles\":" << miles
+                << ",\"commands\":" << commands << "}";
+        }
+        out << "\"optimizer\":[" << optimizerOut.str() << "],\"plan\":[" << plannerOut.str() << "]";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 7, "--seed=") == 0)
+            opt.seed = static_cast<unsigned>(strtoul(arg.c_str() + 7, nullptr, 10));
+        else if (arg.compare(0, 10, "--repeats=") == 0)
+            opt.repeats = max(1, atoi(arg.c_str() + 10));
+        else if (arg.compare(0, 8, "--pairs=") == 0)
+            opt.pairsPerBand = max(1, atoi(arg.c_str() + 8));
+        else if (arg.compare(0, 14, "--route-queue=") == 0)
+        {
+            RouteQueue queue;
+            if (!parseRouteQueue(arg.substr(14), queue))
+            {
+                cerr << "Unknown route queue " << arg.substr(14) << " (use fifo, heap, radix or buckets)" << endl;
+                return 1;
+            }
+            setRouteQueue(queue);
+        }
+        else if (arg.compare(0, 13, "--route-cost=") == 0)
+        {
+            RouteCost cost;
+            if (!parseRouteCost(arg.substr(13), cost))
+            {
+                cerr << "Unknown route cost " << arg.substr(13) << " (use distance, time or custom)" << endl;
+                return 1;
+            }
+            setRouteCost(cost);
+        }
+        else if (arg.compare(0, 14, "--road-speeds=") == 0)
+        {
+            RoadSpeeds speeds;
+            if (!parseRoadSpeeds(arg.substr(14), speeds))
+            {
+                cerr << "Bad road speeds " << arg.substr(14) << " (use five mph, freeway first: 60,45,35,30,25)" << endl;
+                return 1;
+            }
+            setRoadSpeeds(speeds);
+        }
+        else if (arg.compare(0, 15, "--road-weights=") == 0)
+        {
+            RoadWeights weights;
+            if (!parseRoadWeights(arg.substr(15), weights))
+            {
+                cerr << "Bad road weights " << arg.substr(15) << " (use five per-mile weights, freeway first: 1,1,1.2,1.5,2)" << endl;
+                return 1;
+            }
+            setCustomRoadWeights(weights);
+        }
+        else if (arg.compare(0, 6, "--out=") == 0)
+            opt.outFile = arg.substr(6);
+        else
+            opt.mapFile = arg;
+    }
+    if (opt.mapFile.empty())
+    {
+        cerr << "Usage: " << argv[0] << " mapdata.txt [--seed=N] [--repeats=N] [--pairs=N] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W] [--out=results.json]" << endl;
+        return 1;
+    }
+
+    ostringstream out;
+    out << "{\"map\":\"" << opt.mapFile << "\",\"seed\":" << opt.seed << ",\"repeats\":" << opt.repeats
+        << ",\"route_queue\":\"" << routeQueueName(routeQueue()) << "\",\"route_cost\":\"" << routeCostName(routeCost()) << "\",";
+    benchLoad(opt, out);
+    StreetMap sm;
+    if (!sm.load(opt.mapFile) || sm.numIntersections() == 0)
+    {
+        cerr << "Unable to load map data file " << opt.mapFile << endl;
+        return 1;
+    }
+    mt19937 rng(opt.seed);
+    out << ",";
+    benchPointToPoint(opt, sm, rng, out);
+    out << ",";
+    benchHashMap(opt, sm, out);
+    out << ",";
+    benchPlans(opt, sm, rng, out);
+    out << "}\n";
+
+    if (opt.outFile.empty())
+        cout << out.str();
+    else
+    {
+        ofstream file(opt.outFile);
+        if (!(file << out.str()))
+        {
+            cerr << "Cannot write " << opt.outFile << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
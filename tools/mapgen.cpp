@@ -0,0 +1,370 @@
+// mapgen.cpp
+
+// Synthetic map generator for scaling tests.  Writes a map in the same text
+// format as mapdata.txt, plus a matching deliveries file.
+//
+// The map is a set of city cores laid out on a coarse lattice.  Each core is a
+// jittered street grid; neighboring cores are joined by boulevards, one
+// freeway crosses the whole region, and a river splits the cores into two
+// halves crossed only by bridges and the freeway.  Cul-de-sacs hang off the
+// edges of each grid, and small service-road fragments are not connected to
+// anything.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o mapgen tools/mapgen.cpp
+// Run:
+//   ./mapgen --segments=1000000 --deliveries=500 --map=big_map.txt --out=big_deliveries.txt [--seed=N]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    struct Point
+    {
+        double lat;
+        double lon;
+    };
+
+    struct Street
+    {
+        string name;
+        vector<Point> points;       // segments join consecutive points
+    };
+
+    const double ORIGIN_LAT = 33.80;
+    const double ORIGIN_LON = -118.90;
+    const double GRID_LAT = 0.0009;         // about 100 meters between intersections
+    const double GRID_LON = 0.0011;
+
+    const char* const TOWNS[] = {
+        "Westwood", "Brentwood", "Palms", "Sawtelle", "Mar Vista", "Venice", "Culver", "Rancho Park",
+        "Cheviot", "Beverlywood", "Encino", "Tarzana", "Reseda", "Van Nuys", "Sherman Oaks", "Studio City"
+    };
+    const int NUM_TOWNS = sizeof(TOWNS) / sizeof(TOWNS[0]);
+
+    string ordinal(int n)
+    {
+        const char* suffix = "th";
+        if (n % 100 < 11 || n % 100 > 13)
+        {
+            if (n % 10 == 1)
+                suffix = "st";
+            else if (n % 10 == 2)
+                suffix = "nd";
+            else if (n % 10 == 3)
+                suffix = "rd";
+        }
+        return to_string(n) + suffix;
+    }
+
+    string townName(int core)
+    {
+        string name = TOWNS[core % NUM_TOWNS];
+        if (core >= NUM_TOWNS)
+            name = "New " + name + " " + string(1, static_cast<char>('A' + (core / NUM_TOWNS - 1) % 26)) + "town";
+        return name;
+    }
+
+      // deterministic jitter in [-0.2, 0.2] of a grid step, so a shared
+      // intersection gets the same coordinates from both of its streets
+    double jitter(uint64_t a, uint64_t b, uint64_t c, uint64_t seed)
+    {
+        uint64_t h = seed ^ (a * 0x9e3779b97f4a7c15ULL) ^ (b * 0xc2b2ae3d27d4eb4fULL) ^ (c * 0x165667b19e3779f9ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return (static_cast<double>(h % 10001) / 10000.0 - 0.5) * 0.4;
+    }
+
+    class Generator
+    {
+    public:
+        Generator(long targetSegments, unsigned seed)
+         : m_seed(seed), m_rng(seed)
+        {
+            long gridSegments = max(4L, targetSegments * 85 / 100);
+            m_numCores = max(1, static_cast<int>(gridSegments / 40000));
+            m_side = max(2, static_cast<int>(sqrt(gridSegments / (2.0 * m_numCores))));
+            m_coresPerRow = max(1, static_cast<int>(ceil(sqrt(static_cast<double>(m_numCores)))));
+              // keep the text widths of mapdata.txt: 2-digit latitudes, 3-digit longitudes
+            double extent = (m_coresPerRow * (m_side + m_side / 2 + 4)) * GRID_LAT;
+            m_scale = extent > 5.5 ? 5.5 / extent : 1;
+        }
+
+        void generate(long targetSegments)
+        {
+            for (int core = 0; core < m_numCores; core++)
+                addGrid(core);
+            addConnections();
+            long segments = countSegments();
+            long extra = max(0L, targetSegments - segments);
+            for (long added = 0; added < extra * 2 / 3; )
+                added += addCulDeSac();
+            for (long added = 0; added < extra / 3; )
+                added += addFragment();
+        }
+
+        long countSegments() const
+        {
+            long n = 0;
+            for (size_t i = 0; i < m_streets.size(); i++)
+                n += m_streets[i].points.size() - 1;
+            return n;
+        }
+
+        bool writeMap(const string& file) const
+        {
+            FILE* out = fopen(file.c_str(), "w");
+            if (out == nullptr)
+                return false;
+            static char buffer[1 << 16];
+            setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+            for (size_t i = 0; i < m_streets.size(); i++)
+            {
+                const Street& s = m_streets[i];
+                fprintf(out, "%s\n%d\n", s.name.c_str(), static_cast<int>(s.points.size() - 1));
+                for (size_t p = 0; p + 1 < s.points.size(); p++)
+                    fprintf(out, "%.7f %.7f %.7f %.7f\n", s.points[p].lat, s.points[p].lon, s.points[p + 1].lat, s.points[p + 1].lon);
+            }
+            return fclose(out) == 0;
+        }
+
+          // depot and deliveries on connected grid intersections, plus
+          // numUnreachable deliveries on disconnected fragments
+        bool writeDeliveries(const string& file, int numDeliveries, int numUnreachable)
+        {
+            FILE* out = fopen(file.c_str(), "w");
+            if (out == nullptr)
+                return false;
+            uniform_int_distribution<int> core(0, m_numCores - 1);
+            uniform_int_distribution<int> cell(0, m_side - 1);
+            Point depot = gridPoint(core(m_rng), cell(m_rng), cell(m_rng));
+            fprintf(out, "%.7f %.7f\n", depot.lat, depot.lon);
+            for (int i = 0; i < numDeliveries; i++)
+            {
+                Point p = gridPoint(core(m_rng), cell(m_rng), cell(m_rng));
+                fprintf(out, "%.7f %.7f:Package %d\n", p.lat, p.lon, i + 1);
+            }
+            for (int i = 0; i < numUnreachable && !m_fragmentPoints.empty(); i++)
+            {
+                const Point& p = m_fragmentPoints[m_rng() % m_fragmentPoints.size()];
+                fprintf(out, "%.7f %.7f:Unreachable package %d\n", p.lat, p.lon, i + 1);
+            }
+            return fclose(out) == 0;
+        }
+
+    private:
+        unsigned m_seed;
+        mt19937 m_rng;
+        int m_numCores;
+        int m_side;                 // intersections along each side of a core grid
+        int m_coresPerRow;
+        double m_scale;
+        vector<Street> m_streets;
+        vector<Point> m_fragmentPoints;
+        int m_numFragments = 0;
+
+        double coreStep() const { return m_side + m_side / 2 + 4; }
+
+        Point gridPoint(int core, int row, int col) const
+        {
+            int coreRow = core / m_coresPerRow;
+            int coreCol = core % m_coresPerRow;
+            double r = coreRow * coreStep() + row + jitter(core, row, col, m_seed);
+            double c = coreCol * coreStep() + col + jitter(col, core, row, m_seed);
+            if (coreCol >= (m_coresPerRow + 1) / 2)         // the river runs between the two halves
+                c += 3;
+            Point p = { ORIGIN_LAT + r * GRID_LAT * m_scale, ORIGIN_LON + c * GRID_LON * m_scale };
+            return p;
+        }
+
+        void addGrid(int core)
+        {
+            string town = townName(core);
+            for (int col = 0; col < m_side; col++)
+            {
+                Street s;
+                s.name = town + " " + ordinal(col + 1) + ((col % 8 == 4) ? " Drive" : " Avenue");
+                for (int row = 0; row < m_side; row++)
+                    s.points.push_back(gridPoint(core, row, col));
+                m_streets.push_back(s);
+            }
+            for (int row = 0; row < m_side; row++)
+            {
+                Street s;
+                s.name = town + " " + ordinal(row + 1) + " Street";
+                for (int col = 0; col < m_side; col++)
+                    s.points.push_back(gridPoint(core, row, col));
+                m_streets.push_back(s);
+            }
+        }
+
+          // boulevards between neighboring cores, bridges over the river, and a freeway
+        void addConnections()
+        {
+            int mid = m_side / 2;
+            int half = (m_coresPerRow + 1) / 2;
+            for (int core = 0; core < m_numCores; core++)
+            {
+                int coreCol = core % m_coresPerRow;
+                int east = core + 1;
+                if (coreCol + 1 < m_coresPerRow && east < m_numCores)
+                {
+                    bool crossesRiver = coreCol + 1 == half;
+                    int row = crossesRiver ? (core % 2 == 0 ? mid : mid / 2) : mid;
+                    Street s;
+                    s.name = townName(core) + (crossesRiver ? " Bridge" : " Boulevard");
+                    s.points.push_back(gridPoint(core, row, m_side - 1));
+                    if (!crossesRiver)
+                        addMidpoints(s.points, gridPoint(east, row, 0), 4);
+                    s.points.push_back(gridPoint(east, row, 0));
+                    m_streets.push_back(s);
+                }
+                int north = core + m_coresPerRow;
+                if (north < m_numCores)
+                {
+                    Street s;
+                    s.name = townName(core) + " Canyon Boulevard";
+                    s.points.push_back(gridPoint(core, m_side - 1, mid));
+                    addMidpoints(s.points, gridPoint(north, 0, mid), 4);
+                    s.points.push_back(gridPoint(north, 0, mid));
+                    m_streets.push_back(s);
+                }
+            }
+            if (m_numCores > 1)
+            {
+                Street s;
+                s.name = "Pacific Freeway";
+                for (int core = 0; core < m_numCores; core++)
+                {
+                    if (core > 0)
+                        addMidpoints(s.points, gridPoint(core, 0, 0), 2);
+                    s.points.push_back(gridPoint(core, 0, 0));
+                }
+                m_streets.push_back(s);
+            }
+        }
+
+          // points evenly spaced from the last point of line toward end, not including end
+        void addMidpoints(vector<Point>& line, const Point& end, int count)
+        {
+            Point start = line.back();
+            for (int i = 1; i <= count; i++)
+            {
+                double t = static_cast<double>(i) / (count + 1);
+                Point p = { start.lat + (end.lat - start.lat) * t, start.lon + (end.lon - start.lon) * t };
+                line.push_back(p);
+            }
+        }
+
+          // a short dead end leaving the outside edge of a grid; returns its segment count
+        long addCulDeSac()
+        {
+            uniform_int_distribution<int> core(0, m_numCores - 1);
+            uniform_int_distribution<int> cell(0, m_side - 1);
+            int c = core(m_rng);
+            int side = m_rng() % 4;
+            int along = cell(m_rng);
+            int row = side == 0 ? 0 : side == 1 ? m_side - 1 : along;
+            int col = side == 2 ? 0 : side == 3 ? m_side - 1 : along;
+            double dLat = side == 0 ? -1 : side == 1 ? 1 : 0;
+            double dLon = side == 2 ? -1 : side == 3 ? 1 : 0;
+            int length = 1 + m_rng() % 3;
+            Street s;
+            s.name = townName(c) + " " + ordinal(row * m_side + col + 1) + " Court";
+            s.points.push_back(gridPoint(c, row, col));
+            for (int i = 1; i <= length; i++)
+            {
+                double step = 0.25 * i + 0.01 * (m_rng() % 7);
+                Point p = { s.points[0].lat + dLat * step * GRID_LAT * m_scale, s.points[0].lon + dLon * step * GRID_LON * m_scale };
+                if (dLat == 0)
+                    p.lat += 0.05 * i * GRID_LAT * m_scale;
+                else
+                    p.lon += 0.05 * i * GRID_LON * m_scale;
+                s.points.push_back(p);
+            }
+            m_streets.push_back(s);
+            return length;
+        }
+
+          // a small 3x3 service-road grid that touches nothing else; returns its segment count
+        long addFragment()
+        {
+            int f = m_numFragments++;
+            double baseLat = ORIGIN_LAT - 0.05 - (f / 100) * 4 * GRID_LAT * m_scale;
+            double baseLon = ORIGIN_LON + (f % 100) * 4 * GRID_LON * m_scale;
+            Point grid[3][3];
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++)
+                {
+                    Point p = { baseLat - r * GRID_LAT * m_scale, baseLon + c * GRID_LON * m_scale };
+                    grid[r][c] = p;
+                    m_fragmentPoints.push_back(p);
+                }
+            for (int i = 0; i < 3; i++)
+            {
+                Street across;
+                across.name = "Service Road " + ordinal(f * 6 + i + 1) + " Lane";
+                Street down;
+                down.name = "Service Road " + ordinal(f * 6 + i + 4) + " Way";
+                for (int j = 0; j < 3; j++)
+                {
+                    across.points.push_back(grid[i][j]);
+                    down.points.push_back(grid[j][i]);
+                }
+                m_streets.push_back(across);
+                m_streets.push_back(down);
+            }
+            return 12;
+        }
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    long segments = 100000;
+    int deliveries = 50;
+    int unreachable = 0;
+    unsigned seed = 1;
+    string mapFile = "synthetic_map.txt";
+    string deliveriesFile = "synthetic_deliveries.txt";
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 11, "--segments=") == 0)
+            segments = max(100L, atol(arg.c_str() + 11));
+        else if (arg.compare(0, 13, "--deliveries=") == 0)
+            deliveries = max(0, atoi(arg.c_str() + 13));
+        else if (arg.compare(0, 14, "--unreachable=") == 0)
+            unreachable = max(0, atoi(arg.c_str() + 14));
+        else if (arg.compare(0, 7, "--seed=") == 0)
+            seed = static_cast<unsigned>(strtoul(arg.c_str() + 7, nullptr, 10));
+        else if (arg.compare(0, 6, "--map=") == 0)
+            mapFile = arg.substr(6);
+        else if (arg.compare(0, 6, "--out=") == 0)
+            deliveriesFile = arg.substr(6);
+        else
+        {
+            fprintf(stderr, "Usage: %s [--segments=N] [--deliveries=N] [--unreachable=N] [--seed=N] [--map=file] [--out=deliveries file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Generator gen(segments, seed);
+    gen.generate(segments);
+    if (!gen.writeMap(mapFile) || !gen.writeDeliveries(deliveriesFile, deliveries, unreachable))
+    {
+        fprintf(stderr, "Cannot write %s or %s\n", mapFile.c_str(), deliveriesFile.c_str());
+        return 1;
+    }
+    fprintf(stderr, "Wrote %ld segments to %s and %d deliveries to %s\n", gen.countSegments(), mapFile.c_str(), deliveries + unreachable, deliveriesFile.c_str());
+    return 0;
+}
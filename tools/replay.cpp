@@ -0,0 +1,266 @@
+// replay.cpp
+
+// Reruns a query log written with --record against the current build and
+// compares the outcome of every request with what was recorded: the result
+// code, the distance in miles and the size of the route or command list.
+// Reports the differences and latency histograms for the recorded and the
+// replayed run, per request kind.
+//
+// Routing settings given on the command line (the same flags as the main
+// program's) are used as given; with none, the log's first request's settings
+// are applied before the map is loaded.  Requests recorded under settings
+// other than the replay's are counted and reported, since their differences
+// may be the settings' and not the build's.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o replay tools/replay.cpp $(ls *.cpp | grep -v main.cpp)
+// Run:
+//   ./replay mapdata.txt queries.log [--repeats=N] [--show=N] [--tolerance=miles] [--compact] [--hub-labels] [--turn-costs] [--fast-distance] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W]
+
+#include "../provided.h"
+#include "../CommandWriter.h"
+#include "../QueryLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    typedef chrono::steady_clock Clock;
+
+    const int NUM_BUCKETS = 24;         // powers of two from 1 us up to ~8 s
+
+    struct Latencies
+    {
+        vector<double> ms;
+
+        double percentile(double p) const
+        {
+            if (ms.empty())
+                return 0;
+            vector<double> v(ms);
+            sort(v.begin(), v.end());
+            return v[static_cast<size_t>(p * (v.size() - 1) + 0.5)];
+        }
+
+        void histogram(long counts[NUM_BUCKETS]) const
+        {
+            fill(counts, counts + NUM_BUCKETS, 0);
+            for (size_t i = 0; i < ms.size(); i++)
+            {
+                int b = 0;
+                for (double us = ms[i] * 1000; us >= 1 && b < NUM_BUCKETS - 1; us /= 2)
+                    b++;
+                counts[b]++;
+            }
+        }
+    };
+
+    string bucketLabel(int b)
+    {
+        char label[32];
+        if (b == 0)
+            return "< 1 us";
+        double lo = 1 << (b - 1);
+        if (lo < 1000)
+            snprintf(label, sizeof(label), ">= %.0f us", lo);
+        else
+            snprintf(label, sizeof(label), ">= %.0f ms", lo / 1000);
+        return label;
+    }
+
+    void printLatencies(const char* kind, const Latencies& recorded, const Latencies& replayed)
+    {
+        if (recorded.ms.empty())
+            return;
+        printf("\n%s latency (%zu requests)        recorded     replayed\n", kind, recorded.ms.size());
+        printf("  p50                          %9.3f ms %9.3f ms\n", recorded.percentile(0.50), replayed.percentile(0.50));
+        printf("  p90                          %9.3f ms %9.3f ms\n", recorded.percentile(0.90), replayed.percentile(0.90));
+        printf("  p99                          %9.3f ms %9.3f ms\n", recorded.percentile(0.99), replayed.percentile(0.99));
+        printf("  max                          %9.3f ms %9.3f ms\n", recorded.percentile(1.0), replayed.percentile(1.0));
+        long before[NUM_BUCKETS], after[NUM_BUCKETS];
+        recorded.histogram(before);
+        replayed.histogram(after);
+        for (int b = 0; b < NUM_BUCKETS; b++)
+            if (before[b] != 0 || after[b] != 0)
+                printf("  %-12s                 %9ld    %9ld\n", bucketLabel(b).c_str(), before[b], after[b]);
+    }
+
+    const char* resultName(DeliveryResult result)
+    {
+        switch (result)
+        {
+            case DELIVERY_SUCCESS: return "DELIVERY_SUCCESS";
+            case NO_ROUTE:         return "NO_ROUTE";
+            case BAD_COORD:        return "BAD_COORD";
+        }
+        return "?";
+    }
+
+    string describe(const QueryRecord& record)
+    {
+        string s = record.options + " from " + record.start.latitudeText + "," + record.start.longitudeText;
+        if (record.kind == QueryRecord::ROUTE)
+            s += " to " + record.end.latitudeText + "," + record.end.longitudeText;
+        else
+            s += " with " + to_string(record.deliveries.size()) + " deliveries";
+        return s;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    int repeats = 1;
+    int show = 10;
+    double tolerance = 1e-9;
+    bool settingsGiven = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 10, "--repeats=") == 0)
+            repeats = max(1, atoi(arg.c_str() + 10));
+        else if (arg.compare(0, 7, "--show=") == 0)
+            show = atoi(arg.c_str() + 7);
+        else if (arg.compare(0, 12, "--tolerance=") == 0)
+            tolerance = atof(arg.c_str() + 12);
+        else if (applyRoutingSetting(arg))
+            settingsGiven = true;
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 2)
+    {
+        cerr << "Usage: " << argv[0] << " mapdata.txt queries.log [--repeats=N] [--show=N] [--tolerance=miles] [--compact] [--hub-labels] [--turn-costs] [--fast-distance] [--route-queue=Q] [--route-cost=C] [--road-speeds=S] [--road-weights=W]" << endl;
+        return 1;
+    }
+
+    vector<QueryRecord> records;
+    if (!QueryLog::read(files[1], records))
+    {
+        cerr << "Unable to read query log " << files[1] << endl;
+        return 1;
+    }
+    if (!settingsGiven && !records.empty())
+    {
+        istringstream flags(records[0].settings);
+        string flag;
+        while (flags >> flag)
+        {
+            if (!applyRoutingSetting(flag))
+                cerr << "Warning: ignoring unknown recorded setting " << flag << endl;
+        }
+    }
+    string settings = routingSettings();
+    long otherSettings = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].settings != settings)
+        {
+            if (otherSettings == 0)
+                cerr << "Warning: request #" << i << " was recorded with settings \"" << records[i].settings
+                     << "\" but is replayed with \"" << settings << "\"" << endl;
+            otherSettings++;
+        }
+    }
+    StreetMap sm;
+    if (!sm.load(files[0]))
+    {
+        cerr << "Unable to load map data file " << files[0] << endl;
+        return 1;
+    }
+    PointToPointRouter router(&sm);
+    DeliveryPlanner planner(&sm);
+
+    Latencies recorded[2], replayed[2];
+    long resultDiffs = 0, distanceDiffs = 0, sizeDiffs = 0;
+    int shown = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const QueryRecord& record = records[i];
+        DeliveryResult result = BAD_COORD;
+        double distance = 0;
+        unsigned long outputSize = 0;
+        double best = 0;
+        for (int r = 0; r < repeats; r++)
+        {
+            list<StreetSegment> route;
+            vector<GeoPoint> points;
+            CompactCommandList commands;
+            Clock::time_point begin = Clock::now();
+            int maxRoutes;
+            AlternativeRouteLimits limits;
+            if (sscanf(record.options.c_str(), "route alternatives %d %lf %lf %lf", &maxRoutes,
+                       &limits.maxStretch, &limits.maxSharing, &limits.minLocalOptimality) == 4)
+            {
+                vector<EdgeRoute> routes;
+                result = router.generateAlternativeRoutes(record.start, record.end, maxRoutes, routes, limits);
+                distance = routes.empty() ? 0 : routes[0].distance;
+                outputSize = routes.size();
+            }
+            else if (record.options == "route geometry")
+            {
+                result = router.generateRouteGeometry(record.start, record.end, points, distance);
+                outputSize = points.size();
+            }
+            else if (record.kind == QueryRecord::ROUTE)
+            {
+                result = router.generatePointToPointRoute(record.start, record.end, route, distance);
+                outputSize = route.size();
+            }
+            else
+            {
+                result = planner.generateDeliveryPlan(record.start, record.deliveries, commands, distance);
+                outputSize = commands.size();
+            }
+            double ms = chrono::duration<double, milli>(Clock::now() - begin).count();
+            if (r == 0 || ms < best)
+                best = ms;
+        }
+        recorded[record.kind].ms.push_back(record.latencyMs);
+        replayed[record.kind].ms.push_back(best);
+
+        bool resultDiffers = result != record.result;
+        bool distanceDiffers = !resultDiffers && fabs(distance - record.distance) > tolerance;
+        bool sizeDiffers = !resultDiffers && outputSize != record.outputSize;
+        resultDiffs += resultDiffers;
+        distanceDiffs += distanceDiffers;
+        sizeDiffs += sizeDiffers;
+        if ((resultDiffers || distanceDiffers || sizeDiffers) && shown < show)
+        {
+            shown++;
+            printf("#%zu %s\n", i, describe(record).c_str());
+            if (resultDiffers)
+                printf("    result   %s -> %s\n", resultName(record.result), resultName(result));
+            if (distanceDiffers)
+                printf("    miles    %.6f -> %.6f\n", record.distance, distance);
+            if (sizeDiffers)
+                printf("    output   %lu -> %lu\n", record.outputSize, outputSize);
+        }
+    }
+
+    printf("%zu requests replayed (%zu routes, %zu plans)\n",
+           records.size(), recorded[QueryRecord::ROUTE].ms.size(), recorded[QueryRecord::PLAN].ms.size());
+    printf("  settings           \"%s\"\n", settings.c_str());
+    if (otherSettings != 0)
+        printf("  other settings     %ld (recorded under different settings)\n", otherSettings);
+    printf("  result differs     %ld\n", resultDiffs);
+    printf("  distance differs   %ld\n", distanceDiffs);
+    printf("  output differs     %ld\n", sizeDiffs);
+    printLatencies("route", recorded[QueryRecord::ROUTE], replayed[QueryRecord::ROUTE]);
+    printLatencies("plan", recorded[QueryRecord::PLAN], replayed[QueryRecord::PLAN]);
+    return resultDiffs + distanceDiffs + sizeDiffs == 0 ? 0 : 2;
+}
@@ -0,0 +1,539 @@
+// selfcheck.cpp
+
+// Behavior checks that need no test framework: feeds the query server
+// malformed and edge-case request lines and checks its replies (JSON escapes,
+// echoed ids, bad \u escapes, unknown ops, deep nesting), edits a delivery
+// plan with addDelivery, removeDelivery and moveStart, checking that the
+// spliced legs still join up, round-trips encoded polylines, and closes and
+// reopens streets and compares EdgeWeights' components with a fresh search,
+// and checks that turn penalties keep their meaning under a travel-time cost.
+// Prints each failed check and exits nonzero if there were any.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o selfcheck tools/selfcheck.cpp $(ls *.cpp | grep -v main.cpp)
+// Run:
+//   ./selfcheck mapdata.txt [--seed=N]
+
+#include "../provided.h"
+#include "../EdgeWeights.h"
+#include "../Polyline.h"
+#include "../QueryServer.h"
+#include "../RouteCosts.h"
+#include "../RouteQueues.h"
+#include "../StreetGraph.h"
+#include "../StreetMapVersions.h"
+#include "../TurnGraph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    int g_checks = 0;
+    int g_failures = 0;
+
+    void check(bool ok, const string& what)
+    {
+        g_checks++;
+        if (!ok)
+        {
+            g_failures++;
+            printf("FAIL %s\n", what.c_str());
+        }
+    }
+
+    bool contains(const string& s, const string& part)
+    {
+        return s.find(part) != string::npos;
+    }
+
+    string coordJson(const GeoCoord& gc)
+    {
+        return "{\"lat\":\"" + gc.latitudeText + "\",\"lon\":\"" + gc.longitudeText + "\"}";
+    }
+
+      // the contents of the string member key of a one-line JSON reply
+    bool jsonStringAfter(const string& reply, const string& key, string& value)
+    {
+        size_t pos = reply.find("\"" + key + "\":\"");
+        if (pos == string::npos)
+            return false;
+        value.clear();
+        for (pos += key.size() + 4; pos < reply.size() && reply[pos] != '"'; pos++)
+        {
+            if (reply[pos] == '\\' && pos + 1 < reply.size())
+                pos++;
+            value += reply[pos];
+        }
+        return pos < reply.size();
+    }
+
+    //******************** query server requests ******************************
+
+    void checkRequests(const string& mapFile, const GeoCoord& from, const GeoCoord& to)
+    {
+        VersionedStreetMap maps;
+        if (!maps.load(mapFile))
+        {
+            check(false, "server map loads");
+            return;
+        }
+        QueryServer server(&maps, 1);
+
+        struct Case
+        {
+            string line;
+            vector<string> expected;    // each must appear in the reply
+        };
+        const string route = "\"op\":\"route\",\"from\":" + coordJson(from) + ",\"to\":" + coordJson(to);
+        const Case cases[] =
+        {
+            { "not json",                                   { "\"id\":null", "\"error\":\"malformed JSON\"" } },
+            { "[1,2]",                                      { "\"id\":null", "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":1} trailing",                        { "\"id\":null", "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":1,",                                 { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":\"\\uZZZZ\"}",                       { "\"id\":null", "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":\"\\u12\"}",                         { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":\"\\u00",                            { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":\"\\",                               { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":1abc}",                              { "\"id\":null", "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":0x10}",                              { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":1.}",                                { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":nul}",                               { "\"error\":\"malformed JSON\"" } },
+            { "{\"x\":" + string(100000, '[') + string(100000, ']') + "}",
+                                                            { "\"error\":\"malformed JSON\"" } },
+            { "{\"id\":\"q\\\"b\\\\s\\/\\n\\u0041\\u00e9\\u20ac\",\"op\":\"nope\"}",
+                                                            { "\"id\":\"q\\\"b\\\\s/\\u000aA\xc3\xa9\xe2\x82\xac\"", "\"error\":\"unknown op nope\"" } },
+            { "{\"id\":{\"a\":1},\"op\":\"nope\"}",         { "\"id\":null,", "unknown op nope" } },
+            { "{\"id\":[1,2],\"op\":\"nope\"}",             { "\"id\":null,", "unknown op nope" } },
+            { "{\"id\":-12.5e+2,\"op\":\"nope\"}",          { "\"id\":-12.5e+2,", "unknown op nope" } },
+            { "{\"id\":0,\"op\":\"nope\"}",                 { "\"id\":0,", "unknown op nope" } },
+            { "{\"id\":true,\"op\":\"nope\"}",              { "\"id\":true,", "unknown op nope" } },
+            { "{\"id\":null,\"op\":\"nope\"}",              { "\"id\":null,", "unknown op nope" } },
+            { "{\"id\":1,\"op\":7}",                        { "\"id\":1,", "\"error\":\"unknown op " } },
+            { "{}",                                         { "\"id\":null,", "missing or bad depot" } },
+            { "{\"id\":2,\"depot\":" + coordJson(from) + "}",
+                                                            { "\"id\":2,", "missing deliveries" } },
+            { "{\"id\":3,\"depot\":{\"lat\":\"north\",\"lon\":\"-118\"},\"deliveries\":[]}",
+                                                            { "missing or bad depot" } },
+            { "{\"id\":4,\"depot\":" + coordJson(from) + ",\"deliveries\":[{\"lat\":\"34\",\"lon\":\"-118\"}]}",
+                                                            { "bad delivery 0" } },
+            { "{\"id\":5,\"depot\":{\"lat\":\"1\",\"lon\":\"2\"},\"deliveries\":[{\"lat\":\"34\",\"lon\":\"-118\",\"item\":\"x\"}]}",
+                                                            { "\"result\":\"bad_coord\"" } },
+            { "{\"id\":6,\"depot\":" + coordJson(from) + ",\"deliveries\":[{\"lat\":\"" + to.latitudeText + "\",\"lon\":\"" + to.longitudeText + "\",\"item\":\"x\"}]}",
+                                                            { "\"id\":6,", "\"result\":\"success\"", "\"commands\":[" } },
+            { "{\"id\":7,\"op\":\"route\",\"from\":" + coordJson(from) + "}",
+                                                            { "route needs from and to" } },
+            { "{\"id\":8," + route + ",\"simplify_miles\":\"far\"}",
+                                                            { "bad simplify_miles" } },
+            { "{\"id\":9,\"op\":\"update\",\"edges\":{}}",  { "update needs edges" } },
+            { "{\"id\":10,\"op\":\"update\",\"edges\":[{\"from\":" + coordJson(from) + "}]}",
+                                                            { "bad edge 0" } },
+            { "{\"id\":11,\"op\":\"update\",\"edges\":[{\"from\":{\"lat\":\"1\",\"lon\":\"2\"},\"to\":{\"lat\":\"1\",\"lon\":\"3\"}}]}",
+                                                            { "edges not on the map" } },
+            { "{\"id\":12,\"op\":\"reload\"}",              { "reload needs a map file" } },
+        };
+        for (const Case& c : cases)
+        {
+            string reply = server.handleRequest(c.line);
+            bool ok = reply.find('\n') == string::npos && !reply.empty() && reply[0] == '{' && reply.back() == '}';
+            for (const string& part : c.expected)
+                ok = ok && contains(reply, part);
+            check(ok, "request " + c.line.substr(0, 80) + "\n     got " + reply);
+        }
+
+          // a route's polyline decodes to a line from one end to the other
+        string reply = server.handleRequest("{\"id\":13," + route + "}");
+        string polyline;
+        vector<GeoPoint> points;
+        bool decoded = jsonStringAfter(reply, "polyline", polyline) && decodePolyline(polyline, points);
+        check(decoded && points.size() >= 2, "route reply has a polyline: " + reply.substr(0, 120));
+        if (decoded && points.size() >= 2)
+        {
+            check(fabs(points.front().latitude - from.latitude) < 1e-5 && fabs(points.front().longitude - from.longitude) < 1e-5 &&
+                  fabs(points.back().latitude - to.latitude) < 1e-5 && fabs(points.back().longitude - to.longitude) < 1e-5,
+                  "route polyline runs from start to end");
+        }
+    }
+
+    //******************** plan edits *****************************************
+
+    const GeoCoord& waypoint(const DeliveryPlan& plan, size_t i)
+    {
+        if (i == 0)
+            return plan.start;
+        if (i <= plan.deliveries.size())
+            return plan.deliveries[i - 1].location;
+        return plan.depot;
+    }
+
+      // every leg runs between its waypoints along a shortest route, and the
+      // total is the legs' sum
+    void checkPlan(const PointToPointRouter& router, const DeliveryPlan& plan, const string& after)
+    {
+        bool ok = plan.legs.size() == plan.deliveries.size() + 1;
+        check(ok, after + ": one leg more than deliveries");
+        if (!ok)
+            return;
+        double total = 0;
+        for (size_t i = 0; i < plan.legs.size(); i++)
+        {
+            const DeliveryLeg& leg = plan.legs[i];
+            const GeoCoord& from = waypoint(plan, i);
+            const GeoCoord& to = waypoint(plan, i + 1);
+            bool joined = leg.route.empty() ? from == to : leg.route.front().start == from && leg.route.back().end == to;
+            const GeoCoord* at = &from;
+            double miles = 0;
+            for (const StreetSegment& s : leg.route)
+            {
+                joined = joined && s.start == *at;
+                at = &s.end;
+                miles += distanceEarthMiles(s.start, s.end);
+            }
+            check(joined, after + ": leg " + to_string(i) + " runs between its waypoints");
+            list<StreetSegment> route;
+            double shortest = -1;
+            router.generatePointToPointRoute(from, to, route, shortest);
+            check(fabs(leg.distance - shortest) < 1e-9 && fabs(leg.distance - miles) < 1e-6, after + ": leg " + to_string(i) + " is a shortest route");
+            bool delivers = i + 1 == plan.legs.size() ||
+                            (!leg.commands.empty() && leg.commands.back().description() == "DELIVER " + plan.deliveries[i].item);
+            check(delivers, after + ": leg " + to_string(i) + " ends with its delivery");
+            total += leg.distance;
+        }
+        check(fabs(total - plan.totalDistanceTravelled) < 1e-9, after + ": total is the legs' sum");
+    }
+
+    void checkPlanEdits(const string& mapFile, const GeoCoord& depot, mt19937& rng)
+    {
+        StreetMap sm;
+        if (!sm.load(mapFile))
+        {
+            check(false, "plan map loads");
+            return;
+        }
+        int component = sm.componentOf(depot);
+        vector<GeoCoord> stops;
+        uniform_int_distribution<int> anyNode(0, sm.numIntersections() - 1);
+        for (int tries = 0; stops.size() < 12 && tries < 100000; tries++)
+        {
+            GeoCoord gc = sm.intersection(anyNode(rng));
+            if (sm.componentOf(gc) == component)
+                stops.push_back(gc);
+        }
+        if (stops.size() < 12)
+        {
+            check(false, "enough intersections near the depot");
+            return;
+        }
+        DeliveryPlanner planner(&sm);
+        PointToPointRouter router(&sm);
+        vector<DeliveryRequest> deliveries;
+        for (int i = 0; i < 5; i++)
+            deliveries.push_back(DeliveryRequest("item" + to_string(i), stops[i]));
+        DeliveryPlan plan;
+        check(planner.generateDeliveryPlan(depot, deliveries, plan) == DELIVERY_SUCCESS, "plan generates");
+        checkPlan(router, plan, "plan");
+
+        for (int i = 5; i < 9; i++)
+        {
+            check(planner.addDelivery(plan, DeliveryRequest("added" + to_string(i), stops[i])) == DELIVERY_SUCCESS, "addDelivery succeeds");
+            checkPlan(router, plan, "addDelivery " + to_string(i));
+        }
+        check(plan.deliveries.size() == 9, "every added delivery is in the plan");
+        check(planner.removeDelivery(plan, 0) == DELIVERY_SUCCESS, "removeDelivery of the first stop succeeds");
+        checkPlan(router, plan, "removeDelivery first");
+        check(planner.removeDelivery(plan, static_cast<int>(plan.deliveries.size()) - 1) == DELIVERY_SUCCESS, "removeDelivery of the last stop succeeds");
+        checkPlan(router, plan, "removeDelivery last");
+        check(planner.removeDelivery(plan, 3) == DELIVERY_SUCCESS, "removeDelivery of a middle stop succeeds");
+        checkPlan(router, plan, "removeDelivery middle");
+        check(planner.moveStart(plan, stops[9]) == DELIVERY_SUCCESS && plan.start == stops[9], "moveStart succeeds");
+        checkPlan(router, plan, "moveStart");
+        check(planner.moveStart(plan, plan.deliveries[0].location) == DELIVERY_SUCCESS, "moveStart onto the next stop succeeds");
+        checkPlan(router, plan, "moveStart onto the next stop");
+
+        size_t before = plan.deliveries.size();
+        double miles = plan.totalDistanceTravelled;
+        check(planner.removeDelivery(plan, -1) == BAD_COORD && planner.removeDelivery(plan, static_cast<int>(before)) == BAD_COORD,
+              "removeDelivery out of range is refused");
+        check(planner.addDelivery(plan, DeliveryRequest("nowhere", GeoCoord("1", "2"))) == BAD_COORD, "addDelivery off the map is refused");
+        check(planner.moveStart(plan, GeoCoord("1", "2")) != DELIVERY_SUCCESS, "moveStart off the map is refused");
+        check(plan.deliveries.size() == before && plan.totalDistanceTravelled == miles && plan.start == plan.deliveries[0].location,
+              "refused edits leave the plan as it was");
+        checkPlan(router, plan, "refused edits");
+
+        while (!plan.deliveries.empty())
+            check(planner.removeDelivery(plan, 0) == DELIVERY_SUCCESS, "removeDelivery down to no stops");
+        checkPlan(router, plan, "every stop removed");
+    }
+    //******************** polylines ******************************************
+
+    void checkPolylines(mt19937& rng)
+    {
+        uniform_real_distribution<double> lat(-90, 90);
+        uniform_real_distribution<double> lon(-180, 180);
+        for (int precision = 5; precision <= 6; precision++)
+        {
+            for (int trial = 0; trial < 50; trial++)
+            {
+                vector<GeoPoint> points(1 + trial * 3);
+                for (GeoPoint& p : points)
+                    p = GeoPoint{ lat(rng), lon(rng) };
+                string encoded;
+                encodePolyline(points, encoded, precision);
+                vector<GeoPoint> decoded;
+                bool ok = decodePolyline(encoded, decoded, precision) && decoded.size() == points.size();
+                double tolerance = 0.5 / pow(10.0, precision) + 1e-9;
+                for (size_t i = 0; ok && i < points.size(); i++)
+                    ok = fabs(decoded[i].latitude - points[i].latitude) <= tolerance && fabs(decoded[i].longitude - points[i].longitude) <= tolerance;
+                check(ok, "polyline round trip, precision " + to_string(precision) + ", " + to_string(points.size()) + " points");
+                for (char c : encoded)
+                    ok = ok && c >= 63 && c <= 126;
+                check(ok, "polyline characters are printable");
+
+                vector<GeoPoint> truncated;
+                check(!decodePolyline(encoded.substr(0, encoded.size() - 1), truncated, precision), "truncated polyline is rejected");
+            }
+        }
+        vector<GeoPoint> decoded(3);
+        check(decodePolyline("", decoded) && decoded.empty(), "empty polyline decodes to no points");
+        check(!decodePolyline("_p~iF", decoded), "polyline with a latitude and no longitude is rejected");
+        check(!decodePolyline("_p~iF ", decoded), "polyline with a space is rejected");
+        vector<GeoPoint> known;
+        check(decodePolyline("_p~iF~ps|U_ulLnnqC_mqNvxq`@", known) && known.size() == 3 &&
+              fabs(known[0].latitude - 38.5) < 1e-9 && fabs(known[0].longitude + 120.2) < 1e-9 &&
+              fabs(known[2].latitude - 43.252) < 1e-9 && fabs(known[2].longitude + 126.453) < 1e-9,
+              "Google's example polyline decodes");
+
+        vector<GeoPoint> line = { { 34, -118 }, { 34.0001, -118.00005 }, { 34.0002, -118 }, { 34.01, -118.01 } };
+        vector<GeoPoint> simplified;
+        simplifyPolyline(line, 0, simplified);
+        check(simplified.size() == line.size(), "simplifying with no tolerance keeps every bend");
+        simplifyPolyline(line, 10, simplified);
+        check(simplified.size() == 2 && simplified.front().latitude == 34 && simplified.back().latitude == 34.01,
+              "simplifying with a wide tolerance keeps just the ends");
+    }
+
+    //******************** edge weights ***************************************
+
+    bool linkOpen(const StreetGraph& graph, const EdgeWeights* weights, int from, int edge)
+    {
+        if (weights == nullptr || weights->open(edge))
+            return true;
+        int to = graph.target(edge);
+        for (int e = graph.firstEdge(to); e < graph.endEdge(to); e++)
+            if (graph.target(e) == from && weights->open(e))
+                return true;
+        return false;
+    }
+
+      // whether the components the map reports are the ones a search over the
+      // open streets finds, up to renumbering; sets numComponents
+    bool componentsMatch(const StreetMap& sm, int& numComponents)
+    {
+        const StreetGraph& graph = sm.graph();
+        const EdgeWeights* weights = sm.edgeWeights();
+        int n = graph.numNodes();
+        vector<int> label(n, -1);
+        numComponents = 0;
+        for (int root = 0; root < n; root++)
+        {
+            if (label[root] != -1)
+                continue;
+            vector<int> queue(1, root);
+            label[root] = numComponents;
+            for (size_t q = 0; q < queue.size(); q++)
+            {
+                int node = queue[q];
+                for (int e = graph.firstEdge(node); e < graph.endEdge(node); e++)
+                {
+                    int next = graph.target(e);
+                    if (label[next] == -1 && linkOpen(graph, weights, node, e))
+                    {
+                        label[next] = numComponents;
+                        queue.push_back(next);
+                    }
+                }
+            }
+            numComponents++;
+        }
+        unordered_map<int, int> reportedOf;
+        unordered_map<int, int> labelOf;
+        for (int node = 0; node < n; node++)
+        {
+            int reported = sm.componentOf(graph.coord(node));
+            auto a = reportedOf.insert(make_pair(label[node], reported));
+            auto b = labelOf.insert(make_pair(reported, label[node]));
+            if (a.first->second != reported || b.first->second != label[node])
+                return false;
+        }
+        return true;
+    }
+
+    EdgeUpdate edgeUpdate(const StreetGraph& graph, int from, int edge, bool closed)
+    {
+        EdgeUpdate update;
+        update.from = graph.coord(from);
+        update.to = graph.coord(graph.target(edge));
+        update.closed = closed;
+        return update;
+    }
+
+    void checkEdgeWeights(const string& mapFile, mt19937& rng)
+    {
+        StreetMap sm;
+        if (!sm.load(mapFile) || sm.graph().numNodes() == 0)
+        {
+            check(false, "edge-weight map loads as a graph");
+            return;
+        }
+        const StreetGraph& graph = sm.graph();
+        int loadedComponents;
+        check(componentsMatch(sm, loadedComponents), "loaded components match a search");
+
+          // half dead ends, whose closing must cut a node off, half anywhere
+        vector<pair<int, int> > closed;         // node and edge out of it
+        uniform_int_distribution<int> anyNode(0, graph.numNodes() - 1);
+        set<pair<int, int> > chosen;
+        for (int tries = 0; closed.size() < 120 && tries < 100000; tries++)
+        {
+            int node = anyNode(rng);
+            int degree = graph.endEdge(node) - graph.firstEdge(node);
+            if (degree == 0 || (closed.size() % 2 == 0 && degree != 1))
+                continue;
+            int edge = graph.firstEdge(node) + uniform_int_distribution<int>(0, degree - 1)(rng);
+            int a = min(node, graph.target(edge));
+            int b = max(node, graph.target(edge));
+            if (a == b || !chosen.insert(make_pair(a, b)).second)
+                continue;
+            closed.push_back(make_pair(node, edge));
+        }
+
+        int most = loadedComponents;
+        for (size_t i = 0; i < closed.size(); i++)
+        {
+            bool updated = sm.updateEdges(vector<EdgeUpdate>(1, edgeUpdate(graph, closed[i].first, closed[i].second, true)));
+            int numComponents;
+            check(updated && componentsMatch(sm, numComponents), "components after closing street " + to_string(i));
+            most = max(most, numComponents);
+        }
+        check(most > loadedComponents, "closing streets split some component");
+        for (size_t i = closed.size(); i-- > 0; )
+        {
+            bool updated = sm.updateEdges(vector<EdgeUpdate>(1, edgeUpdate(graph, closed[i].first, closed[i].second, false)));
+            int numComponents;
+            check(updated && componentsMatch(sm, numComponents), "components after reopening street " + to_string(i));
+        }
+        int numComponents;
+        check(componentsMatch(sm, numComponents) && numComponents == loadedComponents, "reopening everything restores the components");
+        check(sm.edgeWeights() == nullptr, "reopening everything leaves the streets as loaded");
+
+        EdgeUpdate bad;
+        bad.from = graph.coord(0);
+        bad.to = graph.coord(0);
+        check(!sm.updateEdges(vector<EdgeUpdate>(1, bad)), "an update naming no street is rejected");
+        EdgeUpdate negative = edgeUpdate(graph, closed[0].first, closed[0].second, false);
+        negative.factor = -2;
+        check(!sm.updateEdges(vector<EdgeUpdate>(1, negative)), "a negative factor is rejected");
+    }
+
+
+    //******************** turn costs *****************************************
+
+      // With every road at 30 mph a travel-time route costs two minutes a
+      // mile, and turn penalties (miles) cost what that distance would, so
+      // it must choose the routes the distance cost does, turns included.
+    void checkTurnCosts(const string& mapFile, mt19937& rng)
+    {
+        setTurnCostMaps(true);
+        setRouteQueue(HEAP_QUEUE);
+        StreetMap sm;
+        bool loaded = sm.load(mapFile) && sm.turnGraph() != nullptr;
+        check(loaded, "map loads with turn costs");
+        if (loaded)
+        {
+            PointToPointRouter router(&sm);
+            RoadSpeeds slow;
+            for (int c = 0; c < NUM_ROAD_CLASSES; c++)
+                slow.mph[c] = 30;
+            uniform_int_distribution<int> anyNode(0, sm.numIntersections() - 1);
+            int compared = 0;
+            for (int tries = 0; compared < 100 && tries < 100000; tries++)
+            {
+                GeoCoord from = sm.intersection(anyNode(rng));
+                GeoCoord to = sm.intersection(anyNode(rng));
+                if (sm.componentOf(from) != sm.componentOf(to) || from == to)
+                    continue;
+                list<StreetSegment> byDistance, byTime;
+                double distanceMiles = 0, timeMiles = 0;
+                setRouteCost(DISTANCE_COST);
+                DeliveryResult a = router.generatePointToPointRoute(from, to, byDistance, distanceMiles);
+                setRouteCost(TRAVEL_TIME_COST);
+                setRoadSpeeds(slow);
+                DeliveryResult b = router.generatePointToPointRoute(from, to, byTime, timeMiles);
+                setRoadSpeeds(RoadSpeeds());
+                check(a == DELIVERY_SUCCESS && b == DELIVERY_SUCCESS && fabs(distanceMiles - timeMiles) < 1e-6,
+                      "turn-cost route at 30 mph matches the distance route, pair " + to_string(compared));
+                compared++;
+            }
+        }
+        setRouteCost(DISTANCE_COST);
+        setRouteQueue(FIFO_QUEUE);
+        setTurnCostMaps(false);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 7, "--seed=") == 0)
+            seed = static_cast<unsigned>(atoi(arg.c_str() + 7));
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 1)
+    {
+        cerr << "Usage: " << argv[0] << " mapdata.txt [--seed=N]" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(files[0]) || sm.numIntersections() < 2)
+    {
+        cerr << "Unable to load map data file " << files[0] << endl;
+        return 1;
+    }
+    mt19937 rng(seed);
+      // two intersections in one component, for the routes
+    GeoCoord from = sm.intersection(0);
+    GeoCoord to = sm.intersection(1);
+    uniform_int_distribution<int> anyNode(0, sm.numIntersections() - 1);
+    for (int tries = 0; tries < 100000; tries++)
+    {
+        from = sm.intersection(anyNode(rng));
+        to = sm.intersection(anyNode(rng));
+        if (sm.componentOf(from) == sm.componentOf(to) && distanceEarthMiles(from, to) > 0.5)
+            break;
+    }
+
+    checkRequests(files[0], from, to);
+    checkPlanEdits(files[0], from, rng);
+    checkPolylines(rng);
+    checkEdgeWeights(files[0], rng);
+    checkTurnCosts(files[0], rng);
+
+    printf("%d checks, %d failed\n", g_checks, g_failures);
+    return g_failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,58 @@
+// tilemap.cpp
+
+// Converts a map file into a tile file that StreetMap::load opens lazily:
+// tiles are memory-mapped and decoded only when a search reaches them, and
+// main's --tile-cache=N bounds how many stay decoded at once.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o tilemap tools/tilemap.cpp $(ls *.cpp | grep -v main.cpp)
+// Run:
+//   ./tilemap mapdata.txt mapdata.tiles [--tile-miles=X]
+
+#include "../provided.h"
+#include "../StreetGraph.h"
+#include "../TiledMap.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    double tileMiles = 1.0;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 13, "--tile-miles=") == 0)
+            tileMiles = atof(arg.c_str() + 13);
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 2 || tileMiles <= 0)
+    {
+        cerr << "Usage: " << argv[0] << " mapdata.txt out.tiles [--tile-miles=X]" << endl;
+        return 1;
+    }
+
+    StreetMap sm;
+    if (!sm.load(files[0]) || sm.tiles() != nullptr)
+    {
+        cerr << "Unable to load map data file " << files[0] << endl;
+        return 1;
+    }
+    if (!TiledMap::write(sm.graph(), files[1], tileMiles))
+    {
+        cerr << "Unable to write tile file " << files[1] << endl;
+        return 1;
+    }
+    TiledMap tiles;
+    if (!tiles.open(files[1]))
+    {
+        cerr << "Unable to read back tile file " << files[1] << endl;
+        return 1;
+    }
+    cout << sm.graph().numNodes() << " intersections in " << tiles.numTiles() << " tiles of " << tileMiles << " miles" << endl;
+    return 0;
+}